@@ -4,12 +4,20 @@
 
 string(TOLOWER "${CMAKE_BUILD_TYPE}" CMAKE_BUILD_TYPE_LOWER)
 
+# The flags below are meant for the host C++ compiler, nvcc rejects most of
+# them, so they are not applied to .cu files
+macro(add_cxx_compile_options)
+  foreach(option ${ARGN})
+    add_compile_options("$<$<COMPILE_LANGUAGE:CXX>:${option}>")
+  endforeach()
+endmacro()
+
 #
 # Generic flags
 #
-add_compile_options("-Wall")
-add_compile_options("-Wextra")
-add_compile_options("-pedantic")
+add_cxx_compile_options("-Wall")
+add_cxx_compile_options("-Wextra")
+add_cxx_compile_options("-pedantic")
 add_compile_options("-O3")
 add_compile_options("-g")
 
@@ -17,10 +25,10 @@ add_compile_options("-g")
 # Allow the linker to remove unused data and functions
 #
 if(CMAKE_CXX_COMPILER_ID MATCHES GNU)
-  add_compile_options("-fdata-sections")
-  add_compile_options("-ffunction-sections")
-  add_compile_options("-fno-common")
-  add_compile_options("-Wl,--gc-sections")
+  add_cxx_compile_options("-fdata-sections")
+  add_cxx_compile_options("-ffunction-sections")
+  add_cxx_compile_options("-fno-common")
+  add_cxx_compile_options("-Wl,--gc-sections")
 endif(CMAKE_CXX_COMPILER_ID MATCHES GNU)
 
 #
@@ -28,27 +36,27 @@ endif(CMAKE_CXX_COMPILER_ID MATCHES GNU)
 # See https://developers.redhat.com/blog/2018/03/21/compiler-and-linker-flags-gcc
 #
 if(CMAKE_CXX_COMPILER_ID MATCHES GNU)
-  add_compile_options("-D_GLIBCXX_ASSERTIONS")
-  add_compile_options("-fasynchronous-unwind-tables")
-  add_compile_options("-fexceptions")
-  add_compile_options("-fstack-clash-protection")
-  add_compile_options("-fstack-protector-strong")
-  add_compile_options("-grecord-gcc-switches")
+  add_cxx_compile_options("-D_GLIBCXX_ASSERTIONS")
+  add_cxx_compile_options("-fasynchronous-unwind-tables")
+  add_cxx_compile_options("-fexceptions")
+  add_cxx_compile_options("-fstack-clash-protection")
+  add_cxx_compile_options("-fstack-protector-strong")
+  add_cxx_compile_options("-grecord-gcc-switches")
 
   # Issue 872: https://github.com/oatpp/oatpp/issues/872
   # -fcf-protection is supported only on x86 GNU/Linux per this gcc doc:
   # https://gcc.gnu.org/onlinedocs/gcc/Instrumentation-Options.html#index-fcf-protection
-  # add_compile_options("-fcf-protection")
-  add_compile_options("-pipe")
-  add_compile_options("-Werror=format-security")
-  add_compile_options("-Wno-format-nonliteral")
-  add_compile_options("-fPIE")
-  add_compile_options("-Wl,-z,defs")
-  add_compile_options("-Wl,-z,now")
-  add_compile_options("-Wl,-z,relro")
+  # add_cxx_compile_options("-fcf-protection")
+  add_cxx_compile_options("-pipe")
+  add_cxx_compile_options("-Werror=format-security")
+  add_cxx_compile_options("-Wno-format-nonliteral")
+  add_cxx_compile_options("-fPIE")
+  add_cxx_compile_options("-Wl,-z,defs")
+  add_cxx_compile_options("-Wl,-z,now")
+  add_cxx_compile_options("-Wl,-z,relro")
 endif(CMAKE_CXX_COMPILER_ID MATCHES GNU)
 
 # Gemini 3 Pro: Suppress warning about C11 extensions in C++ code (triggered by OpenCV)
 if (CMAKE_CXX_COMPILER_ID MATCHES "Clang" OR CMAKE_CXX_COMPILER_ID MATCHES "AppleClang")
-  add_compile_options(-Wno-c11-extensions)
+  add_cxx_compile_options(-Wno-c11-extensions)
 endif()
\ No newline at end of file
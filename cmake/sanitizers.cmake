@@ -21,7 +21,7 @@ endif ()
 set(SANITIZER_NAME "None")
 if (BUILD_ASAN)
     message("-- AddressSanitizer WILL be compiled in as BUILD_ASAN=ON")
-    add_compile_options(-fsanitize=address -shared-libasan -fno-omit-frame-pointer -g)
+    add_cxx_compile_options(-fsanitize=address -shared-libasan -fno-omit-frame-pointer -g)
     add_link_options(-fsanitize=address)
     set(SANITIZER_NAME "AddressSanitizer")
     add_definitions(-DSANITIZER_NAME="${SANITIZER_NAME}")
@@ -31,7 +31,7 @@ endif ()
 
 if (BUILD_UBSAN)
     message("-- UndefinedBehaviorSanitizer WILL be compiled in as BUILD_UBSAN=ON")
-    add_compile_options(-fsanitize=undefined -g)
+    add_cxx_compile_options(-fsanitize=undefined -g)
     add_link_options(-fsanitize=undefined)
     set(SANITIZER_NAME "UndefinedBehaviorSanitizer")
     add_definitions(-DSANITIZER_NAME="${SANITIZER_NAME}")
@@ -0,0 +1,212 @@
+// Counts the global (operator new) allocations made per frame by the overlay
+// units' transient text formatting: YoloOverlay's and SFaceOverlay's JSON
+// lines and OverlayText's split into lines. "njson" is how they formatted it
+// before the frame arena, "arena" how they do now.
+#include "../src/matrix-pipeline/utils/frame_arena.h"
+#include "../src/matrix-pipeline/utils/json_text.h"
+
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using njson = nlohmann::json;
+using namespace MatrixPipeline;
+
+static std::atomic<size_t> allocation_count{0};
+
+// GCC takes the free() of the replaced operator delete, once inlined, for a
+// mismatch with the operator new of the caller
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void *operator new(const std::size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size == 0 ? 1 : size))
+    return p;
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+struct Detection {
+  int class_id;
+  float confidence;
+  bool is_interesting;
+};
+
+struct Face {
+  float face_score;
+  std::string identity;
+  float cosine_score;
+  float l2_norm;
+};
+
+static const std::vector<std::string> class_names = {
+    "person", "bicycle", "car", "motorcycle", "airplane", "bus", "train"};
+
+// What the removed Utils::hybrid_njson_array_dump() did
+static std::string njson_array_dump(const njson &j_array) {
+  std::string out = "[\n";
+  for (size_t i = 0; i < j_array.size(); ++i) {
+    out += fmt::format("  {}{}\n", j_array[i].dump(),
+                       (i < j_array.size() - 1 ? ", " : ""));
+  }
+  out += "]";
+  return out;
+}
+
+static size_t njson_frame(const std::vector<Detection> &detections,
+                          const std::vector<Face> &faces) {
+  std::string text_to_overlay;
+  njson detection_jsons;
+  for (const auto &detection : detections) {
+    njson detection_json;
+    std::string label = class_names[detection.class_id];
+    const std::string label_text =
+        fmt::format("{}{} {:.2f} ", !detection.is_interesting ? "(!)" : "",
+                    label, detection.confidence);
+    detection_json["lbl"] = label;
+    detection_json["conf"] = fmt::format("{:.2f}", detection.confidence);
+    detection_json["roi"] = detection.is_interesting;
+    detection_jsons.emplace_back(detection_json);
+  }
+  text_to_overlay +=
+      fmt::format("Yolo: {}\n", njson_array_dump(detection_jsons));
+
+  njson yunet_jsons;
+  njson sface_jsons;
+  for (const auto &face : faces) {
+    njson yunet_json;
+    yunet_json["conf"] = std::round(face.face_score * 100.0) / 100.0;
+    yunet_jsons.emplace_back(yunet_json);
+    njson sface_json;
+    sface_json["ID"] = face.identity;
+    sface_json["cos"] = std::round(face.cosine_score * 100.0) / 100.0;
+    sface_json["L2"] = std::round(face.l2_norm * 100.0) / 100.0;
+    sface_jsons.emplace_back(sface_json);
+  }
+  text_to_overlay +=
+      fmt::format("YuNet: {}\n", njson_array_dump(yunet_jsons));
+  text_to_overlay +=
+      fmt::format("SFace: {}\n", njson_array_dump(sface_jsons));
+
+  std::vector<std::string> lines;
+  std::stringstream ss(text_to_overlay);
+  std::string line;
+  while (std::getline(ss, line, '\n'))
+    lines.push_back(line);
+  return lines.size();
+}
+
+static size_t arena_frame(const std::vector<Detection> &detections,
+                          const std::vector<Face> &faces,
+                          std::pmr::memory_resource *arena,
+                          std::string &label_text) {
+  std::string text_to_overlay;
+  std::pmr::string detections_text(arena);
+  for (size_t i = 0; i < detections.size(); ++i) {
+    const auto &detection = detections[i];
+    const std::string_view label = class_names[detection.class_id];
+    label_text.clear();
+    fmt::format_to(std::back_inserter(label_text), "{}{} {:.2f} ",
+                   !detection.is_interesting ? "(!)" : "", label,
+                   detection.confidence);
+    Utils::begin_json_array_line(detections_text, i);
+    fmt::format_to(std::back_inserter(detections_text),
+                   R"({{"conf":"{:.2f}","lbl":)", detection.confidence);
+    Utils::append_json_string(detections_text, label);
+    detections_text +=
+        detection.is_interesting ? R"(,"roi":true})" : R"(,"roi":false})";
+  }
+  Utils::end_json_array_lines(detections_text, detections.size());
+  fmt::format_to(std::back_inserter(text_to_overlay), "Yolo: {}\n",
+                 std::string_view(detections_text));
+
+  std::pmr::string yunet_text(arena);
+  std::pmr::string sface_text(arena);
+  for (size_t i = 0; i < faces.size(); ++i) {
+    const auto &face = faces[i];
+    Utils::begin_json_array_line(yunet_text, i);
+    yunet_text += R"({"conf":)";
+    Utils::append_json_number(yunet_text,
+                              std::round(face.face_score * 100.0) / 100.0);
+    yunet_text += '}';
+    Utils::begin_json_array_line(sface_text, i);
+    sface_text += R"({"ID":)";
+    Utils::append_json_string(sface_text, face.identity);
+    sface_text += R"(,"L2":)";
+    Utils::append_json_number(sface_text,
+                              std::round(face.l2_norm * 100.0) / 100.0);
+    sface_text += R"(,"cos":)";
+    Utils::append_json_number(sface_text,
+                              std::round(face.cosine_score * 100.0) / 100.0);
+    sface_text += '}';
+  }
+  Utils::end_json_array_lines(yunet_text, faces.size());
+  Utils::end_json_array_lines(sface_text, faces.size());
+  fmt::format_to(std::back_inserter(text_to_overlay),
+                 "YuNet: {}\nSFace: {}\n", std::string_view(yunet_text),
+                 std::string_view(sface_text));
+
+  std::pmr::vector<std::string_view> lines(arena);
+  const std::string_view text = text_to_overlay;
+  for (size_t start = 0; start < text.size();) {
+    const auto end = std::min(text.find('\n', start), text.size());
+    lines.push_back(text.substr(start, end - start));
+    start = end + 1;
+  }
+  return lines.size();
+}
+
+int main(int argc, char *argv[]) {
+  const int frames = argc > 1 ? std::stoi(argv[1]) : 10000;
+  constexpr int detection_count = 20;
+  constexpr int face_count = 4;
+
+  std::vector<Detection> detections;
+  for (int i = 0; i < detection_count; ++i)
+    detections.push_back({i % static_cast<int>(class_names.size()),
+                          0.5f + i * 0.02f, i % 2 == 0});
+  std::vector<Face> faces;
+  for (int i = 0; i < face_count; ++i)
+    faces.push_back({0.9f, "Unknown Visitor " + std::to_string(i),
+                     0.3f + i * 0.1f, 1.1f - i * 0.1f});
+
+  Utils::FrameArena arena;
+  std::string label_text;
+  // Warm-up, s.t. the arena and reused buffers have grown to a frame's size
+  for (int i = 0; i < 10; ++i) {
+    arena_frame(detections, faces, arena.resource(), label_text);
+    arena.reset();
+  }
+
+  size_t line_count = 0;
+  auto count_before = allocation_count.load();
+  for (int i = 0; i < frames; ++i)
+    line_count += njson_frame(detections, faces);
+  const auto njson_allocations = allocation_count.load() - count_before;
+
+  count_before = allocation_count.load();
+  for (int i = 0; i < frames; ++i) {
+    line_count += arena_frame(detections, faces, arena.resource(), label_text);
+    arena.reset();
+  }
+  const auto arena_allocations = allocation_count.load() - count_before;
+
+  std::cout << "detections: " << detection_count << ", faces: " << face_count
+            << ", frames: " << frames << ", lines: " << line_count << "\n";
+  std::cout << "njson global allocations per frame: "
+            << static_cast<double>(njson_allocations) / frames << "\n";
+  std::cout << "arena global allocations per frame: "
+            << static_cast<double>(arena_allocations) / frames << "\n";
+  return 0;
+}
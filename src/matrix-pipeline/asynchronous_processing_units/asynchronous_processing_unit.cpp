@@ -22,12 +22,142 @@
 #include "../synchronous_processing_units/yolo_publish_mqtt.h"
 #include "../synchronous_processing_units/yunet_detect.h"
 #include "../synchronous_processing_units/yunet_overlay_landmarks.h"
+#include "../utils/frame_cow.h"
 #include "pipe_writer.h"
+#include "pipeline_graph.h"
 
 #include <fmt/ranges.h>
 
+#include <optional>
+#include <stdexcept>
+
 namespace MatrixPipeline::ProcessingUnit {
 
+AsynchronousProcessingUnit::~AsynchronousProcessingUnit() {
+  // The worker threads must be stopped (and their queues drained) while
+  // m_processing_units is still alive, the base class' destructor is too
+  // late. Stop our own first s.t. nothing is enqueued to the children anymore
+  stop();
+  stop_stages();
+  for (const auto &unit : m_processing_units) {
+    if (const auto *ptr =
+            std::get_if<std::shared_ptr<IAsynchronousProcessingUnit>>(&unit))
+      (*ptr)->stop();
+  }
+  SPDLOG_INFO("{}: {} copy-on-write frame copies over {} frames in total",
+              m_unit_path, m_copy_on_write_count->value(),
+              m_frame_count.load());
+}
+
+void AsynchronousProcessingUnit::log_cow_stats_throttled() {
+  using namespace std::chrono_literals;
+  constexpr auto stats_interval = 60s;
+  const auto now = std::chrono::steady_clock::now();
+  if (now - m_last_cow_stats_log_time < stats_interval)
+    return;
+  m_last_cow_stats_log_time = now;
+  SPDLOG_INFO("{}: copy-on-write(copies/frames): {}/{} (this message is logged "
+              "once per {} sec)",
+              m_unit_path, m_copy_on_write_count->value(), m_frame_count.load(),
+              stats_interval.count());
+}
+
+std::optional<ProcessingUnitVariant>
+create_processing_unit(const std::string &type,
+                       const std::string &parent_unit_path) {
+  if (type == "SynchronousProcessingUnit::rotateAndFlip") {
+    return std::make_unique<RotateAndFlip>(parent_unit_path);
+  } else if (type == "SynchronousProcessingUnit::overlayText") {
+    return std::make_unique<OverlayText>(parent_unit_path);
+  } else if (type == "SynchronousProcessingUnit::cropFrame") {
+    return std::make_unique<CropFrame>(parent_unit_path);
+  } else if (type == "SynchronousProcessingUnit::debugOutput") {
+    return std::make_unique<DebugOutput>(parent_unit_path);
+  } else if (type == "SynchronousProcessingUnit::resize") {
+    return std::make_unique<resize>(parent_unit_path);
+  } else if (type == "SynchronousProcessingUnit::collectStats") {
+    return std::make_unique<CollectStats>(parent_unit_path);
+  } else if (type == "SynchronousProcessingUnit::measureLatency") {
+    return std::make_unique<MeasureLatency>(parent_unit_path);
+  } else if (type ==
+             "SynchronousProcessingUnit::yoloPruneDetectionResults") {
+    return std::make_unique<YoloPruneDetectionResults>(parent_unit_path);
+  } else if (type == "AsynchronousProcessingUnit::videoWriter") {
+    return std::make_shared<VideoWriter>(parent_unit_path);
+  } else if (type == "AsynchronousProcessingUnit::httpService") {
+    return std::make_shared<HttpService>(parent_unit_path);
+  } else if (type == "SynchronousProcessingUnit::yoloDetect") {
+    return std::make_unique<YoloDetect>(parent_unit_path);
+  } else if (type == "SynchronousProcessingUnit::sfaceDetect") {
+    return std::make_unique<SfaceDetect>(parent_unit_path);
+  } else if (type == "SynchronousProcessingUnit::yuNetOverlayLandmarks") {
+    return std::make_unique<YuNetOverlayLandmarks>(parent_unit_path);
+  } else if (type == "SynchronousProcessingUnit::yoloOverlay") {
+    return std::make_unique<YoloOverlay>(parent_unit_path);
+  } else if (type == "SynchronousProcessingUnit::autoZoom") {
+    return std::make_unique<AutoZoom>(parent_unit_path);
+  } else if (type == "SynchronousProcessingUnit::yoloPublishMqtt") {
+    return std::make_unique<YoloPublishMqtt>(parent_unit_path);
+  } else if (type == "SynchronousProcessingUnit::sfaceOverlay") {
+    return std::make_unique<SFaceOverlay>(parent_unit_path);
+  } else if (type ==
+             "AsynchronousProcessingUnit::asynchronousProcessingUnit") {
+    return std::make_unique<AsynchronousProcessingUnit>(parent_unit_path);
+  } else if (type == "AsynchronousProcessingUnit::matrixNotifier") {
+    return std::make_shared<MatrixNotifier>(parent_unit_path);
+  } else if (type == "AsynchronousProcessingUnit::pipeWriter") {
+    return std::make_shared<PipeWriter>(parent_unit_path);
+  } else if (type == "AsynchronousProcessingUnit::pipelineGraph") {
+    return std::make_shared<PipelineGraph>(parent_unit_path);
+  }
+  return std::nullopt;
+}
+
+bool init_processing_unit(const ProcessingUnitVariant &unit,
+                          const njson &config) {
+  return std::visit(
+      overload{
+          [&](const std::unique_ptr<ISynchronousProcessingUnit> &ptr) {
+            return ptr->init(config) && ptr->configure_latency_budget(config);
+          },
+          [&](const std::shared_ptr<IAsynchronousProcessingUnit> &ptr) {
+            if (!ptr->init(config) || !ptr->configure_queue(config))
+              return false;
+            ptr->start();
+            return true;
+          },
+      },
+      unit);
+}
+
+SynchronousProcessingResult
+run_processing_unit(const ProcessingUnitVariant &unit, cv::cuda::GpuMat &frame,
+                    PipelineContext &ctx, Utils::Counter &copy_on_write_count) {
+  return std::visit(
+      overload{
+          [&](const std::unique_ptr<ISynchronousProcessingUnit> &ptr) {
+            if (ptr->is_disabled())
+              return failure_and_continue;
+            // Before any (GPU) work is spent on a frame nobody waits for
+            if (ptr->exceeds_latency_budget(ctx))
+              return ptr->get_latency_budget().on_exceeded ==
+                             LatencyBudget::Action::skip_unit
+                         ? failure_and_continue
+                         : failure_and_stop;
+            // frame may still be referenced by other branches' queues
+            if (ptr->writes_frame_in_place() && Utils::make_writable(frame))
+              copy_on_write_count.inc();
+            return ptr->timed_process(frame, ctx);
+          },
+          [&](const std::shared_ptr<IAsynchronousProcessingUnit> &ptr) {
+            if (ptr->is_disabled())
+              return failure_and_continue;
+            return ptr->enqueue(frame, ctx);
+          },
+      },
+      unit);
+}
+
 bool AsynchronousProcessingUnit::init(const njson &config) {
   // m_exe = std::make_unique<PipelineExecutor>();
 
@@ -38,70 +168,16 @@ bool AsynchronousProcessingUnit::init(const njson &config) {
   for (nlohmann::basic_json<>::size_type i = 0; i < settings_pipeline.size();
        ++i) {
     try {
-      ProcessingUnitVariant ptr;
       const std::string type = settings_pipeline[i]["type"].get<std::string>();
-      if (type == "SynchronousProcessingUnit::rotateAndFlip") {
-        ptr = std::make_unique<RotateAndFlip>(m_unit_path);
-      } else if (type == "SynchronousProcessingUnit::overlayText") {
-        ptr = std::make_unique<OverlayText>(m_unit_path);
-      } else if (type == "SynchronousProcessingUnit::cropFrame") {
-        ptr = std::make_unique<CropFrame>(m_unit_path);
-      } else if (type == "SynchronousProcessingUnit::debugOutput") {
-        ptr = std::make_unique<DebugOutput>(m_unit_path);
-      } else if (type == "SynchronousProcessingUnit::resize") {
-        ptr = std::make_unique<resize>(m_unit_path);
-      } else if (type == "SynchronousProcessingUnit::collectStats") {
-        ptr = std::make_unique<CollectStats>(m_unit_path);
-      } else if (type == "SynchronousProcessingUnit::measureLatency") {
-        ptr = std::make_unique<MeasureLatency>(m_unit_path);
-      } else if (type ==
-                 "SynchronousProcessingUnit::yoloPruneDetectionResults") {
-        ptr = std::make_unique<YoloPruneDetectionResults>(m_unit_path);
-      } else if (type == "AsynchronousProcessingUnit::videoWriter") {
-        ptr = std::make_shared<VideoWriter>(m_unit_path);
-      } else if (type == "AsynchronousProcessingUnit::httpService") {
-        ptr = std::make_shared<HttpService>(m_unit_path);
-      } else if (type == "SynchronousProcessingUnit::yoloDetect") {
-        ptr = std::make_unique<YoloDetect>(m_unit_path);
-      } else if (type == "SynchronousProcessingUnit::sfaceDetect") {
-        ptr = std::make_unique<SfaceDetect>(m_unit_path);
-      } else if (type == "SynchronousProcessingUnit::yuNetOverlayLandmarks") {
-        ptr = std::make_unique<YuNetOverlayLandmarks>(m_unit_path);
-      } else if (type == "SynchronousProcessingUnit::yoloOverlay") {
-        ptr = std::make_unique<YoloOverlay>(m_unit_path);
-      } else if (type == "SynchronousProcessingUnit::autoZoom") {
-        ptr = std::make_unique<AutoZoom>(m_unit_path);
-      } else if (type == "SynchronousProcessingUnit::yoloPublishMqtt") {
-        ptr = std::make_unique<YoloPublishMqtt>(m_unit_path);
-      } else if (type == "SynchronousProcessingUnit::sfaceOverlay") {
-        ptr = std::make_unique<SFaceOverlay>(m_unit_path);
-      } else if (type ==
-                 "AsynchronousProcessingUnit::asynchronousProcessingUnit") {
-        ptr = std::make_unique<AsynchronousProcessingUnit>(m_unit_path);
-      } else if (type == "AsynchronousProcessingUnit::matrixNotifier") {
-        ptr = std::make_shared<MatrixNotifier>(m_unit_path);
-      } else if (type == "AsynchronousProcessingUnit::pipeWriter") {
-        ptr = std::make_shared<PipeWriter>(m_unit_path);
-      } else {
+      auto ptr = create_processing_unit(type, m_unit_path);
+      if (!ptr.has_value()) {
         SPDLOG_WARN("Unrecognized pipeline unit, type: {}, idx: {}", type, i);
         continue;
       }
       SPDLOG_INFO("Adding {}-th processing unit, type: {}", i, type);
-      if (std::visit(
-              overload{
-                  [&](const std::unique_ptr<ISynchronousProcessingUnit> &ptr_) {
-                    return ptr_->init(settings_pipeline[i]);
-                  },
-                  [&](const std::shared_ptr<IAsynchronousProcessingUnit>
-                          &ptr_) {
-                    if (!ptr_->init(settings_pipeline[i]))
-                      return false;
-                    ptr_->start();
-                    return true;
-                  },
-              },
-              ptr)) {
-        m_processing_units.push_back(std::move(ptr));
+      if (init_processing_unit(*ptr, settings_pipeline[i])) {
+        m_processing_units.push_back(std::move(*ptr));
+        m_unit_configs.push_back(settings_pipeline[i]);
         SPDLOG_INFO("Added {}-th processing unit, turned_on_hours: {}", i,
                     fmt::join(m_turned_on_hours, ","));
       } else {
@@ -114,30 +190,275 @@ bool AsynchronousProcessingUnit::init(const njson &config) {
       return false;
     }
   }
+  if (config.contains("stagedExecution") &&
+      config["stagedExecution"].value("enabled", false)) {
+    m_stage_queue_depth = config["stagedExecution"].value(
+        "queueDepth", m_stage_queue_depth);
+    start_stages();
+  }
   return true;
 }
 
+// A nested branch can be reloaded in place if nothing but its pipeline changed
+static bool is_reloadable_in_place(const njson &current_config,
+                                   const njson &new_config) {
+  if (new_config.value("type", "") !=
+      "AsynchronousProcessingUnit::asynchronousProcessingUnit")
+    return false;
+  auto current_settings = current_config;
+  auto new_settings = new_config;
+  current_settings.erase("pipeline");
+  new_settings.erase("pipeline");
+  return current_settings == new_settings;
+}
+
+bool AsynchronousProcessingUnit::reload(const njson &config) {
+  // Where each unit of the new pipeline comes from: a unit of the current
+  // one, by its index, or a newly created and init()ed one
+  struct PlannedUnit {
+    std::optional<size_t> current_idx;
+    std::optional<ProcessingUnitVariant> created;
+    njson config;
+  };
+  std::vector<PlannedUnit> planned_units;
+  std::vector<bool> is_kept(m_processing_units.size(), false);
+  std::vector<std::pair<std::shared_ptr<AsynchronousProcessingUnit>, njson>>
+      nested_reloads;
+  size_t created_count = 0;
+  // If the new pipeline is abandoned, the units already created (and started)
+  // for it are stopped before being destroyed, in reverse order, as removed
+  // units are once the new pipeline is in place
+  const auto stop_created_units = [&planned_units] {
+    for (auto it = planned_units.rbegin(); it != planned_units.rend(); ++it) {
+      if (!it->created.has_value())
+        continue;
+      if (const auto *ptr =
+              std::get_if<std::shared_ptr<IAsynchronousProcessingUnit>>(
+                  &*it->created))
+        (*ptr)->stop();
+    }
+  };
+  try {
+    const auto &settings_pipeline = config.at("pipeline");
+    if (!settings_pipeline.is_array())
+      throw std::invalid_argument("pipeline must be an array");
+    for (size_t i = 0; i < settings_pipeline.size(); ++i) {
+      const auto &unit_config = settings_pipeline[i];
+      const auto find_current = [&](const auto &pred) -> std::optional<size_t> {
+        for (size_t j = 0; j < m_unit_configs.size(); ++j)
+          if (!is_kept[j] && pred(m_unit_configs[j]))
+            return j;
+        return std::nullopt;
+      };
+      if (const auto idx = find_current(
+              [&](const njson &current) { return current == unit_config; })) {
+        is_kept[*idx] = true;
+        planned_units.push_back({idx, std::nullopt, unit_config});
+        continue;
+      }
+      if (const auto idx = find_current([&](const njson &current) {
+            return is_reloadable_in_place(current, unit_config);
+          })) {
+        is_kept[*idx] = true;
+        nested_reloads.emplace_back(
+            std::dynamic_pointer_cast<AsynchronousProcessingUnit>(
+                std::get<std::shared_ptr<IAsynchronousProcessingUnit>>(
+                    m_processing_units[*idx])),
+            unit_config);
+        planned_units.push_back({idx, std::nullopt, unit_config});
+        continue;
+      }
+      const auto type = unit_config.at("type").get<std::string>();
+      auto ptr = create_processing_unit(type, m_unit_path);
+      if (!ptr.has_value()) {
+        SPDLOG_WARN("Unrecognized pipeline unit, type: {}, idx: {}", type, i);
+        continue;
+      }
+      SPDLOG_INFO("Adding {}-th processing unit, type: {}", i, type);
+      // Unlike init(), which skips it, as the current pipeline can be kept
+      if (!init_processing_unit(*ptr, unit_config))
+        throw std::runtime_error(
+            fmt::format("{}-th processing unit ({}) failed to init", i, type));
+      planned_units.push_back({std::nullopt, std::move(*ptr), unit_config});
+      ++created_count;
+    }
+  } catch (const std::exception &e) {
+    SPDLOG_ERROR("{}: reload failed, the current pipeline is kept. e.what(): "
+                 "{}",
+                 m_unit_path, e.what());
+    stop_created_units();
+    return false;
+  }
+  for (const auto &[unit, unit_config] : nested_reloads) {
+    if (unit == nullptr || !unit->reload(unit_config)) {
+      stop_created_units();
+      return false;
+    }
+  }
+
+  std::vector<ProcessingUnitVariant> removed_units;
+  {
+    std::lock_guard lock(m_units_mutex);
+    // The stages index into m_processing_units, they are rebuilt once the
+    // frames already in them are through
+    const bool is_staged = !m_stages.empty();
+    if (is_staged) {
+      stop_stages();
+      m_stages.clear();
+    }
+    std::vector<ProcessingUnitVariant> units;
+    std::vector<njson> unit_configs;
+    for (auto &planned_unit : planned_units) {
+      auto &unit = planned_unit.current_idx.has_value()
+                       ? m_processing_units[*planned_unit.current_idx]
+                       : *planned_unit.created;
+      units.push_back(std::move(unit));
+      unit_configs.push_back(std::move(planned_unit.config));
+    }
+    for (size_t j = 0; j < m_processing_units.size(); ++j)
+      if (!is_kept[j])
+        removed_units.push_back(std::move(m_processing_units[j]));
+    m_processing_units = std::move(units);
+    m_unit_configs = std::move(unit_configs);
+    if (is_staged)
+      start_stages();
+  }
+  SPDLOG_INFO("{}: pipeline reloaded, units kept: {}, created: {}, removed: {}",
+              m_unit_path, m_processing_units.size() - created_count,
+              created_count, removed_units.size());
+  // Stopped (i.e., their queues drained) and destroyed outside the lock.
+  // Stopped explicitly, as in the destructor: the base class' destructor only
+  // stops a unit once its subclass' state (e.g., a VideoWriter's) is gone
+  for (const auto &unit : removed_units) {
+    if (const auto *ptr =
+            std::get_if<std::shared_ptr<IAsynchronousProcessingUnit>>(&unit))
+      (*ptr)->stop();
+  }
+  removed_units.clear();
+  return true;
+}
+
+void AsynchronousProcessingUnit::start_stages() {
+  for (size_t i = 0; i < m_processing_units.size(); ++i) {
+    // Asynchronous units only enqueue, they don't deserve a thread of their
+    // own and join the stage of the unit before them
+    if (m_stages.empty() ||
+        std::holds_alternative<std::unique_ptr<ISynchronousProcessingUnit>>(
+            m_processing_units[i])) {
+      auto stage = std::make_unique<Stage>();
+      stage->first_unit_idx = i;
+      stage->queue =
+          std::make_unique<Utils::MpscRing<AsyncPayload>>(m_stage_queue_depth);
+      stage->arena = std::make_unique<Utils::FrameArena>(
+          get_frame_arena_heap_allocations_counter(m_unit_path));
+      m_stages.push_back(std::move(stage));
+    }
+    m_stages.back()->end_unit_idx = i + 1;
+  }
+  // Only start the threads once m_stages is complete, they push to each other
+  for (size_t i = 0; i < m_stages.size(); ++i) {
+    m_stages[i]->running.store(true);
+    m_stages[i]->thread =
+        std::thread(&AsynchronousProcessingUnit::stage_loop, this, i);
+  }
+  SPDLOG_INFO("{}: staged execution started with {} stages, queue_depth: {}",
+              m_unit_path, m_stages.size(), m_stage_queue_depth);
+}
+
+void AsynchronousProcessingUnit::stop_stages() {
+  // In order, s.t. each stage has received everything from the one before it
+  // by the time it is told to stop, and drains that first
+  for (const auto &stage : m_stages) {
+    stage->running.store(false);
+    stage->queue->wake_all();
+    if (stage->thread.joinable())
+      stage->thread.join();
+  }
+}
+
+void AsynchronousProcessingUnit::stage_loop(const size_t stage_idx) {
+  using namespace std::chrono_literals;
+  auto &stage = *m_stages[stage_idx];
+  Stage *next_stage =
+      stage_idx + 1 < m_stages.size() ? m_stages[stage_idx + 1].get() : nullptr;
+  AsyncPayload payload;
+  while (stage.running.load() || stage.queue->size_approx() > 0) {
+    if (!stage.queue->wait_pop(payload, 100ms))
+      continue;
+    if (ev_flag != 0)
+      continue;
+    payload.ctx.arena = stage.arena->resource();
+    const bool forward = run_units(stage.first_unit_idx, stage.end_unit_idx,
+                                   payload.frame, payload.ctx) &&
+                         next_stage != nullptr;
+    // The frame retires from this stage, the next one sets its own arena
+    payload.ctx.arena = std::pmr::new_delete_resource();
+    stage.arena->reset();
+    if (forward)
+      push_to_stage(*next_stage, std::move(payload));
+    else
+      observe_branch_latency(payload.ctx);
+    // Don't hold on to the frame until the next one arrives
+    payload.frame.release();
+  }
+}
+
+void AsynchronousProcessingUnit::push_to_stage(Stage &stage,
+                                               AsyncPayload &&payload) {
+  using namespace std::chrono_literals;
+  // Frames are never dropped between stages, a slow stage backpressures the
+  // ones before it and, eventually, this unit's own queue policy. Stages run
+  // on threads of their own, so waiting can't starve the executor
+  while (!stage.queue->try_push(std::move(payload))) {
+    stage.queue->wait_while_full(
+        [&stage] {
+          return stage.queue->size_approx() >= stage.queue->capacity();
+        },
+        100ms);
+  }
+}
+
 void AsynchronousProcessingUnit::on_frame_ready(cv::cuda::GpuMat &frame,
                                                 PipelineContext &ctx) {
-  for (size_t i = 0; i < m_processing_units.size() && ev_flag == 0; ++i) {
+  m_frame_count.fetch_add(1, std::memory_order_relaxed);
+  log_cow_stats_throttled();
+  // Without helping the executor while reload() holds it: a pending task
+  // could block on us. reload() itself never waits for the executor while
+  // holding the lock
+  std::lock_guard lock(m_units_mutex);
+  if (!m_stages.empty()) {
+    AsyncPayload payload{frame, ctx};
+    // Our reference would make the first stage copy the frame before writing
+    frame.release();
+    // Ours is reset once we return, the stage sets its own
+    payload.ctx.arena = std::pmr::new_delete_resource();
+    push_to_stage(*m_stages.front(), std::move(payload));
+    return;
+  }
+  run_units(0, m_processing_units.size(), frame, ctx);
+  observe_branch_latency(ctx);
+}
+
+void AsynchronousProcessingUnit::observe_branch_latency(
+    const PipelineContext &ctx) {
+  // Lossless sources' timestamps don't follow the wall clock anyway
+  if (!ctx.device_info->lossless)
+    m_branch_latency->observe(std::chrono::steady_clock::now() -
+                              ctx.capture_timestamp);
+}
+
+bool AsynchronousProcessingUnit::run_units(const size_t first_unit_idx,
+                                           const size_t end_unit_idx,
+                                           cv::cuda::GpuMat &frame,
+                                           PipelineContext &ctx) {
+  for (size_t i = first_unit_idx; i < end_unit_idx && ev_flag == 0; ++i) {
     ctx.processing_unit_idx = i;
-    const auto retval = std::visit(
-        overload{
-            [&](const std::unique_ptr<ISynchronousProcessingUnit> &ptr) {
-              if (ptr->is_disabled())
-                return failure_and_continue;
-              return ptr->process(frame, ctx);
-            },
-            [&](const std::shared_ptr<IAsynchronousProcessingUnit> &ptr) {
-              if (ptr->is_disabled())
-                return failure_and_continue;
-              return ptr->enqueue(frame, ctx);
-            },
-        },
-        m_processing_units[i]);
+    const auto retval = run_processing_unit(m_processing_units[i], frame, ctx,
+                                            *m_copy_on_write_count);
     if (retval == failure_and_stop || retval == success_and_stop)
-      break;
+      return false;
   }
+  return true;
 }
 
 } // namespace MatrixPipeline::ProcessingUnit
\ No newline at end of file
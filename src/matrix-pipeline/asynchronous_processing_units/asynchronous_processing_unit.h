@@ -3,17 +3,115 @@
 #include "../entities/processing_units_variant.h"
 #include "../interfaces/i_asynchronous_processing_unit.h"
 
+#include <mutex>
+#include <optional>
+
 namespace MatrixPipeline::ProcessingUnit {
 
+/**
+ * @brief Creates the unit of a pipeline config's "type", e.g.,
+ * "SynchronousProcessingUnit::resize", under parent_unit_path.
+ * @return std::nullopt if type is not recognized
+ */
+std::optional<ProcessingUnitVariant>
+create_processing_unit(const std::string &type,
+                       const std::string &parent_unit_path);
+
+/**
+ * @brief init()s the unit with its config and, for asynchronous units,
+ * configures their queue and starts them
+ */
+bool init_processing_unit(const ProcessingUnitVariant &unit,
+                          const njson &config);
+
+/**
+ * @brief Runs one unit of a branch on frame: synchronous units process it
+ * (unless disabled or over their latency budget), asynchronous units get it
+ * enqueued
+ */
+SynchronousProcessingResult
+run_processing_unit(const ProcessingUnitVariant &unit, cv::cuda::GpuMat &frame,
+                    PipelineContext &ctx, Utils::Counter &copy_on_write_count);
+
 class AsynchronousProcessingUnit final : public IAsynchronousProcessingUnit {
   std::vector<ProcessingUnitVariant> m_processing_units;
+  // The config of each of m_processing_units, s.t. reload() can tell which
+  // ones are unchanged
+  std::vector<njson> m_unit_configs;
+  // Held by on_frame_ready() for the whole frame and by reload() to swap
+  // m_processing_units, i.e., the swap happens between frames
+  std::mutex m_units_mutex;
+  // Frames are shared by reference among branches and only copied right
+  // before a unit writes into them, these count how often that happens
+  std::atomic<uint64_t> m_frame_count{0};
+  std::shared_ptr<Utils::Counter> m_copy_on_write_count;
+  std::chrono::steady_clock::time_point m_last_cow_stats_log_time;
+  void log_cow_stats_throttled();
+  // From capture to the frame leaving this branch, i.e., to its last unit or
+  // to the unit that stopped it
+  std::shared_ptr<Utils::Histogram> m_branch_latency;
+  void observe_branch_latency(const PipelineContext &ctx);
+
+  /**
+   * @brief With "stagedExecution" enabled, the branch is split into stages,
+   * one per synchronous unit (plus the asynchronous units right after it),
+   * each on its own thread and connected by bounded queues. Stage i then
+   * works on frame n while stage i + 1 works on frame n - 1, i.e., the
+   * branch's throughput is set by its slowest unit instead of by the sum of
+   * all of them. Frames pass every stage in order.
+   */
+  struct Stage {
+    // [first_unit_idx, end_unit_idx) in m_processing_units
+    size_t first_unit_idx = 0;
+    size_t end_unit_idx = 0;
+    std::unique_ptr<Utils::MpscRing<AsyncPayload>> queue;
+    std::atomic<bool> running{false};
+    std::thread thread;
+    // The stage's thread owns it, it replaces the unit's own arena
+    std::unique_ptr<Utils::FrameArena> arena;
+  };
+  std::vector<std::unique_ptr<Stage>> m_stages;
+  size_t m_stage_queue_depth = 2;
+  void start_stages();
+  void stop_stages();
+  void stage_loop(size_t stage_idx);
+  void push_to_stage(Stage &stage, AsyncPayload &&payload);
+  // Returns false if a unit asked for the frame not to be processed further
+  bool run_units(size_t first_unit_idx, size_t end_unit_idx,
+                 cv::cuda::GpuMat &frame, PipelineContext &ctx);
 
 public:
   explicit AsynchronousProcessingUnit(const std::string &unit_path)
-      : IAsynchronousProcessingUnit(unit_path + "/AsynchronousProcessingUnit") {
-  }
+      : IAsynchronousProcessingUnit(unit_path + "/AsynchronousProcessingUnit"),
+        m_copy_on_write_count(Utils::MetricsRegistry::instance().counter(
+            "matrix_pipeline_unit_copy_on_write_frames_total",
+            "Shared frames copied before a unit wrote into them",
+            {{"unit", m_unit_path}})),
+        m_branch_latency(Utils::MetricsRegistry::instance().histogram(
+            "matrix_pipeline_branch_latency_seconds",
+            "Time from a frame's capture to it leaving the branch",
+            {{"unit", m_unit_path}})) {}
+  ~AsynchronousProcessingUnit() override;
   bool init(const njson &config) override;
+  /**
+   * @brief Applies config's "pipeline" to the running branch: units whose
+   * config is unchanged are kept as they are (GPU resources, TensorRT engines
+   * and all), nested branches whose own settings are unchanged are reloaded
+   * recursively, and only new or changed units are created and init()ed.
+   * They are swapped in between two frames; with staged execution, frames
+   * already in the stages go through the old units first.
+   *
+   * The branch's other settings (its queue, latency budget, turnedOnHours,
+   * etc.) aren't reloaded. Reloads must not run concurrently.
+   * @return false if config is invalid or a new unit fails to init(), the
+   * current pipeline is kept then (nested branches already reloaded
+   * excepted)
+   */
+  bool reload(const njson &config);
   void on_frame_ready(cv::cuda::GpuMat &frame, PipelineContext &ctx) override;
+  [[nodiscard]] uint64_t get_copy_on_write_count() const {
+    return m_copy_on_write_count->value();
+  }
 };
 
 } // namespace MatrixPipeline::ProcessingUnit
\ No newline at end of file
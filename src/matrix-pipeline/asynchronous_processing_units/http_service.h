@@ -24,7 +24,12 @@ namespace MatrixPipeline::ProcessingUnit {
 class HttpService;
 
 // --- Static Global State ---
-inline std::map<uint16_t, HttpService *> s_service_registry;
+// port -> (service name -> service). Multiple devices in the same process can
+// share one port, the service is then selected via the "name" query parameter
+inline std::map<uint16_t, std::map<std::string, HttpService *>>
+    s_service_registry;
+// port -> bindAddr of the listeners added so far
+inline std::map<uint16_t, std::string> s_listeners;
 inline std::mutex s_registry_mutex;
 inline std::atomic s_global_handler_registered{false};
 
@@ -41,7 +46,11 @@ public:
   ~HttpService() override {
     std::lock_guard<std::mutex> lock(s_registry_mutex);
     if (m_port > 0) {
-      s_service_registry.erase(m_port);
+      if (const auto it = s_service_registry.find(m_port);
+          it != s_service_registry.end() && it->second.contains(m_name) &&
+          it->second.at(m_name) == this) {
+        it->second.erase(m_name);
+      }
     }
   }
 
@@ -51,6 +60,7 @@ public:
 
       m_ip = config.value("bindAddr", "127.0.0.1");
       m_port = config.value("port", 8080);
+      m_name = config.value("name", "");
 
       if (config.contains("username") && config.contains("password")) {
         m_auth_enabled = true;
@@ -67,14 +77,31 @@ public:
 
       {
         std::lock_guard<std::mutex> lock(s_registry_mutex);
-        if (s_service_registry.find(m_port) != s_service_registry.end()) {
-          SPDLOG_WARN("Port {} is already claimed!", m_port);
+        auto &services = s_service_registry[m_port];
+        if (services.contains(m_name)) {
+          SPDLOG_WARN("Port {} with name '{}' is already claimed!", m_port,
+                      m_name);
+        }
+        services[m_name] = this;
+        // Listeners are per-port, a second service on the same port only
+        // registers itself and reuses the existing listener. Drogon ignores
+        // listeners added once it runs, i.e., by a reload
+        if (const auto it = s_listeners.find(m_port);
+            it == s_listeners.end()) {
+          if (app().isRunning()) {
+            SPDLOG_WARN("Listening on {}:{} takes effect after a restart",
+                        m_ip, m_port);
+          } else {
+            app().addListener(m_ip, m_port, use_https, cert_path, key_path);
+            s_listeners.emplace(m_port, m_ip);
+          }
+        } else if (it->second != m_ip) {
+          SPDLOG_WARN("Port {} is bound to {}, bindAddr {} takes effect after "
+                      "a restart",
+                      m_port, it->second, m_ip);
         }
-        s_service_registry[m_port] = this;
       }
 
-      app().addListener(m_ip, m_port, use_https, cert_path, key_path);
-
       bool expected = false;
       if (s_global_handler_registered.compare_exchange_strong(expected, true)) {
 
@@ -97,9 +124,10 @@ public:
             {Get});
       }
 
-      SPDLOG_INFO("HttpService initialized on {}:{} (HTTPS: {}), "
+      SPDLOG_INFO("HttpService initialized on {}:{} (name: '{}', HTTPS: {}), "
                   "refresh_interval_sec: {}",
-                  m_ip, m_port, use_https, m_refresh_interval_sec.count());
+                  m_ip, m_port, m_name, use_https,
+                  m_refresh_interval_sec.count());
       return true;
     } catch (const std::exception &e) {
       SPDLOG_ERROR("Failed to init HttpService: {}", e.what());
@@ -113,12 +141,18 @@ public:
                    std::function<void(const HttpResponsePtr &)> &&callback,
                    bool is_stream) {
     uint16_t local_port = req->getLocalAddr().toPort();
+    const auto &name = req->getParameter("name");
     HttpService *service = nullptr;
     {
       std::lock_guard<std::mutex> lock(s_registry_mutex);
-      auto it = s_service_registry.find(local_port);
-      if (it != s_service_registry.end())
-        service = it->second;
+      if (const auto it = s_service_registry.find(local_port);
+          it != s_service_registry.end()) {
+        if (const auto jt = it->second.find(name); jt != it->second.end())
+          service = jt->second;
+        else if (name.empty() && it->second.size() == 1)
+          // Backward compatible: a port serving a single device needs no name
+          service = it->second.begin()->second;
+      }
     }
 
     if (service) {
@@ -129,7 +163,8 @@ public:
     } else {
       auto resp = HttpResponse::newHttpResponse();
       resp->setStatusCode(k404NotFound);
-      resp->setBody("No Service attached to this port");
+      resp->setBody(
+          fmt::format("No Service named '{}' attached to this port", name));
       callback(resp);
     }
   }
@@ -304,6 +339,7 @@ private:
 
   std::string m_ip;
   uint16_t m_port = 0;
+  std::string m_name;
   bool m_auth_enabled = false;
   std::string m_username;
   std::string m_password;
@@ -18,7 +18,7 @@ RoiLookupResult MatrixNotifier::look_for_roi(const PipelineContext &ctx) const {
   // The order cant be switched, we need to check sface roi first, as it can
   // terminate the rest by returning Suppress;
   if (m_enable_sface_roi) {
-    for (const auto &[detection, recognition] : ctx.yunet_sface.results) {
+    for (const auto &[detection, recognition] : ctx.yunet_sface->results) {
       if (!recognition.l2_norm_threshold_crossed ||
           !recognition.cosine_score_threshold_crossed)
         continue;
@@ -31,9 +31,10 @@ RoiLookupResult MatrixNotifier::look_for_roi(const PipelineContext &ctx) const {
   }
 
   if (m_enable_yolo_roi) {
-    if (std::ranges::any_of(ctx.yolo.indices, [&](auto idx) {
-          return ctx.yolo.is_detection_interesting[idx];
-        })) {
+    if (std::ranges::any_of(ctx.yolo->detections.is_interesting(),
+                            [](const auto is_interesting) {
+                              return is_interesting != 0;
+                            })) {
       return Found;
     }
   }
@@ -292,35 +293,36 @@ void MatrixNotifier::handle_video(const cv::cuda::GpuMat &frame,
 }
 
 double MatrixNotifier::calculate_roi_score(const PipelineContext &ctx) const {
-  const auto &yolo = ctx.yolo;
+  const auto &yolo = *ctx.yolo;
+  const auto &detections = yolo.detections;
   double roi_value = 0.0;
 
   if (m_enable_yolo_roi) {
-    for (const auto idx : yolo.indices) {
+    for (size_t i = 0; i < detections.size(); ++i) {
 
-      if (yolo.class_ids[idx] == 0 && yolo.is_detection_interesting[idx]) {
+      if (detections.class_ids()[i] == 0 && detections.is_interesting()[i]) {
         const auto normalized_area =
-            static_cast<double>(yolo.bounding_boxes[idx].area()) /
-            yolo.inference_input_size.area();
-        roi_value += normalized_area * yolo.confidences[idx] *
-                     pow(yolo.indices.size(), 0.5);
+            static_cast<double>(detections.boxes()[i].area()) /
+            yolo.source_frame_size.area();
+        roi_value += normalized_area * detections.confidences()[i] *
+                     pow(detections.size(), 0.5);
       }
     }
   }
 
   if (m_enable_sface_roi) {
-    for (const auto &[detection, recognition] : ctx.yunet_sface.results) {
+    for (const auto &[detection, recognition] : ctx.yunet_sface->results) {
 
       const auto normalized_area =
           detection.bounding_box.area() /
-          static_cast<float>(ctx.yunet_sface.yunet_input_frame_size.area());
+          static_cast<float>(ctx.yunet_sface->yunet_input_frame_size.area());
       if (std::isnan(recognition.cosine_score))
         continue;
 
       roi_value += normalized_area * recognition.cosine_score *
                    m_identity_to_weight_map.at(recognition.category) *
                    m_detection_recognition_weight_ratio *
-                   pow(ctx.yunet_sface.results.size(), 0.5);
+                   pow(ctx.yunet_sface->results.size(), 0.5);
     }
   }
 
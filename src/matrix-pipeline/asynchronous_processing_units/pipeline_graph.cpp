@@ -0,0 +1,423 @@
+#include "pipeline_graph.h"
+#include "asynchronous_processing_unit.h"
+
+#include <fmt/ranges.h>
+#include <opencv2/dnn.hpp>
+#include <spdlog/spdlog.h>
+
+#include <map>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+namespace MatrixPipeline::ProcessingUnit {
+
+namespace {
+
+struct MetadataFields {
+  bool yolo = false;
+  bool yunet_sface = false;
+  bool change_rate = false;
+};
+
+// Detections of two models are in the coordinates of the frame each of them
+// ran on, these map from's boxes into into's via the source frame both of them
+// cover. Snapshots are only copied if both sides have detections
+void merge_yolo(SharedSnapshot<YoloContext> &into_snapshot,
+                const SharedSnapshot<YoloContext> &from_snapshot,
+                const float nms_threshold) {
+  const auto &from = *from_snapshot;
+  if (from.source_frame_size.empty() || from.detections.empty())
+    return;
+  if (into_snapshot->source_frame_size.empty()) {
+    into_snapshot = from_snapshot;
+    return;
+  }
+  auto into = into_snapshot.copy();
+  // Both streams cover the same field of view, see
+  // YoloDetect::get_bounding_box_scale()
+  const auto stretch_x = static_cast<double>(into.source_frame_size.width) /
+                         from.source_frame_size.width;
+  const auto stretch_y = static_cast<double>(into.source_frame_size.height) /
+                         from.source_frame_size.height;
+  for (size_t i = 0; i < from.detections.size(); ++i) {
+    const auto &box = from.detections.boxes()[i];
+    into.detections.push_back(
+        cv::Rect(static_cast<int>(box.x * stretch_x),
+                 static_cast<int>(box.y * stretch_y),
+                 static_cast<int>(box.width * stretch_x),
+                 static_cast<int>(box.height * stretch_y)),
+        from.detections.class_ids()[i], from.detections.confidences()[i],
+        from.detections.is_interesting()[i]);
+  }
+  // The same object is usually detected by both models
+  const auto boxes = into.detections.boxes();
+  const auto confidences = into.detections.confidences();
+  std::vector<int> kept;
+  cv::dnn::NMSBoxes(std::vector<cv::Rect>(boxes.begin(), boxes.end()),
+                    std::vector<float>(confidences.begin(), confidences.end()),
+                    0.0f, nms_threshold, kept);
+  into.detections.retain(kept);
+  into_snapshot = std::move(into);
+}
+
+void merge_yunet_sface(SharedSnapshot<YuNetSFaceContext> &into_snapshot,
+                       const SharedSnapshot<YuNetSFaceContext> &from_snapshot) {
+  const auto &from = *from_snapshot;
+  if (from.results.empty())
+    return;
+  if (into_snapshot->results.empty()) {
+    into_snapshot = from_snapshot;
+    return;
+  }
+  // Landmarks are in yunet_input_frame_size's space, which we can't remap
+  // without the raw YuNet output
+  if (into_snapshot->yunet_input_frame_size != from.yunet_input_frame_size)
+    return;
+  auto into = into_snapshot.copy();
+  into.results.insert(into.results.end(), from.results.begin(),
+                      from.results.end());
+  into_snapshot = std::move(into);
+}
+
+} // namespace
+
+class PipelineGraph::Node final : public IAsynchronousProcessingUnit {
+public:
+  struct Input {
+    std::string from;
+    bool is_frame = true;
+    MetadataFields fields;
+  };
+
+  Node(const std::string &graph_path, const std::string &name,
+       std::vector<Input> inputs)
+      : IAsynchronousProcessingUnit(graph_path + "/" + name),
+        m_inputs(std::move(inputs)),
+        m_copy_on_write_count(Utils::MetricsRegistry::instance().counter(
+            "matrix_pipeline_graph_node_copy_on_write_frames_total",
+            "Shared frames copied before a unit of a graph node wrote into "
+            "them, i.e., the frame a node received was still used elsewhere",
+            {{"unit", m_unit_path}})),
+        m_branch_latency(Utils::MetricsRegistry::instance().histogram(
+            "matrix_pipeline_graph_node_latency_seconds",
+            "Time from a frame's capture to it leaving the graph node, joins "
+            "included",
+            {{"unit", m_unit_path}})),
+        m_incomplete_join_count(Utils::MetricsRegistry::instance().counter(
+            "matrix_pipeline_graph_incomplete_joins_total",
+            "Frames discarded by a join as not all its inputs delivered them",
+            {{"unit", m_unit_path}})) {
+    for (size_t i = 0; i < m_inputs.size(); ++i) {
+      if (m_inputs[i].is_frame)
+        m_frame_input_idx = i;
+    }
+  }
+
+  ~Node() override {
+    stop();
+    for (const auto &unit : m_processing_units) {
+      if (const auto *ptr =
+              std::get_if<std::shared_ptr<IAsynchronousProcessingUnit>>(&unit))
+        (*ptr)->stop();
+    }
+  }
+
+  bool init(const njson &config) override {
+    m_yolo_nms_threshold =
+        config.value("yoloNmsThreshold", m_yolo_nms_threshold);
+    const auto max_pending_joins = config.value(
+        "maxPendingJoins", static_cast<int>(m_max_pending_joins));
+    if (max_pending_joins < 1) {
+      SPDLOG_ERROR("{}: maxPendingJoins must be at least 1, not {}",
+                   m_unit_path, max_pending_joins);
+      return false;
+    }
+    m_max_pending_joins = static_cast<size_t>(max_pending_joins);
+    const auto settings_pipeline = config.value("pipeline", njson::array());
+    for (size_t i = 0; i < settings_pipeline.size(); ++i) {
+      const auto type = settings_pipeline[i].at("type").get<std::string>();
+      auto unit = create_processing_unit(type, m_unit_path);
+      // Unlike a plain pipeline, a graph with holes isn't started at all
+      if (!unit.has_value()) {
+        SPDLOG_ERROR("{}: unrecognized pipeline unit, type: {}, idx: {}",
+                     m_unit_path, type, i);
+        return false;
+      }
+      if (!init_processing_unit(*unit, settings_pipeline[i])) {
+        SPDLOG_ERROR("{}: failed to init {}-th processing unit, type: {}",
+                     m_unit_path, i, type);
+        return false;
+      }
+      m_processing_units.push_back(std::move(*unit));
+    }
+    return true;
+  }
+
+  [[nodiscard]] const std::vector<Input> &get_inputs() const {
+    return m_inputs;
+  }
+
+  void add_output(Node *consumer, const size_t input_idx) {
+    m_outputs.emplace_back(consumer, input_idx);
+  }
+
+  /**
+   * @brief Called by the producer of the input_idx-th input, on its own
+   * thread. Each producer delivers frames in frame_seq_num order, which is
+   * what lets joins tell a frame that is late from one that never comes.
+   */
+  void deliver(const size_t input_idx, const cv::cuda::GpuMat &frame,
+               const PipelineContext &ctx) {
+    if (m_inputs.size() == 1) {
+      enqueue(frame, ctx);
+      return;
+    }
+    const auto seq = ctx.frame_seq_num;
+    std::unique_lock lock(m_join_mutex);
+    for (auto it = m_pending_joins.begin();
+         it != m_pending_joins.end() && it->first < seq;) {
+      if (it->second.ctxs[input_idx].has_value()) {
+        ++it;
+        continue;
+      }
+      it = m_pending_joins.erase(it);
+      m_incomplete_join_count->inc();
+    }
+    auto &pending = m_pending_joins[seq];
+    if (pending.ctxs.empty())
+      pending.ctxs.resize(m_inputs.size());
+    if (m_inputs[input_idx].is_frame)
+      pending.frame = frame;
+    pending.ctxs[input_idx] = ctx;
+    if (++pending.arrived_count < m_inputs.size()) {
+      // Frames stopped or dropped by some branch leave incomplete joins
+      // behind, this bounds them (and the frames they pin) even if an input
+      // stops delivering altogether
+      while (m_pending_joins.size() > m_max_pending_joins) {
+        m_pending_joins.erase(m_pending_joins.begin());
+        m_incomplete_join_count->inc();
+      }
+      return;
+    }
+    auto joined = std::move(m_pending_joins.extract(seq).mapped());
+    // Joins still complete in order without the lock: frame n + 1 can only
+    // complete once the producer completing frame n (which delivers it, too)
+    // has returned from this call
+    lock.unlock();
+
+    auto &joined_ctx = *joined.ctxs[m_frame_input_idx];
+    for (size_t i = 0; i < m_inputs.size(); ++i) {
+      if (i == m_frame_input_idx)
+        continue;
+      const auto &fields = m_inputs[i].fields;
+      const auto &metadata = *joined.ctxs[i];
+      if (fields.yolo)
+        merge_yolo(joined_ctx.yolo, metadata.yolo, m_yolo_nms_threshold);
+      if (fields.yunet_sface)
+        merge_yunet_sface(joined_ctx.yunet_sface, metadata.yunet_sface);
+      if (fields.change_rate)
+        joined_ctx.change_rate = metadata.change_rate;
+    }
+    enqueue(joined.frame, joined_ctx);
+  }
+
+protected:
+  void on_frame_ready(cv::cuda::GpuMat &frame, PipelineContext &ctx) override {
+    for (size_t i = 0; i < m_processing_units.size() && ev_flag == 0; ++i) {
+      ctx.processing_unit_idx = i;
+      const auto retval = run_processing_unit(m_processing_units[i], frame,
+                                              ctx, *m_copy_on_write_count);
+      if (retval == failure_and_stop || retval == success_and_stop) {
+        observe_branch_latency(ctx);
+        return;
+      }
+    }
+    observe_branch_latency(ctx);
+    for (const auto &[consumer, input_idx] : m_outputs)
+      consumer->deliver(input_idx, frame, ctx);
+  }
+
+private:
+  struct PendingJoin {
+    // Of the frame input, the other inputs only contribute their ctx
+    cv::cuda::GpuMat frame;
+    std::vector<std::optional<PipelineContext>> ctxs;
+    size_t arrived_count = 0;
+  };
+
+  void observe_branch_latency(const PipelineContext &ctx) const {
+    // Lossless sources' timestamps don't follow the wall clock anyway
+    if (!ctx.device_info->lossless)
+      m_branch_latency->observe(std::chrono::steady_clock::now() -
+                                ctx.capture_timestamp);
+  }
+
+  const std::vector<Input> m_inputs;
+  size_t m_frame_input_idx = 0;
+  float m_yolo_nms_threshold = 0.45f;
+  // Each of them may hold a frame, so only enough to cover the skew between
+  // the inputs' branches
+  size_t m_max_pending_joins = 8;
+  std::vector<ProcessingUnitVariant> m_processing_units;
+  // (consumer, consumer's input idx) pairs
+  std::vector<std::pair<Node *, size_t>> m_outputs;
+  std::mutex m_join_mutex;
+  std::map<uint32_t, PendingJoin> m_pending_joins;
+  std::shared_ptr<Utils::Counter> m_copy_on_write_count;
+  std::shared_ptr<Utils::Histogram> m_branch_latency;
+  std::shared_ptr<Utils::Counter> m_incomplete_join_count;
+};
+
+PipelineGraph::~PipelineGraph() {
+  // Stop our own worker first s.t. nothing is delivered to the nodes anymore,
+  // then the nodes in topological order, s.t. each of them has received
+  // everything from its producers by the time it is stopped and drains that
+  stop();
+  for (const auto &node : m_nodes)
+    node->stop();
+}
+
+bool PipelineGraph::init(const njson &config) {
+  constexpr auto input_name = "input";
+  const auto &settings_nodes = config.at("nodes");
+  if (!settings_nodes.is_array() || settings_nodes.empty()) {
+    SPDLOG_ERROR("{}: nodes must be a non-empty array", m_unit_path);
+    return false;
+  }
+
+  std::unordered_map<std::string, size_t> name_to_idx;
+  for (size_t i = 0; i < settings_nodes.size(); ++i) {
+    const auto name = settings_nodes[i].value("name", "");
+    if (name.empty() || name == input_name || name.contains('/')) {
+      SPDLOG_ERROR("{}: {}-th node has an invalid name: [{}]", m_unit_path, i,
+                   name);
+      return false;
+    }
+    if (!name_to_idx.emplace(name, i).second) {
+      SPDLOG_ERROR("{}: node name [{}] is not unique", m_unit_path, name);
+      return false;
+    }
+  }
+
+  std::vector<std::vector<Node::Input>> node_inputs(settings_nodes.size());
+  // Producer idx -> consumer idxes, "input" excluded
+  std::vector<std::vector<size_t>> consumers(settings_nodes.size());
+  std::vector<size_t> producer_counts(settings_nodes.size(), 0);
+  for (size_t i = 0; i < settings_nodes.size(); ++i) {
+    const auto name = settings_nodes[i].at("name").get<std::string>();
+    const auto settings_inputs = settings_nodes[i].value(
+        "inputs", njson::array({{{"from", input_name}}}));
+    size_t frame_input_count = 0;
+    for (const auto &settings_input : settings_inputs) {
+      Node::Input input;
+      input.from = settings_input.at("from").get<std::string>();
+      const auto stream = settings_input.value("stream", "frame");
+      if (stream != "frame" && stream != "metadata") {
+        SPDLOG_ERROR("{}: node [{}] has an input of unrecognized stream: {}",
+                     m_unit_path, name, stream);
+        return false;
+      }
+      input.is_frame = stream == "frame";
+      frame_input_count += input.is_frame;
+      const auto fields = settings_input.value(
+          "fields", std::vector<std::string>{"yolo", "yunetSface"});
+      for (const auto &field : fields) {
+        if (field == "yolo") {
+          input.fields.yolo = true;
+        } else if (field == "yunetSface") {
+          input.fields.yunet_sface = true;
+        } else if (field == "changeRate") {
+          input.fields.change_rate = true;
+        } else {
+          SPDLOG_ERROR("{}: node [{}] has an input of unrecognized field: {}",
+                       m_unit_path, name, field);
+          return false;
+        }
+      }
+      for (const auto &other : node_inputs[i]) {
+        if (other.from == input.from) {
+          SPDLOG_ERROR("{}: node [{}] has more than one input from [{}]",
+                       m_unit_path, name, input.from);
+          return false;
+        }
+      }
+      if (input.from != input_name) {
+        const auto it = name_to_idx.find(input.from);
+        if (it == name_to_idx.end()) {
+          SPDLOG_ERROR("{}: node [{}] has an input from unknown node [{}]",
+                       m_unit_path, name, input.from);
+          return false;
+        }
+        consumers[it->second].push_back(i);
+        ++producer_counts[i];
+      }
+      node_inputs[i].push_back(std::move(input));
+    }
+    if (frame_input_count != 1) {
+      SPDLOG_ERROR("{}: node [{}] must have exactly one frame input, it has {}",
+                   m_unit_path, name, frame_input_count);
+      return false;
+    }
+  }
+
+  // Kahn's algorithm, whatever is left unsorted is on a cycle
+  std::vector<size_t> sorted_idxes;
+  for (size_t i = 0; i < settings_nodes.size(); ++i) {
+    if (producer_counts[i] == 0)
+      sorted_idxes.push_back(i);
+  }
+  for (size_t i = 0; i < sorted_idxes.size(); ++i) {
+    for (const auto consumer_idx : consumers[sorted_idxes[i]]) {
+      if (--producer_counts[consumer_idx] == 0)
+        sorted_idxes.push_back(consumer_idx);
+    }
+  }
+  if (sorted_idxes.size() != settings_nodes.size()) {
+    std::vector<std::string> cycle_names;
+    for (size_t i = 0; i < settings_nodes.size(); ++i) {
+      if (producer_counts[i] > 0)
+        cycle_names.push_back(settings_nodes[i].at("name").get<std::string>());
+    }
+    SPDLOG_ERROR("{}: nodes [{}] form a cycle", m_unit_path,
+                 fmt::join(cycle_names, ", "));
+    return false;
+  }
+
+  std::vector<Node *> nodes_by_idx(settings_nodes.size(), nullptr);
+  for (const auto idx : sorted_idxes) {
+    const auto name = settings_nodes[idx].at("name").get<std::string>();
+    auto node =
+        std::make_shared<Node>(m_unit_path, name, std::move(node_inputs[idx]));
+    SPDLOG_INFO("{}: adding node [{}]", m_unit_path, name);
+    if (!init_processing_unit(node, settings_nodes[idx])) {
+      SPDLOG_ERROR("{}: failed to init node [{}]", m_unit_path, name);
+      return false;
+    }
+    nodes_by_idx[idx] = node.get();
+    m_nodes.push_back(std::move(node));
+  }
+  // Nodes are already started, but no frame reaches them before the graph
+  // itself is
+  for (const auto &node : m_nodes) {
+    const auto &inputs = node->get_inputs();
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      if (inputs[i].from == input_name)
+        m_input_consumers.emplace_back(node.get(), i);
+      else
+        nodes_by_idx[name_to_idx.at(inputs[i].from)]->add_output(node.get(),
+                                                                 i);
+    }
+  }
+  SPDLOG_INFO("{}: graph of {} nodes initialized", m_unit_path,
+              m_nodes.size());
+  return true;
+}
+
+void PipelineGraph::on_frame_ready(cv::cuda::GpuMat &frame,
+                                   PipelineContext &ctx) {
+  for (const auto &[consumer, input_idx] : m_input_consumers)
+    consumer->deliver(input_idx, frame, ctx);
+}
+
+} // namespace MatrixPipeline::ProcessingUnit
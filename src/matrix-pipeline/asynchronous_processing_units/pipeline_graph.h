@@ -0,0 +1,67 @@
+#pragma once
+
+#include "../entities/processing_units_variant.h"
+#include "../interfaces/i_asynchronous_processing_unit.h"
+
+#include <nlohmann/json.hpp>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace MatrixPipeline::ProcessingUnit {
+
+using njson = nlohmann::json;
+
+/**
+ * @brief A declarative DAG of branches, for topologies nesting
+ * asynchronousProcessingUnits can't express, e.g., two YOLO models running
+ * concurrently on the same frame with their detections merged afterwards:
+ *
+ * {"type": "AsynchronousProcessingUnit::pipelineGraph", "nodes": [
+ *   {"name": "yoloS", "pipeline": [{"type": "...::yoloDetect", ...}]},
+ *   {"name": "yoloM", "pipeline": [{"type": "...::yoloDetect", ...}]},
+ *   {"name": "merged",
+ *    "inputs": [{"from": "input", "stream": "frame"},
+ *               {"from": "yoloS", "stream": "metadata", "fields": ["yolo"]},
+ *               {"from": "yoloM", "stream": "metadata", "fields": ["yolo"]}],
+ *    "pipeline": [{"type": "...::yoloOverlay"}, {"type": "...::httpService"}]}
+ * ]}
+ *
+ * Each node is a branch of its own (i.e., with its own queue, queuePolicy,
+ * latencyBudgetMs and thread or executor task), s.t. nodes not depending on
+ * each other run concurrently. "input" stands for the frames the graph
+ * receives, nodes without "inputs" take them.
+ *
+ * A "frame" edge passes the frame (shared by reference, as with nested
+ * branches) along with its ctx, a "metadata" edge only the listed results in
+ * ctx ("yolo", "yunetSface", "changeRate"). Every node has exactly one frame
+ * input. Nodes with more than one input join them by frame_seq_num, i.e., run
+ * once per frame after all their inputs delivered it; frames that one of them
+ * stopped or dropped are discarded. A join keeps up to "maxPendingJoins" (8 by
+ * default) frames waiting for their other inputs, the oldest ones are
+ * discarded beyond that.
+ *
+ * The graph (names, edges, cycles, unit types) is validated by init().
+ */
+class PipelineGraph final : public IAsynchronousProcessingUnit {
+public:
+  explicit PipelineGraph(const std::string &unit_path)
+      : IAsynchronousProcessingUnit(unit_path + "/PipelineGraph") {}
+  ~PipelineGraph() override;
+
+  bool init(const njson &config) override;
+
+protected:
+  void on_frame_ready(cv::cuda::GpuMat &frame, PipelineContext &ctx) override;
+
+private:
+  class Node;
+  // In topological order
+  std::vector<std::shared_ptr<Node>> m_nodes;
+  // (node, input idx) pairs fed by the graph's own input
+  std::vector<std::pair<Node *, size_t>> m_input_consumers;
+};
+
+} // namespace MatrixPipeline::ProcessingUnit
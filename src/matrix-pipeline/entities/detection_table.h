@@ -0,0 +1,155 @@
+#pragma once
+
+#include <opencv2/core/types.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace MatrixPipeline::ProcessingUnit {
+
+/**
+ * @brief Detections stored column by column (struct of arrays), one row per
+ * detection. Up to inline_capacity rows live inside the table itself, i.e.,
+ * the common frame costs no allocation beyond the one of the snapshot holding
+ * the table; only frames with more detections spill all columns to the heap.
+ *
+ * Rows are the detections that survived NMS, s.t. consumers iterate the
+ * columns directly instead of going through an index list.
+ */
+class DetectionTable {
+public:
+  static constexpr size_t inline_capacity = 64;
+
+  DetectionTable() = default;
+  // Copies and moves only touch the rows in use, not all of the inline
+  // capacity
+  DetectionTable(const DetectionTable &other) { *this = other; }
+  DetectionTable(DetectionTable &&other) noexcept { *this = std::move(other); }
+  DetectionTable &operator=(const DetectionTable &other) {
+    if (this != &other) {
+      m_size = other.m_size;
+      m_boxes.assign(other.m_boxes, m_size);
+      m_class_ids.assign(other.m_class_ids, m_size);
+      m_confidences.assign(other.m_confidences, m_size);
+      m_is_interesting.assign(other.m_is_interesting, m_size);
+    }
+    return *this;
+  }
+  DetectionTable &operator=(DetectionTable &&other) noexcept {
+    if (this != &other) {
+      m_size = other.m_size;
+      m_boxes.assign(std::move(other.m_boxes), m_size);
+      m_class_ids.assign(std::move(other.m_class_ids), m_size);
+      m_confidences.assign(std::move(other.m_confidences), m_size);
+      m_is_interesting.assign(std::move(other.m_is_interesting), m_size);
+      other.clear();
+    }
+    return *this;
+  }
+
+  [[nodiscard]] size_t size() const { return m_size; }
+  [[nodiscard]] bool empty() const { return m_size == 0; }
+
+  void clear() {
+    m_size = 0;
+    m_boxes.clear();
+    m_class_ids.clear();
+    m_confidences.clear();
+    m_is_interesting.clear();
+  }
+
+  void push_back(const cv::Rect &box, const int class_id,
+                 const float confidence, const bool is_interesting = false) {
+    m_boxes.push_back(box, m_size);
+    m_class_ids.push_back(class_id, m_size);
+    m_confidences.push_back(confidence, m_size);
+    m_is_interesting.push_back(is_interesting, m_size);
+    ++m_size;
+  }
+
+  // In the coordinates of YoloContext::source_frame_size
+  [[nodiscard]] std::span<const cv::Rect> boxes() const {
+    return m_boxes.view(m_size);
+  }
+  [[nodiscard]] std::span<const int> class_ids() const {
+    return m_class_ids.view(m_size);
+  }
+  [[nodiscard]] std::span<const float> confidences() const {
+    return m_confidences.view(m_size);
+  }
+  // Set by YoloPruneDetectionResults, false for all rows otherwise
+  [[nodiscard]] std::span<const uint8_t> is_interesting() const {
+    return m_is_interesting.view(m_size);
+  }
+  [[nodiscard]] std::span<uint8_t> is_interesting() {
+    return m_is_interesting.view(m_size);
+  }
+
+  /**
+   * @brief Keeps only the rows at indices (e.g., cv::dnn::NMSBoxes()'
+   * output), in the order they are listed. indices must be unique.
+   */
+  void retain(std::span<const int> indices) {
+    DetectionTable retained;
+    for (const auto idx : indices)
+      retained.push_back(boxes()[idx], class_ids()[idx], confidences()[idx],
+                         is_interesting()[idx]);
+    *this = std::move(retained);
+  }
+
+private:
+  // Inline storage until the table outgrows it, then a vector holding all
+  // rows. The table tracks the size, s.t. columns don't each store theirs
+  template <typename T> class Column {
+  public:
+    void push_back(const T &value, const size_t size) {
+      if (size < inline_capacity) {
+        m_inline[size] = value;
+        return;
+      }
+      if (size == inline_capacity)
+        m_spilled.assign(m_inline.begin(), m_inline.end());
+      m_spilled.push_back(value);
+    }
+    void clear() { m_spilled.clear(); }
+    void assign(const Column &other, const size_t size) {
+      if (size > inline_capacity) {
+        m_spilled = other.m_spilled;
+        return;
+      }
+      m_spilled.clear();
+      std::copy_n(other.m_inline.begin(), size, m_inline.begin());
+    }
+    void assign(Column &&other, const size_t size) noexcept {
+      if (size > inline_capacity) {
+        m_spilled = std::move(other.m_spilled);
+        return;
+      }
+      m_spilled.clear();
+      std::copy_n(other.m_inline.begin(), size, m_inline.begin());
+    }
+    [[nodiscard]] std::span<const T> view(const size_t size) const {
+      return {size > inline_capacity ? m_spilled.data() : m_inline.data(),
+              size};
+    }
+    [[nodiscard]] std::span<T> view(const size_t size) {
+      return {size > inline_capacity ? m_spilled.data() : m_inline.data(),
+              size};
+    }
+
+  private:
+    std::array<T, inline_capacity> m_inline;
+    std::vector<T> m_spilled;
+  };
+
+  size_t m_size = 0;
+  Column<cv::Rect> m_boxes;
+  Column<int> m_class_ids;
+  Column<float> m_confidences;
+  Column<uint8_t> m_is_interesting;
+};
+
+} // namespace MatrixPipeline::ProcessingUnit
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "processing_context.h"
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+using njson = nlohmann::json;
+
+namespace MatrixPipeline::ProcessingUnit {
+
+/**
+ * @brief How long after its capture a frame is still worth a unit's work,
+ * configured per unit (an asynchronousProcessingUnit's being the budget of its
+ * whole branch) by, e.g.:
+ * {"latencyBudgetMs": 500, "onLatencyBudgetExceeded": "skipUnit"}
+ */
+struct LatencyBudget {
+  enum class Action {
+    // The frame goes no further in the unit's branch
+    drop_frame,
+    // Only the unit is skipped, the rest of the branch still gets the frame,
+    // i.e., a cheaper degraded path (say, streamed without YOLO detections).
+    // Same as drop_frame for asynchronous units
+    skip_unit
+  };
+
+  // 0 means no budget
+  std::chrono::milliseconds budget{0};
+  Action on_exceeded = Action::drop_frame;
+
+  static Action action_from_string(const std::string &action) {
+    if (action == "dropFrame")
+      return Action::drop_frame;
+    if (action == "skipUnit")
+      return Action::skip_unit;
+    throw std::invalid_argument("Unrecognized onLatencyBudgetExceeded: " +
+                                action);
+  }
+
+  static std::string action_to_string(const Action action) {
+    switch (action) {
+    case Action::drop_frame:
+      return "dropFrame";
+    case Action::skip_unit:
+      return "skipUnit";
+    }
+    return "unknown";
+  }
+
+  /**
+   * @brief Parses config["latencyBudgetMs"] and
+   * config["onLatencyBudgetExceeded"], missing keys keep their defaults.
+   * Throws on invalid values.
+   */
+  static LatencyBudget from_json(const njson &config) {
+    LatencyBudget latency_budget;
+    latency_budget.budget = std::chrono::milliseconds(
+        config.value("latencyBudgetMs", latency_budget.budget.count()));
+    latency_budget.on_exceeded = action_from_string(
+        config.value("onLatencyBudgetExceeded",
+                     action_to_string(latency_budget.on_exceeded)));
+    if (latency_budget.budget.count() < 0)
+      throw std::invalid_argument("latencyBudgetMs must not be negative");
+    return latency_budget;
+  }
+
+  [[nodiscard]] bool is_exceeded(const PipelineContext &ctx) const {
+    // Lossless sources' timestamps don't follow the wall clock anyway
+    if (budget.count() <= 0 || ctx.device_info->lossless)
+      return false;
+    return std::chrono::steady_clock::now() - ctx.capture_timestamp > budget;
+  }
+};
+
+} // namespace MatrixPipeline::ProcessingUnit
@@ -1,13 +1,49 @@
 #pragma once
 
+#include "detection_table.h"
+
+#include <opencv2/core/cuda.hpp>
 #include <opencv2/opencv.hpp>
 
+#include <memory>
+#include <memory_resource>
+
 namespace MatrixPipeline::ProcessingUnit {
 
+/**
+ * @brief An immutable T shared by all the PipelineContexts holding it, i.e.,
+ * copying a context (into every branch's queue) copies a pointer, never the T.
+ * Units publish results by assigning a new T, which leaves the snapshot other
+ * branches may still be reading untouched.
+ */
+template <typename T> class SharedSnapshot {
+public:
+  SharedSnapshot() = default;
+  // Implicit, s.t. publishing reads as ctx.yolo = std::move(yolo)
+  SharedSnapshot(T value)
+      : m_ptr(std::make_shared<const T>(std::move(value))) {}
+
+  const T &operator*() const { return m_ptr != nullptr ? *m_ptr : empty(); }
+  const T *operator->() const { return &**this; }
+  // A mutable copy of the T, to be modified and assigned back
+  [[nodiscard]] T copy() const { return **this; }
+
+private:
+  // A default-constructed snapshot doesn't allocate
+  static const T &empty() {
+    static const T value{};
+    return value;
+  }
+  std::shared_ptr<const T> m_ptr;
+};
+
 struct DeviceInfo {
   std::string name;
   std::string uri;
   cv::Size expected_frame_size;
+  // Frames from lossless sources (e.g., replayed files) must not be dropped,
+  // asynchronous units block instead
+  bool lossless = false;
 };
 
 enum class IdentityCategory { Unknown, Authorized, Unauthorized };
@@ -43,16 +79,16 @@ struct YuNetSFaceContext {
 
 struct YoloContext {
   cv::Size inference_input_size;
-  std::vector<cv::Rect> bounding_boxes;
-  std::vector<size_t> class_ids;
-  std::vector<short> is_detection_interesting;
-  // Must be float as mandated by cv::dnn::NMSBoxes
-  std::vector<float> confidences;
-  std::vector<int> indices;
+  // Size of the frame inference ran on, which may be the secondary stream's
+  // frame rather than the frame being processed by later units
+  cv::Size source_frame_size;
+  // NMS survivors only, boxes are in source_frame_size's coordinates
+  DetectionTable detections;
 };
 
 struct PipelineContext {
-  DeviceInfo device_info;
+  // Created once per device and shared by all of its frames
+  SharedSnapshot<DeviceInfo> device_info;
   // false means it is a gray image
   bool captured_from_real_device = false;
   std::chrono::time_point<std::chrono::steady_clock, std::chrono::milliseconds>
@@ -64,10 +100,19 @@ struct PipelineContext {
   float change_rate = -1;
   float fps = 0.0;
   std::chrono::steady_clock::time_point latency_start_time;
+  // The frame arena (see Utils::FrameArena) of the branch, or stage, the frame
+  // is going through, for units' transient data. It is reset once the frame
+  // leaves the branch, i.e., nothing allocated from it may be stored in ctx
+  std::pmr::memory_resource *arena = std::pmr::new_delete_resource();
 
-  YoloContext yolo;
-  YuNetSFaceContext yunet_sface;
+  SharedSnapshot<YoloContext> yolo;
+  SharedSnapshot<YuNetSFaceContext> yunet_sface;
   std::string text_to_overlay;
+  // The secondary (usually low-resolution sub-) stream's frame captured
+  // closest in time to this one; empty if the device has no secondary stream
+  // or no frame is within the skew tolerance. It is shared by all branches and
+  // must be treated as read-only
+  cv::cuda::GpuMat secondary_frame;
   // SFaceContext sface;
 };
 } // namespace MatrixPipeline::ProcessingUnit
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+using njson = nlohmann::json;
+
+namespace MatrixPipeline::ProcessingUnit {
+
+/**
+ * @brief How an asynchronous unit's input queue behaves once it's full,
+ * configured per unit by its "queuePolicy" object, e.g.:
+ * {"type": "dropOldest", "maxFrames": 30, "maxBytes": 0, "maxFrameAgeMs": 0}
+ */
+struct QueuePolicy {
+  enum class Type {
+    // Only the latest frame is kept, e.g., for MJPEG streaming
+    mailbox,
+    // Bounded FIFO, the oldest queued frame makes room for the new one
+    drop_oldest,
+    // Bounded FIFO, the new frame is discarded
+    drop_newest,
+    // Bounded FIFO, the producer waits (backpressure), e.g., for recording
+    block
+  };
+
+  Type type = Type::drop_oldest;
+  size_t max_frames = 30;
+  // 0 means no limit. A single frame larger than max_bytes is still accepted
+  // into an empty queue
+  size_t max_bytes = 0;
+  // Frames captured longer ago than this are dropped instead of processed, 0
+  // means no limit
+  std::chrono::milliseconds max_frame_age{0};
+
+  static Type type_from_string(const std::string &type) {
+    if (type == "mailbox")
+      return Type::mailbox;
+    if (type == "dropOldest")
+      return Type::drop_oldest;
+    if (type == "dropNewest")
+      return Type::drop_newest;
+    if (type == "block")
+      return Type::block;
+    throw std::invalid_argument("Unrecognized queuePolicy type: " + type);
+  }
+
+  static std::string type_to_string(const Type type) {
+    switch (type) {
+    case Type::mailbox:
+      return "mailbox";
+    case Type::drop_oldest:
+      return "dropOldest";
+    case Type::drop_newest:
+      return "dropNewest";
+    case Type::block:
+      return "block";
+    }
+    return "unknown";
+  }
+
+  /**
+   * @brief Parses config["queuePolicy"], missing keys keep their defaults.
+   * Throws on invalid values.
+   */
+  static QueuePolicy from_json(const njson &config) {
+    QueuePolicy policy;
+    if (!config.contains("queuePolicy"))
+      return policy;
+    const auto &json = config.at("queuePolicy");
+    policy.type = type_from_string(
+        json.value("type", type_to_string(policy.type)));
+    policy.max_frames = policy.type == Type::mailbox
+                            ? 1
+                            : json.value("maxFrames", policy.max_frames);
+    policy.max_bytes = json.value("maxBytes", policy.max_bytes);
+    policy.max_frame_age = std::chrono::milliseconds(
+        json.value("maxFrameAgeMs", policy.max_frame_age.count()));
+    if (policy.max_frames == 0)
+      throw std::invalid_argument("queuePolicy.maxFrames must be positive");
+    return policy;
+  }
+};
+
+} // namespace MatrixPipeline::ProcessingUnit
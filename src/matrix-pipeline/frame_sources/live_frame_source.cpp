@@ -0,0 +1,136 @@
+#include "live_frame_source.h"
+
+#include <opencv2/cudacodec.hpp>
+#include <spdlog/spdlog.h>
+
+#include <thread>
+
+namespace MatrixPipeline::FrameSource {
+
+LiveFrameSource::~LiveFrameSource() { LiveFrameSource::stop(); }
+
+Utils::VideoReaderReconnector::Config
+LiveFrameSource::parse_reconnect_config(const njson &config) {
+  Utils::VideoReaderReconnector::Config reconnect_config;
+  const auto reconnect = config.value("reconnect", njson::object());
+  reconnect_config.initial_backoff = std::chrono::milliseconds(reconnect.value(
+      "initialBackoffMs", reconnect_config.initial_backoff.count()));
+  reconnect_config.max_backoff = std::chrono::milliseconds(
+      reconnect.value("maxBackoffMs", reconnect_config.max_backoff.count()));
+  reconnect_config.probe_timeout = std::chrono::milliseconds(reconnect.value(
+      "probeTimeoutMs", reconnect_config.probe_timeout.count()));
+  return reconnect_config;
+}
+
+bool LiveFrameSource::init(const njson &config) {
+  try {
+    m_reconnector = std::make_unique<Utils::VideoReaderReconnector>(
+        config.at("uri").get<std::string>(),
+        config.value("name", "Unnamed Device"),
+        parse_reconnect_config(config));
+    m_decode_error_count = Utils::MetricsRegistry::instance().counter(
+        "matrix_pipeline_device_decode_errors_total",
+        "Failed or malformed frames from the device's video reader",
+        {{"device", config.value("name", "Unnamed Device")}});
+    m_reconnector->start();
+    return true;
+  } catch (const std::exception &e) {
+    SPDLOG_ERROR("Failed to init LiveFrameSource: {}", e.what());
+    return false;
+  }
+}
+
+void LiveFrameSource::stop() {
+  if (m_reconnector)
+    m_reconnector->stop();
+}
+
+std::string LiveFrameSource::get_stats_summary() const {
+  if (!m_reconnector)
+    return "";
+  // Attempts and latencies are exported by /metrics
+  return fmt::format("reconnect(state/successes): {}/{}",
+                     Utils::VideoReaderReconnector::state_to_string(
+                         m_reconnector->get_state()),
+                     m_reconnector->get_success_count());
+}
+
+bool LiveFrameSource::next_frame(cv::cuda::GpuMat &frame,
+                                 ProcessingUnit::PipelineContext &ctx) {
+  using namespace std::chrono_literals;
+  using namespace std::chrono;
+  auto captured_from_real_device = false;
+
+  constexpr auto warn_interval = 10s;
+  // Lock-free: the reconnector swaps in a new reader atomically, holding our
+  // own reference keeps the current one alive until this frame is decoded
+  const auto vr = m_reconnector->get_reader();
+  try {
+    if (vr == nullptr) {
+      if (steady_clock::now() - m_last_warn_time > warn_interval &&
+          // give the video feed a few sec to open without complaining
+          ctx.frame_seq_num > 90) {
+        SPDLOG_WARN("vr == nullptr, reconnector state: {}, frame_seq_num: {} "
+                    "(this message is throttled to once per {} sec)",
+                    Utils::VideoReaderReconnector::state_to_string(
+                        m_reconnector->get_state()),
+                    ctx.frame_seq_num, warn_interval.count());
+        m_last_warn_time = steady_clock::now();
+      }
+    } else if (!vr->nextFrame(frame)) {
+      if (steady_clock::now() - m_last_warn_time > warn_interval) {
+        SPDLOG_ERROR("VideoReader->nextFrame(frame) returns false, "
+                     "frame_seq_num: {} (this "
+                     "message is throttled to once per {} sec)",
+                     ctx.frame_seq_num, warn_interval.count());
+        m_last_warn_time = steady_clock::now();
+      }
+    } else if (frame.empty() ||
+               frame.size() != ctx.device_info->expected_frame_size) {
+
+      if (steady_clock::now() - m_last_warn_time > warn_interval) {
+        SPDLOG_ERROR("VideoReader->nextFrame((frame) returns frame with "
+                     "unexpected size. expect ({}x{}) vs actual ({}x{}) (this "
+                     "message is throttled to once per {} sec)",
+                     ctx.device_info->expected_frame_size.width,
+                     ctx.device_info->expected_frame_size.height,
+                     frame.empty() ? -1 : frame.size().width,
+                     frame.empty() ? -1 : frame.size().height,
+                     warn_interval.count());
+        m_last_warn_time = steady_clock::now();
+      }
+    } else {
+      captured_from_real_device = true;
+    }
+  } catch (const cv::Exception &e) {
+    if (steady_clock::now() - m_last_warn_time > warn_interval) {
+      SPDLOG_ERROR("VideoReader->nextFrame() failed: {} (this "
+                   "message is throttled to once per {} sec)",
+                   e.what(), warn_interval.count());
+      m_last_warn_time = steady_clock::now();
+    }
+  }
+
+  if (vr != nullptr && !captured_from_real_device) {
+    m_decode_error_count->inc();
+    m_reconnector->report_failure();
+  }
+
+  if (!ctx.captured_from_real_device) {
+    // emulate an 30-fps video device lol
+    std::this_thread::sleep_for(1000ms / 34);
+    frame.create(ctx.device_info->expected_frame_size.height,
+                 ctx.device_info->expected_frame_size.width, CV_8UC3);
+    frame.setTo(cv::Scalar(128, 128, 128));
+  }
+  ctx.capture_timestamp =
+      std::chrono::time_point_cast<milliseconds>(steady_clock::now());
+  if (captured_from_real_device != ctx.captured_from_real_device) {
+    ctx.capture_from_this_device_since = ctx.capture_timestamp;
+  }
+  ctx.captured_from_real_device = captured_from_real_device;
+  ++ctx.frame_seq_num;
+  return true;
+}
+
+} // namespace MatrixPipeline::FrameSource
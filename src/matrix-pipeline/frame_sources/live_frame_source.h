@@ -0,0 +1,37 @@
+#pragma once
+
+#include "../interfaces/i_frame_source.h"
+#include "../utils/metrics.h"
+#include "../utils/video_reader_reconnector.h"
+
+#include <chrono>
+#include <memory>
+
+namespace MatrixPipeline::FrameSource {
+
+/**
+ * @brief Frames from a live camera/stream. It never gives up: while the device
+ * is down it keeps emitting grey placeholder frames at ~30 fps and lets
+ * VideoReaderReconnector bring the device back in the background.
+ */
+class LiveFrameSource final : public IFrameSource {
+public:
+  LiveFrameSource() = default;
+  ~LiveFrameSource() override;
+
+  bool init(const njson &config) override;
+  bool next_frame(cv::cuda::GpuMat &frame,
+                  ProcessingUnit::PipelineContext &ctx) override;
+  void stop() override;
+  [[nodiscard]] std::string get_stats_summary() const override;
+
+  static Utils::VideoReaderReconnector::Config
+  parse_reconnect_config(const njson &config);
+
+private:
+  std::unique_ptr<Utils::VideoReaderReconnector> m_reconnector;
+  std::shared_ptr<Utils::Counter> m_decode_error_count;
+  std::chrono::time_point<std::chrono::steady_clock> m_last_warn_time;
+};
+
+} // namespace MatrixPipeline::FrameSource
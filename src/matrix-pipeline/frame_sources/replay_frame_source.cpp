@@ -0,0 +1,112 @@
+#include "replay_frame_source.h"
+
+#include <opencv2/videoio.hpp>
+#include <spdlog/spdlog.h>
+
+#include <cmath>
+#include <thread>
+
+namespace MatrixPipeline::FrameSource {
+
+bool ReplayFrameSource::init(const njson &config) {
+  try {
+    const auto source = config.value("source", njson::object());
+    m_path = source.value("path", config.value("uri", ""));
+    m_pacing = source.value("pacing", m_pacing);
+    if (m_pacing < 0) {
+      SPDLOG_ERROR("Invalid pacing: {}", m_pacing);
+      return false;
+    }
+    // No allowFrameDrop here: a replay must be reproducible
+    m_reader = cv::cudacodec::createVideoReader(m_path);
+    if (!m_reader) {
+      SPDLOG_ERROR("cudacodec::createVideoReader({}) failed", m_path);
+      return false;
+    }
+    m_reader->set(cv::cudacodec::ColorFormat::BGR);
+    if (const auto fps = m_reader->format().fps; fps > 0)
+      m_fps = fps;
+    SPDLOG_INFO("ReplayFrameSource initialized, path: {}, pacing: {}, fps: {}",
+                m_path, m_pacing, m_fps);
+    return true;
+  } catch (const std::exception &e) {
+    SPDLOG_ERROR("Failed to init ReplayFrameSource: {}", e.what());
+    return false;
+  }
+}
+
+double ReplayFrameSource::get_relative_pts_ms() {
+  // Note that the reported position is the demuxer's, which may run a few
+  // packets ahead of the decoder, hence the fallback to the frame index if it
+  // is unavailable or goes backwards (e.g., B-frame reordering)
+  double pts_ms = -1;
+  if (!m_reader->get(cv::CAP_PROP_POS_MSEC, pts_ms))
+    pts_ms = -1;
+  if (pts_ms >= 0 && m_first_pts_ms < 0)
+    m_first_pts_ms = pts_ms;
+  auto relative_pts_ms = pts_ms - m_first_pts_ms;
+  if (pts_ms < 0 || relative_pts_ms <= m_last_relative_pts_ms) {
+    relative_pts_ms = std::max(m_last_relative_pts_ms + 1000.0 / m_fps,
+                               m_frame_count * 1000.0 / m_fps);
+    ++m_pts_fallback_count;
+  }
+  m_last_relative_pts_ms = relative_pts_ms;
+  return relative_pts_ms;
+}
+
+bool ReplayFrameSource::next_frame(cv::cuda::GpuMat &frame,
+                                   ProcessingUnit::PipelineContext &ctx) {
+  using namespace std::chrono;
+  if (m_frame_count == 0) {
+    m_replay_start_time = steady_clock::now();
+    m_timestamp_epoch = time_point_cast<milliseconds>(m_replay_start_time);
+    ctx.capture_from_this_device_since = m_timestamp_epoch;
+  }
+
+  bool captured = false;
+  try {
+    captured = m_reader->nextFrame(frame);
+  } catch (const cv::Exception &e) {
+    SPDLOG_ERROR("VideoReader->nextFrame() failed: {}", e.what());
+  }
+  if (!captured || frame.empty()) {
+    const auto elapsed =
+        duration<double>(steady_clock::now() - m_replay_start_time).count();
+    SPDLOG_INFO("End of replay reached, path: {}, {}, wall_time(sec): {:.1f}, "
+                "speedup over real time: {:.1f}x",
+                m_path, get_stats_summary(), elapsed,
+                elapsed > 0 ? m_last_relative_pts_ms / 1000.0 / elapsed : 0.0);
+    return false;
+  }
+  if (m_frame_count == 0 &&
+      frame.size() != ctx.device_info->expected_frame_size) {
+    SPDLOG_WARN("Replayed frame size ({}x{}) differs from expected frame size "
+                "({}x{})",
+                frame.cols, frame.rows,
+                ctx.device_info->expected_frame_size.width,
+                ctx.device_info->expected_frame_size.height);
+  }
+
+  const auto relative_pts_ms = get_relative_pts_ms();
+  ++m_frame_count;
+  if (m_pacing > 0)
+    std::this_thread::sleep_until(
+        m_replay_start_time +
+        duration_cast<steady_clock::duration>(
+            duration<double, std::milli>(relative_pts_ms / m_pacing)));
+
+  ctx.capture_timestamp =
+      m_timestamp_epoch + milliseconds(std::llround(relative_pts_ms));
+  ctx.captured_from_real_device = true;
+  ++ctx.frame_seq_num;
+  return true;
+}
+
+std::string ReplayFrameSource::get_stats_summary() const {
+  return fmt::format("replay(frames/media_sec/pts_fallbacks): {}/{:.1f}/{}",
+                     m_frame_count,
+                     std::max(m_last_relative_pts_ms, 0.0) / 1000,
+                     m_pts_fallback_count);
+}
+
+} // namespace MatrixPipeline::FrameSource
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "../interfaces/i_frame_source.h"
+
+#include <opencv2/cudacodec.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace MatrixPipeline::FrameSource {
+
+/**
+ * @brief Replays a local video file. Timestamps are derived from the
+ * container's PTS rather than the wall clock, and frames are emitted as fast
+ * as the pipeline accepts them (the source is lossless, so the slowest
+ * branch sets the pace) unless a pacing multiplier is given.
+ */
+class ReplayFrameSource final : public IFrameSource {
+public:
+  ReplayFrameSource() = default;
+  ~ReplayFrameSource() override = default;
+
+  bool init(const njson &config) override;
+  bool next_frame(cv::cuda::GpuMat &frame,
+                  ProcessingUnit::PipelineContext &ctx) override;
+  [[nodiscard]] bool is_lossless() const override { return true; }
+  [[nodiscard]] std::string get_stats_summary() const override;
+
+private:
+  std::string m_path;
+  // 0 means as fast as possible, 1.0 means real time, 2.0 means twice as
+  // fast as real time, etc.
+  double m_pacing = 0.0;
+  cv::Ptr<cv::cudacodec::VideoReader> m_reader;
+  double m_fps = 30.0;
+
+  uint64_t m_frame_count = 0;
+  uint64_t m_pts_fallback_count = 0;
+  double m_first_pts_ms = -1;
+  double m_last_relative_pts_ms = -1;
+  std::chrono::steady_clock::time_point m_replay_start_time;
+  std::chrono::time_point<std::chrono::steady_clock, std::chrono::milliseconds>
+      m_timestamp_epoch;
+
+  [[nodiscard]] double get_relative_pts_ms();
+};
+
+} // namespace MatrixPipeline::FrameSource
@@ -0,0 +1,175 @@
+#include "synthetic_frame_source.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace MatrixPipeline::FrameSource {
+
+uint32_t SyntheticFrameSource::uniform(std::mt19937 &rng, const uint32_t lo,
+                                       const uint32_t hi) {
+  // Deliberately not std::uniform_int_distribution: its algorithm is
+  // implementation-defined, so the same seed could yield different frames on
+  // different standard libraries. The modulo bias is irrelevant here.
+  return lo + static_cast<uint32_t>(rng() % (hi - lo + 1));
+}
+
+SyntheticFrameSource::Shape
+SyntheticFrameSource::make_shape(std::mt19937 &rng, int min_size, int max_size,
+                                 const int max_speed) const {
+  max_size = std::max(1, std::min({max_size, m_frame_size.width - 1,
+                                   m_frame_size.height - 1}));
+  min_size = std::clamp(min_size, 1, max_size);
+  Shape shape{};
+  shape.width = static_cast<int>(uniform(rng, min_size, max_size));
+  shape.height = static_cast<int>(uniform(rng, min_size, max_size));
+  shape.x0 = uniform(rng, 0, m_frame_size.width - shape.width);
+  shape.y0 = uniform(rng, 0, m_frame_size.height - shape.height);
+  shape.vx = static_cast<int64_t>(uniform(rng, 0, 2 * max_speed)) - max_speed;
+  shape.vy = static_cast<int64_t>(uniform(rng, 0, 2 * max_speed)) - max_speed;
+  const auto b = uniform(rng, 0, 255);
+  const auto g = uniform(rng, 0, 255);
+  const auto r = uniform(rng, 0, 255);
+  shape.color = cv::Scalar(b, g, r);
+  return shape;
+}
+
+bool SyntheticFrameSource::init(const njson &config) {
+  try {
+    const auto source = config.value("source", njson::object());
+    m_frame_size = {
+        source.value("width", config["expectedFrameSize"]["width"].get<int>()),
+        source.value("height",
+                     config["expectedFrameSize"]["height"].get<int>())};
+    m_fps = source.value("fps", m_fps);
+    m_pacing = source.value("pacing", m_pacing);
+    m_lossless = source.value("lossless", m_lossless);
+    m_frame_count_limit = source.value("frameCount", m_frame_count_limit);
+    const auto seed = source.value("seed", 0U);
+    const auto noise_amplitude =
+        std::clamp(source.value("noiseAmplitude", 8), 0, 127);
+    const auto noise_frame_count = std::max(source.value("noiseFrames", 4), 1);
+    const auto shape_count = std::max(source.value("shapes", 2), 0);
+    if (m_frame_size.width <= 1 || m_frame_size.height <= 1 || m_fps <= 0 ||
+        m_pacing < 0) {
+      SPDLOG_ERROR("Invalid frame size ({}x{}), fps ({}) or pacing ({})",
+                   m_frame_size.width, m_frame_size.height, m_fps, m_pacing);
+      return false;
+    }
+
+    // The order in which random numbers are drawn below is part of the
+    // output's definition, changing it changes every frame for a given seed
+    std::mt19937 rng(seed);
+
+    // Noise is pre-generated and cycled through, generating it per frame on
+    // the CPU would make us the bottleneck of the benchmarks we serve
+    cv::Mat background(m_frame_size, CV_8UC3);
+    for (int i = 0; i < noise_frame_count; ++i) {
+      for (int row = 0; row < background.rows; ++row) {
+        auto *p = background.ptr<uint8_t>(row);
+        for (int col = 0; col < background.cols * background.channels();
+             ++col) {
+          p[col] = static_cast<uint8_t>(
+              128 + static_cast<int>(uniform(rng, 0, 2 * noise_amplitude)) -
+              noise_amplitude);
+        }
+      }
+      m_backgrounds.emplace_back(background);
+    }
+
+    const auto short_side = std::min(m_frame_size.width, m_frame_size.height);
+    for (int i = 0; i < shape_count; ++i)
+      m_shapes.push_back(make_shape(rng, short_side / 20, short_side / 8, 4));
+
+    for (const auto &event : source.value("motionEvents", njson::array())) {
+      MotionEvent motion_event;
+      motion_event.start_frame = event.at("startFrame").get<uint64_t>();
+      motion_event.end_frame = event.at("endFrame").get<uint64_t>();
+      const auto event_shape_count = event.value("shapes", 3);
+      for (int i = 0; i < event_shape_count; ++i)
+        motion_event.shapes.push_back(
+            make_shape(rng, short_side / 8, short_side / 3, 16));
+      m_motion_events.push_back(std::move(motion_event));
+    }
+
+    SPDLOG_INFO("SyntheticFrameSource initialized, frame_size: {}x{}, fps: "
+                "{}, pacing: {}, lossless: {}, frame_count_limit: {}, seed: "
+                "{}, noise_amplitude: {}, shapes: {}, motion_events: {}",
+                m_frame_size.width, m_frame_size.height, m_fps, m_pacing,
+                m_lossless, m_frame_count_limit, seed, noise_amplitude,
+                m_shapes.size(), m_motion_events.size());
+    return true;
+  } catch (const std::exception &e) {
+    SPDLOG_ERROR("Failed to init SyntheticFrameSource: {}", e.what());
+    return false;
+  }
+}
+
+void SyntheticFrameSource::draw_shape(cv::cuda::GpuMat &frame,
+                                      const Shape &shape,
+                                      const uint64_t frame_idx) const {
+  // Bounces off the frame's edges, i.e., a triangle wave over [0, range]
+  auto bounce = [frame_idx](const int64_t p0, const int64_t v,
+                            const int64_t range) -> int64_t {
+    if (range <= 0)
+      return 0;
+    const auto period = 2 * range;
+    auto p = (p0 + v * static_cast<int64_t>(frame_idx)) % period;
+    if (p < 0)
+      p += period;
+    return p <= range ? p : period - p;
+  };
+  const auto x = bounce(shape.x0, shape.vx, frame.cols - shape.width);
+  const auto y = bounce(shape.y0, shape.vy, frame.rows - shape.height);
+  frame(cv::Rect(static_cast<int>(x), static_cast<int>(y), shape.width,
+                 shape.height))
+      .setTo(shape.color);
+}
+
+bool SyntheticFrameSource::next_frame(cv::cuda::GpuMat &frame,
+                                      ProcessingUnit::PipelineContext &ctx) {
+  using namespace std::chrono;
+  if (m_frame_count_limit > 0 && m_frame_count >= m_frame_count_limit) {
+    SPDLOG_INFO("SyntheticFrameSource exhausted, {}", get_stats_summary());
+    return false;
+  }
+  if (m_frame_count == 0) {
+    m_start_time = steady_clock::now();
+    m_timestamp_epoch = time_point_cast<milliseconds>(m_start_time);
+    ctx.capture_from_this_device_since = m_timestamp_epoch;
+  }
+
+  // Timestamps follow the synthetic clock, not the wall clock, s.t. they are
+  // reproducible as well
+  const auto relative_ms = static_cast<double>(m_frame_count) * 1000.0 / m_fps;
+  if (m_pacing > 0)
+    std::this_thread::sleep_until(
+        m_start_time +
+        duration_cast<steady_clock::duration>(
+            duration<double, std::milli>(relative_ms / m_pacing)));
+
+  m_backgrounds[m_frame_count % m_backgrounds.size()].copyTo(frame);
+  for (const auto &shape : m_shapes)
+    draw_shape(frame, shape, m_frame_count);
+  for (const auto &event : m_motion_events) {
+    if (m_frame_count < event.start_frame || m_frame_count >= event.end_frame)
+      continue;
+    for (const auto &shape : event.shapes)
+      draw_shape(frame, shape, m_frame_count - event.start_frame);
+  }
+
+  ctx.capture_timestamp =
+      m_timestamp_epoch + milliseconds(std::llround(relative_ms));
+  ctx.captured_from_real_device = true;
+  ++ctx.frame_seq_num;
+  ++m_frame_count;
+  return true;
+}
+
+std::string SyntheticFrameSource::get_stats_summary() const {
+  return fmt::format("synthetic(frames): {}", m_frame_count);
+}
+
+} // namespace MatrixPipeline::FrameSource
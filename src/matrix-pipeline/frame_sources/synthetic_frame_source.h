@@ -0,0 +1,76 @@
+#pragma once
+
+#include "../interfaces/i_frame_source.h"
+
+#include <opencv2/core/cuda.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace MatrixPipeline::FrameSource {
+
+/**
+ * @brief A deterministic, built-in video source for benchmarking and CI: a
+ * noisy grey background with moving rectangles, plus scripted "motion events"
+ * during which extra (larger, faster) rectangles show up.
+ *
+ * Output is bit-reproducible from the seed: only std::mt19937's raw output
+ * (whose sequence is mandated by the standard) is used, never the
+ * implementation-defined std::*_distribution, and every frame is a pure
+ * function of its frame index, regardless of timing or dropped frames.
+ */
+class SyntheticFrameSource final : public IFrameSource {
+public:
+  SyntheticFrameSource() = default;
+  ~SyntheticFrameSource() override = default;
+
+  bool init(const njson &config) override;
+  bool next_frame(cv::cuda::GpuMat &frame,
+                  ProcessingUnit::PipelineContext &ctx) override;
+  [[nodiscard]] bool is_lossless() const override { return m_lossless; }
+  [[nodiscard]] std::string get_stats_summary() const override;
+
+private:
+  struct Shape {
+    int width;
+    int height;
+    // position at frame 0 and velocity in pixels per frame
+    int64_t x0;
+    int64_t y0;
+    int64_t vx;
+    int64_t vy;
+    cv::Scalar color;
+  };
+  struct MotionEvent {
+    uint64_t start_frame;
+    uint64_t end_frame; // exclusive
+    std::vector<Shape> shapes;
+  };
+
+  cv::Size m_frame_size;
+  double m_fps = 30.0;
+  // 0 means as fast as possible, 1.0 means real time, 2.0 means twice as
+  // fast as real time, etc.
+  double m_pacing = 1.0;
+  bool m_lossless = true;
+  // 0 means infinite
+  uint64_t m_frame_count_limit = 0;
+  std::vector<cv::cuda::GpuMat> m_backgrounds;
+  std::vector<Shape> m_shapes;
+  std::vector<MotionEvent> m_motion_events;
+
+  uint64_t m_frame_count = 0;
+  std::chrono::steady_clock::time_point m_start_time;
+  std::chrono::time_point<std::chrono::steady_clock, std::chrono::milliseconds>
+      m_timestamp_epoch;
+
+  static uint32_t uniform(std::mt19937 &rng, uint32_t lo, uint32_t hi);
+  Shape make_shape(std::mt19937 &rng, int min_size, int max_size,
+                   int max_speed) const;
+  void draw_shape(cv::cuda::GpuMat &frame, const Shape &shape,
+                  uint64_t frame_idx) const;
+};
+
+} // namespace MatrixPipeline::FrameSource
@@ -1,9 +1,14 @@
 #pragma once
 
 #include "../entities/processing_context.h"
+#include "../entities/queue_policy.h"
 #include "../entities/synchronous_processing_result.h"
 #include "../global_vars.h"
+#include "../utils/frame_arena.h"
 #include "../utils/matrix_sender.h"
+#include "../utils/mpsc_ring.h"
+#include "../utils/tracer.h"
+#include "../utils/work_stealing_executor.h"
 #include "i_processing_unit.h"
 
 #include <boost/stacktrace.hpp>
@@ -12,10 +17,10 @@
 #include <opencv2/core/cuda.hpp>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
 #include <atomic>
-#include <condition_variable>
-#include <mutex>
-#include <queue>
+#include <ctime>
+#include <memory>
 #include <thread>
 
 namespace MatrixPipeline::Utils {
@@ -30,6 +35,22 @@ namespace MatrixPipeline::ProcessingUnit {
 struct AsyncPayload {
   cv::cuda::GpuMat frame;
   PipelineContext ctx;
+
+  AsyncPayload() = default;
+  AsyncPayload(const cv::cuda::GpuMat &frame_, const PipelineContext &ctx_)
+      : frame(frame_), ctx(ctx_) {}
+  // GpuMat has no move semantics, its copies bump the refcount s.t. the
+  // receiving end of a hand-off would see the frame as shared and clone it
+  // before writing. Swapping transfers the reference instead
+  AsyncPayload(AsyncPayload &&other) noexcept : ctx(std::move(other.ctx)) {
+    frame.swap(other.frame);
+  }
+  AsyncPayload &operator=(AsyncPayload &&other) noexcept {
+    frame.swap(other.frame);
+    other.frame.release();
+    ctx = std::move(other.ctx);
+    return *this;
+  }
 };
 
 class IAsynchronousProcessingUnit : public IProcessingUnit {
@@ -46,14 +67,21 @@ public:
   }
 
   explicit IAsynchronousProcessingUnit(const std::string &unit_path)
-      : IProcessingUnit(unit_path) {};
+      : IProcessingUnit(unit_path),
+        m_trace_name(Utils::Tracer::intern(m_unit_path)),
+        m_queue(std::make_unique<Utils::MpscRing<AsyncPayload>>(
+            m_queue_policy.max_frames)) {};
   /**
    * @brief Pushes a frame into the processing queue.
-   * * IMPORTANT: This performs a DEEP COPY (clone) of the GPU frame.
-   * This ensures the worker thread owns independent data, allowing the caller
-   * to reuse or destroy the original frame immediately after this call returns.
-   * * Note: This involves GPU memory allocation, so it has a higher cost than a
-   * shallow copy.
+   * * IMPORTANT: This performs a SHALLOW COPY of the GPU frame, i.e., the
+   * device buffer is shared (and refcounted) with the caller and all other
+   * branches. Nobody may write into a frame after it's enqueued: writers
+   * either render into a new buffer or call Utils::make_writable() first,
+   * which copies the buffer only if it's still shared (copy-on-write).
+   * * What happens when the queue is full is up to the unit's QueuePolicy.
+   * Frames of lossless sources are never dropped though: if the queue is
+   * full, this blocks until the worker thread catches up (i.e., backpressure)
+   * regardless of the policy.
    */
   SynchronousProcessingResult enqueue(const cv::cuda::GpuMat &frame,
                                       const PipelineContext &ctx) {
@@ -61,62 +89,139 @@ public:
       return success_and_continue;
     if (ev_flag != 0)
       return failure_and_stop;
+    TRACE_SCOPE(m_trace_name, "enqueue", ctx.frame_seq_num);
 
     using namespace std::chrono_literals;
-    cv::cuda::GpuMat frame_clone;
-    try {
-      frame_clone = frame.clone();
-    } catch (const cv::Exception &e) {
-      SPDLOG_WARN(
-          "e.what(): {}\n{}", e.what(),
-          boost::stacktrace::to_string(boost::stacktrace::stacktrace()));
-      return failure_and_continue;
+    const auto bytes = get_frame_bytes(frame);
+    const bool blocking = ctx.device_info->lossless ||
+                          m_queue_policy.type == QueuePolicy::Type::block;
+    const bool drop_newest =
+        !blocking && m_queue_policy.type == QueuePolicy::Type::drop_newest;
+    if (drop_newest && is_queue_full(bytes)) {
+      m_metrics.dropped_newest->inc();
+      warn_dropped_frames_throttled();
+      return success_and_continue;
     }
-    {
-      std::lock_guard lock(m_queue_mutex);
-
-      auto queue_size = m_processing_queue.size();
-      if (constexpr auto warning_queue_size = 10;
-          queue_size > warning_queue_size) {
-        constexpr auto warning_throttle_interval = 5s;
-        if (std::chrono::steady_clock::now() - m_last_warning_time >
-            warning_throttle_interval) {
-          SPDLOG_WARN("{}: queue_size ({}) is above warning_queue_size ({}). "
-                      "(This message is throttled to once per {} sec)",
-                      m_unit_path, queue_size, warning_queue_size,
-                      warning_throttle_interval.count());
-          m_last_warning_time = std::chrono::steady_clock::now();
-        }
-        if (constexpr auto critical_queue_size = 30;
-            queue_size > critical_queue_size) {
-          SPDLOG_ERROR("{}: queue_size ({}) is above critical_queue_size ({}), "
-                       "discard {} frames to avoid OOM",
-                       m_unit_path, queue_size, critical_queue_size,
-                       queue_size - warning_queue_size);
-          while (queue_size > warning_queue_size) {
-            // auto [frame, ctx] = m_processing_queue.front();
-            m_processing_queue.pop();
-            queue_size = m_processing_queue.size();
-          }
+
+    AsyncPayload payload{frame, ctx};
+    // The caller's arena is theirs, this unit sets its own when processing
+    payload.ctx.arena = std::pmr::new_delete_resource();
+    bool dropped_oldest = false;
+    while (true) {
+      if (blocking) {
+        // ev_flag is set by a signal handler, which can't notify us, hence
+        // the periodic wake-ups
+        while (is_queue_full(bytes) && m_running.load() && ev_flag == 0) {
+          // On the shared executor, waiting idly could leave no worker to
+          // drain us, so drain ourselves. Only our own frames: any other
+          // pending task could block on a unit whose drain is suspended
+          // further down this thread's stack, whereas frames only ever flow
+          // downstream from us
+          if (m_executor != nullptr && try_drain_inline())
+            continue;
+          m_queue->wait_while_full([&] { return is_queue_full(bytes); },
+                                   100ms);
         }
+      } else if (!drop_newest) {
+        // mailbox is a drop_oldest queue of max_frames == 1
+        while (is_queue_full(bytes) && pop_oldest())
+          dropped_oldest = true;
+      }
+      m_queued_bytes.fetch_add(bytes, std::memory_order_relaxed);
+      if (m_queue->try_push(std::move(payload))) {
+        m_metrics.enqueued->inc();
+        m_metrics.queue_depth->set(m_queue->size_approx());
+        if (m_executor != nullptr && m_running.load())
+          schedule_drain();
+        break;
+      }
+      m_queued_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+      // The ring itself is full: concurrent producers won the race for the
+      // last slots
+      if (drop_newest || (blocking && (!m_running.load() || ev_flag != 0))) {
+        m_metrics.dropped_newest->inc();
+        warn_dropped_frames_throttled();
+        return success_and_continue;
       }
+    }
+    // For a mailbox, replacing the queued frame is business as usual
+    if (dropped_oldest && m_queue_policy.type != QueuePolicy::Type::mailbox)
+      warn_dropped_frames_throttled();
+    return success_and_continue;
+  }
 
-      m_processing_queue.push(AsyncPayload{frame_clone, ctx});
+  /**
+   * @brief Parses config["queuePolicy"] and config["dedicatedThread"] (i.e.,
+   * opt out of the shared executor, say, for units blocking on I/O), to be
+   * called before start(). The unit's LatencyBudget is parsed along with
+   * them, frames exceeding it are dropped once dequeued.
+   * @return false if the policy or the budget is invalid
+   */
+  bool configure_queue(const njson &config) {
+    if (m_running.load()) {
+      SPDLOG_ERROR("{}: queue can't be reconfigured while running",
+                   m_unit_path);
+      return false;
+    }
+    try {
+      m_queue_policy = QueuePolicy::from_json(config);
+      m_queue = std::make_unique<Utils::MpscRing<AsyncPayload>>(
+          m_queue_policy.max_frames);
+      m_dedicated_thread = config.value("dedicatedThread", m_dedicated_thread);
+    } catch (const std::exception &e) {
+      SPDLOG_ERROR("{}: invalid queuePolicy: {}", m_unit_path, e.what());
+      return false;
     }
+    if (!configure_latency_budget(config))
+      return false;
+    SPDLOG_INFO("{}: queue_policy: {}, max_frames: {}, max_bytes: {}, "
+                "max_frame_age(ms): {}",
+                m_unit_path, QueuePolicy::type_to_string(m_queue_policy.type),
+                m_queue_policy.max_frames, m_queue_policy.max_bytes,
+                m_queue_policy.max_frame_age.count());
+    return true;
+  }
 
-    // 3. Wake up the worker thread
-    m_cv.notify_one();
-    return success_and_continue;
+  struct DropCounts {
+    uint64_t oldest = 0;
+    uint64_t newest = 0;
+    uint64_t stale = 0;
+  };
+  [[nodiscard]] DropCounts get_drop_counts() const {
+    return {m_metrics.dropped_oldest->value(),
+            m_metrics.dropped_newest->value(),
+            m_metrics.dropped_stale->value()};
+  }
+
+  struct CpuUsage {
+    uint64_t frame_count = 0;
+    // CPU time of the on_frame_ready() calls, i.e., excluding time spent
+    // sleeping (e.g., waiting for the GPU) and in units drained inline
+    std::chrono::nanoseconds cpu_time{0};
+  };
+  [[nodiscard]] CpuUsage get_cpu_usage() const {
+    return {m_metrics.on_frame_ready_latency->count(),
+            std::chrono::nanoseconds(m_metrics.cpu_time_ns->value())};
   }
 
   /**
-   * @brief Starts the internal worker thread.
+   * @brief Starts the internal worker thread, or, if the shared
+   * WorkStealingExecutor is enabled and the unit didn't opt out, has frames
+   * processed on it from now on.
    */
   void start() {
     if (m_running.load()) {
       return; // Already running
     }
     m_running.store(true);
+    if (!m_dedicated_thread)
+      m_executor = Utils::WorkStealingExecutor::get_instance();
+    if (m_executor != nullptr) {
+      SPDLOG_INFO("asynchronous_processing_unit {} started on the shared "
+                  "executor",
+                  m_unit_path);
+      return;
+    }
     m_worker_thread =
         std::thread(&IAsynchronousProcessingUnit::dequeue_loop, this);
     SPDLOG_INFO("asynchronous_processing_unit {} started", m_unit_path);
@@ -131,11 +236,31 @@ public:
     }
 
     m_running.store(false);
-    m_cv.notify_all(); // Wake up thread if it is sleeping
+    m_queue->wake_all(); // Wake up threads if they are sleeping
 
     if (m_worker_thread.joinable()) {
       m_worker_thread.join();
     }
+    if (m_executor != nullptr) {
+      // Let the drain tasks finish what's already queued, as the dedicated
+      // thread would. Callers stop producers first, so the queue only shrinks
+      using namespace std::chrono_literals;
+      // m_drain_task_count also covers a task that has just cleared
+      // m_drain_scheduled but is still touching this unit
+      while (m_drain_scheduled.load() || m_queue->size_approx() > 0 ||
+             m_drain_task_count.load() > 0) {
+        schedule_drain();
+        if (!try_drain_inline())
+          std::this_thread::sleep_for(1ms);
+      }
+    }
+    const auto [oldest, newest, stale] = get_drop_counts();
+    const auto [frame_count, cpu_time] = get_cpu_usage();
+    SPDLOG_INFO("{}: frames dropped (oldest/newest/stale): {}/{}/{}, frames "
+                "processed: {}, cpu_time(ms): {}",
+                m_unit_path, oldest, newest, stale, frame_count,
+                std::chrono::duration_cast<std::chrono::milliseconds>(cpu_time)
+                    .count());
   }
 
 protected:
@@ -146,55 +271,257 @@ protected:
   virtual void on_frame_ready(cv::cuda::GpuMat &frame,
                               PipelineContext &ctx) = 0;
 
+  // Shared by all frame arenas of the unit, e.g., its stages' ones
+  static std::shared_ptr<Utils::Counter>
+  get_frame_arena_heap_allocations_counter(const std::string &unit_path) {
+    return Utils::MetricsRegistry::instance().counter(
+        "matrix_pipeline_unit_frame_arena_heap_allocations_total",
+        "Allocations the unit's frame arenas couldn't serve from their buffers",
+        {{"unit", unit_path}});
+  }
+
 private:
   /**
    * @brief The internal thread loop.
    * Pops items from the queue and delegates to process_frame().
    */
   void dequeue_loop() {
-    // std::this_thread::sleep_for(std::chrono::seconds(5));
-    // SPDLOG_INFO("Now start dequeue_loop()");
-    while (m_running.load() || !is_queue_empty()) {
+    using namespace std::chrono_literals;
+    while (true) {
       AsyncPayload payload;
+      if (!m_queue->wait_pop(payload, 100ms)) {
+        if (!m_running.load())
+          break; // Exit condition, the queue is drained
+        continue;
+      }
+      process_payload(payload);
+    }
+  }
+
+  /**
+   * @brief The executor counterpart of dequeue_loop(). At most one drain task
+   * per unit is pending or running at any time (m_drain_scheduled), which
+   * keeps the unit's frames in order and its on_frame_ready() serialized,
+   * while different units run in parallel.
+   */
+  void drain() {
+    // Yield after a few frames s.t. a busy unit can't hog a worker
+    constexpr int max_frames_per_task = 8;
+    drain_frames(max_frames_per_task);
+    m_drain_scheduled.store(false);
+    // Frames pushed after we found the queue empty (or had enough of it),
+    // whose producers saw m_drain_scheduled still set. If try_drain_inline()
+    // holds m_drain_running, it reschedules once done instead
+    if (m_queue->size_approx() > 0 && !m_drain_running.load())
+      schedule_drain();
+  }
 
-      {
-        std::unique_lock lock(m_queue_mutex);
+  /**
+   * @brief Processes one frame on the calling thread, for a producer waiting
+   * for room in our queue (or stop()) rather than for a worker to get to us.
+   * @return false if the queue is empty or someone else is draining it
+   */
+  bool try_drain_inline() {
+    const bool drained = drain_frames(1) > 0;
+    // A drain task that ran meanwhile left the rest to us
+    if (m_queue->size_approx() > 0)
+      schedule_drain();
+    return drained;
+  }
 
-        // Wait until the queue has data OR we are asked to stop
-        m_cv.wait(lock, [this] {
-          return !m_processing_queue.empty() || !m_running.load();
-        });
+  // Up to max_frames, serialized by m_drain_running between drain tasks and
+  // try_drain_inline(). Returns the number of frames processed
+  int drain_frames(const int max_frames) {
+    if (m_drain_running.exchange(true))
+      return 0;
+    int count = 0;
+    for (; count < max_frames; ++count) {
+      AsyncPayload payload;
+      if (!m_queue->try_pop(payload))
+        break;
+      process_payload(payload);
+    }
+    m_drain_running.store(false);
+    return count;
+  }
 
-        if (m_processing_queue.empty()) {
-          if (!m_running.load())
-            break;  // Exit condition
-          continue; // Spurious wake-up check
-        }
+  void schedule_drain() {
+    if (m_drain_scheduled.exchange(true))
+      return;
+    m_drain_task_count.fetch_add(1);
+    m_executor->submit([this] {
+      drain();
+      // The last access to this unit, stop() may return right after
+      m_drain_task_count.fetch_sub(1);
+    });
+  }
 
-        payload = m_processing_queue.front();
-        m_processing_queue.pop();
-      }
-      try {
-        on_frame_ready(payload.frame, payload.ctx);
-      } catch (const std::exception &e) {
-        SPDLOG_ERROR("std::exception from {}: e.what(): {}", m_unit_path,
-                     e.what());
-        disable();
-      }
+  void process_payload(AsyncPayload &payload) {
+    m_queued_bytes.fetch_sub(get_frame_bytes(payload.frame),
+                             std::memory_order_relaxed);
+    m_metrics.dequeued->inc();
+    m_metrics.queue_depth->set(m_queue->size_approx());
+    if (is_stale(payload.ctx)) {
+      m_metrics.dropped_stale->inc();
+      return;
+    }
+    // Checked here rather than in enqueue(), s.t. the time spent queueing
+    // counts too
+    if (exceeds_latency_budget(payload.ctx))
+      return;
+    TRACE_SCOPE(m_trace_name, "on_frame_ready", payload.ctx.frame_seq_num);
+    const auto start_time = std::chrono::steady_clock::now();
+    const auto cpu_time_start = get_thread_cpu_time_ns();
+    const auto nested_cpu_time_start = t_nested_cpu_time_ns;
+    payload.ctx.arena = m_frame_arena.resource();
+    try {
+      on_frame_ready(payload.frame, payload.ctx);
+    } catch (const std::exception &e) {
+      SPDLOG_ERROR("std::exception from {}: e.what(): {}", m_unit_path,
+                   e.what());
+      disable();
     }
+    // The frame retires from this branch
+    payload.ctx.arena = std::pmr::new_delete_resource();
+    m_frame_arena.reset();
+    // Units we drained inline on this thread (see try_drain_inline()) count
+    // their own CPU time, which is excluded from ours. Our whole time is in
+    // turn excluded from the unit that runs us, if any
+    const auto cpu_time = get_thread_cpu_time_ns() - cpu_time_start;
+    const auto nested_cpu_time =
+        std::min(t_nested_cpu_time_ns - nested_cpu_time_start, cpu_time);
+    m_metrics.cpu_time_ns->inc(cpu_time - nested_cpu_time);
+    t_nested_cpu_time_ns = nested_cpu_time_start + cpu_time;
+    m_metrics.on_frame_ready_latency->observe(std::chrono::steady_clock::now() -
+                                              start_time);
   }
 
-  bool is_queue_empty() {
-    std::lock_guard<std::mutex> lock(m_queue_mutex);
-    return m_processing_queue.empty();
+  // CPU time of the process_payload() calls on this thread, see above
+  static inline thread_local uint64_t t_nested_cpu_time_ns = 0;
+
+  static uint64_t get_thread_cpu_time_ns() {
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+  }
+
+  // Approximate under contention, i.e., concurrent producers may overshoot
+  // the limits by a frame or so each
+  bool is_queue_full(const size_t incoming_bytes) const {
+    const auto size = m_queue->size_approx();
+    if (size == 0)
+      return false;
+    return size >= m_queue_policy.max_frames ||
+           (m_queue_policy.max_bytes > 0 &&
+            m_queued_bytes.load(std::memory_order_relaxed) + incoming_bytes >
+                m_queue_policy.max_bytes);
+  }
+
+  bool pop_oldest() {
+    AsyncPayload oldest;
+    if (!m_queue->try_pop(oldest))
+      return false;
+    m_queued_bytes.fetch_sub(get_frame_bytes(oldest.frame),
+                             std::memory_order_relaxed);
+    m_metrics.dropped_oldest->inc();
+    return true;
+  }
+
+  bool is_stale(const PipelineContext &ctx) const {
+    // Lossless sources' timestamps don't follow the wall clock anyway
+    if (m_queue_policy.max_frame_age.count() <= 0 || ctx.device_info->lossless)
+      return false;
+    return std::chrono::steady_clock::now() - ctx.capture_timestamp >
+           m_queue_policy.max_frame_age;
+  }
+
+  void warn_dropped_frames_throttled() {
+    using namespace std::chrono_literals;
+    constexpr auto warning_throttle_interval = 5s;
+    const auto now = std::chrono::steady_clock::now();
+    // Producers may race here, only the one winning the exchange logs
+    auto last_warning_time = m_last_warning_time.load();
+    if (now - last_warning_time < warning_throttle_interval ||
+        !m_last_warning_time.compare_exchange_strong(last_warning_time, now))
+      return;
+    const auto [oldest, newest, stale] = get_drop_counts();
+    SPDLOG_WARN("{}: queue is full (queue_policy: {}, max_frames: {}, "
+                "max_bytes: {}), frames dropped so far (oldest/newest/stale): "
+                "{}/{}/{} (this message is throttled to once per {} sec)",
+                m_unit_path, QueuePolicy::type_to_string(m_queue_policy.type),
+                m_queue_policy.max_frames, m_queue_policy.max_bytes, oldest,
+                newest, stale, warning_throttle_interval.count());
+  }
+
+  static size_t get_frame_bytes(const cv::cuda::GpuMat &frame) {
+    return frame.empty() ? 0 : frame.step * frame.rows;
   }
 
-  std::queue<AsyncPayload> m_processing_queue;
-  std::mutex m_queue_mutex;
-  std::condition_variable m_cv;
+  const char *m_trace_name;
+  QueuePolicy m_queue_policy;
+  // Lock-free hand-off from any number of producers (parent branches) to the
+  // worker thread. Recreated by configure_queue() to match the policy
+  std::unique_ptr<Utils::MpscRing<AsyncPayload>> m_queue;
+  std::atomic<size_t> m_queued_bytes{0};
   std::atomic<bool> m_running{false};
   std::thread m_worker_thread;
-  std::chrono::steady_clock::time_point m_last_warning_time;
+  bool m_dedicated_thread = false;
+  // Non-null if frames are processed on the shared executor instead of
+  // m_worker_thread
+  Utils::WorkStealingExecutor *m_executor = nullptr;
+  std::atomic<bool> m_drain_scheduled{false};
+  // Held while frames are processed, see drain_frames()
+  std::atomic<bool> m_drain_running{false};
+  std::atomic<int> m_drain_task_count{0};
+  std::atomic<std::chrono::steady_clock::time_point> m_last_warning_time;
+
+  struct Metrics {
+    std::shared_ptr<Utils::Gauge> queue_depth;
+    std::shared_ptr<Utils::Counter> enqueued;
+    std::shared_ptr<Utils::Counter> dequeued;
+    std::shared_ptr<Utils::Counter> dropped_oldest;
+    std::shared_ptr<Utils::Counter> dropped_newest;
+    std::shared_ptr<Utils::Counter> dropped_stale;
+    // Its count is the number of frames processed
+    std::shared_ptr<Utils::Histogram> on_frame_ready_latency;
+    std::shared_ptr<Utils::Counter> cpu_time_ns;
+    std::shared_ptr<Utils::Counter> frame_arena_heap_allocations;
+
+    explicit Metrics(const std::string &unit_path) {
+      auto &registry = Utils::MetricsRegistry::instance();
+      const Utils::MetricLabels labels{{"unit", unit_path}};
+      const auto dropped = [&](const std::string &reason) {
+        auto dropped_labels = labels;
+        dropped_labels.emplace_back("reason", reason);
+        return registry.counter("matrix_pipeline_unit_dropped_frames_total",
+                                "Frames dropped by the unit's queue",
+                                dropped_labels);
+      };
+      queue_depth = registry.gauge("matrix_pipeline_unit_queue_depth",
+                                   "Frames waiting in the unit's queue",
+                                   labels);
+      enqueued = registry.counter("matrix_pipeline_unit_enqueued_frames_total",
+                                  "Frames pushed into the unit's queue",
+                                  labels);
+      dequeued = registry.counter("matrix_pipeline_unit_dequeued_frames_total",
+                                  "Frames taken off the unit's queue", labels);
+      dropped_oldest = dropped("oldest");
+      dropped_newest = dropped("newest");
+      dropped_stale = dropped("stale");
+      on_frame_ready_latency = registry.histogram(
+          "matrix_pipeline_unit_on_frame_ready_seconds",
+          "Wall time of the unit's on_frame_ready() calls", labels);
+      cpu_time_ns = registry.counter(
+          "matrix_pipeline_unit_cpu_seconds_total",
+          "CPU time of the unit's on_frame_ready() calls, excluding nested "
+          "units run inline",
+          labels, 1e-9);
+      frame_arena_heap_allocations =
+          get_frame_arena_heap_allocations_counter(unit_path);
+    }
+  };
+  Metrics m_metrics{m_unit_path};
+  Utils::FrameArena m_frame_arena{m_metrics.frame_arena_heap_allocations};
 
   static int get_hours_from_local_time() {
     const auto local_datetime = std::chrono::zoned_time{
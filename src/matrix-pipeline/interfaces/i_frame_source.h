@@ -0,0 +1,49 @@
+#pragma once
+
+#include "../entities/processing_context.h"
+
+#include <nlohmann/json.hpp>
+#include <opencv2/core/cuda.hpp>
+
+#include <string>
+
+namespace MatrixPipeline::FrameSource {
+
+using njson = nlohmann::json;
+
+/**
+ * @brief Where a VideoFeedManager's frames come from, e.g., a live camera or a
+ * recorded file. A source is driven by the capture thread only.
+ */
+class IFrameSource {
+public:
+  virtual ~IFrameSource() = default;
+
+  /**
+   * @param config the device config
+   */
+  virtual bool init(const njson &config) = 0;
+
+  /**
+   * @brief Fills frame and the capture-related fields of ctx
+   * (capture_timestamp, frame_seq_num, captured_from_real_device, etc.)
+   * @return false if the source is exhausted, i.e., the end of a recorded
+   * file is reached. Live sources are never exhausted.
+   */
+  virtual bool next_frame(cv::cuda::GpuMat &frame,
+                          ProcessingUnit::PipelineContext &ctx) = 0;
+
+  /// Releases the underlying resources, e.g., background threads
+  virtual void stop() {}
+
+  /**
+   * @brief Lossless sources must never have frames dropped, the pipeline
+   * applies backpressure to them instead (i.e., enqueue() blocks).
+   */
+  [[nodiscard]] virtual bool is_lossless() const { return false; }
+
+  /// A short, human-readable summary of source-specific stats for logging
+  [[nodiscard]] virtual std::string get_stats_summary() const { return ""; }
+};
+
+} // namespace MatrixPipeline::FrameSource
@@ -1,10 +1,14 @@
 #pragma once
 
+#include "../entities/latency_budget.h"
 #include "../entities/processing_context.h"
+#include "../utils/metrics.h"
 
 #include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
 
+#include <atomic>
+
 namespace MatrixPipeline::ProcessingUnit {
 
 using njson = nlohmann::json;
@@ -12,11 +16,20 @@ using njson = nlohmann::json;
 class IProcessingUnit {
 protected:
   const std::string m_unit_path;
-  bool m_is_disabled{false};
+  // Read by /metrics scrapes, i.e., from other threads
+  std::atomic<bool> m_is_disabled{false};
+  std::shared_ptr<Utils::Gauge> m_disabled_gauge;
+  LatencyBudget m_latency_budget;
+  // Non-null iff a latency budget is configured
+  std::shared_ptr<Utils::Counter> m_over_budget_count;
 
 public:
   explicit IProcessingUnit(std::string unit_path)
-      : m_unit_path(std::move(unit_path)) {
+      : m_unit_path(std::move(unit_path)),
+        m_disabled_gauge(Utils::MetricsRegistry::instance().gauge(
+            "matrix_pipeline_unit_disabled",
+            "1 if the unit has been disabled, e.g., after it threw",
+            {{"unit", m_unit_path}})) {
     SPDLOG_INFO("Initializing processing_unit: {}", m_unit_path);
   };
   IProcessingUnit() = default;
@@ -27,10 +40,54 @@ public:
 
   virtual bool init(const njson &config) = 0;
 
-  [[nodiscard]] bool is_disabled() const { return m_is_disabled; };
+  [[nodiscard]] bool is_disabled() const {
+    return m_is_disabled.load(std::memory_order_relaxed);
+  };
+
+  /**
+   * @brief Parses the unit's LatencyBudget, to be called before the first
+   * frame arrives
+   */
+  bool configure_latency_budget(const njson &config) {
+    try {
+      m_latency_budget = LatencyBudget::from_json(config);
+    } catch (const std::exception &e) {
+      SPDLOG_ERROR("{}: invalid latency budget: {}", m_unit_path, e.what());
+      return false;
+    }
+    if (m_latency_budget.budget.count() <= 0)
+      return true;
+    m_over_budget_count = Utils::MetricsRegistry::instance().counter(
+        "matrix_pipeline_unit_over_budget_frames_total",
+        "Frames already older than the unit's latency budget when they "
+        "reached it",
+        {{"unit", m_unit_path},
+         {"action",
+          LatencyBudget::action_to_string(m_latency_budget.on_exceeded)}});
+    SPDLOG_INFO("{}: latency_budget(ms): {}, on_exceeded: {}", m_unit_path,
+                m_latency_budget.budget.count(),
+                LatencyBudget::action_to_string(m_latency_budget.on_exceeded));
+    return true;
+  }
+
+  [[nodiscard]] const LatencyBudget &get_latency_budget() const {
+    return m_latency_budget;
+  }
+
+  /// Whether ctx's frame is too old for this unit to spend any work on it
+  bool exceeds_latency_budget(const PipelineContext &ctx) const {
+    if (!m_latency_budget.is_exceeded(ctx))
+      return false;
+    m_over_budget_count->inc();
+    return true;
+  }
 
   /// Disable this unit
-  void disable() { m_is_disabled = true; };
+  void disable() {
+    m_is_disabled.store(true, std::memory_order_relaxed);
+    if (m_disabled_gauge != nullptr)
+      m_disabled_gauge->set(1);
+  };
 };
 
 } // namespace MatrixPipeline::ProcessingUnit
\ No newline at end of file
@@ -2,15 +2,23 @@
 
 #include "../entities/processing_context.h"
 #include "../entities/synchronous_processing_result.h"
+#include "../utils/tracer.h"
 #include "i_processing_unit.h"
 
+#include <chrono>
+
 namespace MatrixPipeline::ProcessingUnit {
 
 class ISynchronousProcessingUnit : public IProcessingUnit {
 
 public:
   explicit ISynchronousProcessingUnit(const std::string &unit_path)
-      : IProcessingUnit(unit_path) {};
+      : IProcessingUnit(unit_path),
+        m_process_latency(Utils::MetricsRegistry::instance().histogram(
+            "matrix_pipeline_unit_process_seconds",
+            "Wall time of the unit's process() calls",
+            {{"unit", m_unit_path}})),
+        m_trace_name(Utils::Tracer::intern(m_unit_path)) {};
 
   ///
   /// @param frame the frame to be processed
@@ -18,6 +26,29 @@ public:
   /// @return
   virtual SynchronousProcessingResult process(cv::cuda::GpuMat &frame,
                                               PipelineContext &ctx) = 0;
+
+  /**
+   * @brief Whether process() writes into the pixels of frame (as opposed to
+   * only reading them or re-pointing frame to a new buffer).
+   * The buffer may be shared with other asynchronous branches, so the caller
+   * makes it exclusive (i.e., copies it if needed) before calling process() on
+   * units returning true.
+   */
+  [[nodiscard]] virtual bool writes_frame_in_place() const { return false; }
+
+  /// process(), with its latency recorded for /metrics and traced
+  SynchronousProcessingResult timed_process(cv::cuda::GpuMat &frame,
+                                            PipelineContext &ctx) {
+    TRACE_SCOPE(m_trace_name, "process", ctx.frame_seq_num);
+    const auto start_time = std::chrono::steady_clock::now();
+    const auto result = process(frame, ctx);
+    m_process_latency->observe(std::chrono::steady_clock::now() - start_time);
+    return result;
+  }
+
+private:
+  std::shared_ptr<Utils::Histogram> m_process_latency;
+  const char *m_trace_name;
 };
 
 } // namespace MatrixPipeline::ProcessingUnit
\ No newline at end of file
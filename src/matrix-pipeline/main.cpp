@@ -1,5 +1,10 @@
 #include "global_vars.h"
+#include "synchronous_processing_units/yolo_detect.h"
+#include "utils/frame_pool.h"
+#include "utils/metrics.h"
 #include "utils/misc.h"
+#include "utils/tracer.h"
+#include "utils/work_stealing_executor.h"
 #include "video_feed_manager.h"
 
 #include <cxxopts.hpp>
@@ -11,8 +16,11 @@
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 
+#include <atomic>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <mutex>
 #include <vector>
 
 using namespace drogon;
@@ -22,11 +30,60 @@ using json = nlohmann::json;
 string config_path =
     string(getenv("HOME")) + "/.config/ak-studio/cuda-motion.jsonc";
 
-void signal_handler_cb(__attribute__((unused)) int signum) {
+// Set by SIGHUP or the /reload endpoint, served by the reload thread in main().
+// Lock-free, i.e., safe to set from a signal handler
+std::atomic<bool> reload_requested{false};
+
+void signal_handler_cb(int signum) {
+  if (signum == SIGHUP) {
+    reload_requested.store(true);
+    return;
+  }
   drogon::app().quit();
   ev_flag = 1;
 }
 
+/**
+ * @brief Re-reads config_path and reloads the pipeline of each device, see
+ * VideoFeedManager::reload(). Devices are matched by name, adding or removing
+ * devices (and any change to the top-level settings, e.g., the executor)
+ * takes a restart.
+ */
+bool reload_pipelines(
+    const std::vector<std::shared_ptr<MatrixPipeline::VideoFeedManager>>
+        &mgrs) {
+  SPDLOG_INFO("Reloading json settings from {}", config_path);
+  json new_settings;
+  try {
+    ifstream is(config_path);
+    new_settings = json::parse(is, nullptr, true, true);
+  } catch (const std::exception &e) {
+    SPDLOG_ERROR("Failed to parse json from {}, nothing is reloaded: {}",
+                 config_path, e.what());
+    return false;
+  }
+  auto device_configs =
+      MatrixPipeline::VideoFeedManager::get_device_configs(new_settings);
+  bool reloaded = true;
+  for (const auto &mgr : mgrs) {
+    const auto it = std::ranges::find_if(device_configs, [&](const json &c) {
+      return c.value("name", "Unnamed Device") == mgr->get_name();
+    });
+    if (it == device_configs.end()) {
+      SPDLOG_WARN("Device [{}] is gone from {}, it keeps running until a "
+                  "restart",
+                  mgr->get_name(), config_path);
+      continue;
+    }
+    reloaded = mgr->reload(*it) && reloaded;
+    device_configs.erase(it);
+  }
+  for (const auto &device_config : device_configs)
+    SPDLOG_WARN("Device [{}] is new in {}, it is added after a restart",
+                device_config.value("name", "Unnamed Device"), config_path);
+  return reloaded;
+}
+
 void configure_spdlog() {
 
   // Define the queue size (the buffer for log messages)
@@ -65,12 +122,40 @@ void configure_spdlog() {
   }
 }
 
+/**
+ * @brief Pre-warms the TensorRT engine cache, s.t. the next start doesn't
+ * spend minutes building engines: init()s every yoloDetect unit of every
+ * device's pipeline (including nested ones), which builds and caches its
+ * engine unless a valid one is cached already
+ */
+bool build_engines(const std::vector<json> &device_configs) {
+  size_t succeeded = 0;
+  size_t failed = 0;
+  std::function<void(const json &)> visit = [&](const json &j) {
+    if (j.is_object() && j.contains("type") &&
+        j["type"] == "SynchronousProcessingUnit::yoloDetect") {
+      MatrixPipeline::ProcessingUnit::YoloDetect unit("/build-engines");
+      ++(unit.init(j) ? succeeded : failed);
+    }
+    if (j.is_structured()) {
+      for (const auto &child : j)
+        visit(child);
+    }
+  };
+  for (const auto &device_config : device_configs)
+    visit(device_config);
+  SPDLOG_INFO("TensorRT engines built or found in cache: {}, failed: {}",
+              succeeded, failed);
+  return failed == 0;
+}
+
 int main(int argc, char *argv[]) {
   cxxopts::Options options(argv[0], "video feed handler that uses CUDA");
   // clang-format off
   options.add_options()
     ("h,help", "print help message")
-    ("c,config-path", "path of the config file", cxxopts::value<string>()->default_value(config_path));
+    ("c,config-path", "path of the config file", cxxopts::value<string>()->default_value(config_path))
+    ("build-engines", "build the TensorRT engines of all yoloDetect units into their engine cache, then exit");
   // clang-format on
   auto result = options.parse(argc, argv);
   if (result.count("help") || !result.count("config-path")) {
@@ -96,11 +181,145 @@ int main(int argc, char *argv[]) {
     return EXIT_FAILURE;
   }
 
-  auto mgr = std::make_shared<MatrixPipeline::VideoFeedManager>();
-  if (!mgr->init()) {
-    SPDLOG_ERROR("Failed to initialize video feed manager");
+  {
+    // Recycles the per-frame device buffers, s.t. no cudaMalloc() happens in
+    // steady state. Must be installed before any frame is allocated
+    using namespace MatrixPipeline::Utils;
+    const auto frame_pool = settings.value("framePool", json::object());
+    const auto device_budget_mb =
+        frame_pool.value("deviceBudgetMb", size_t{2048});
+    const auto pinned_host_budget_mb =
+        frame_pool.value("pinnedHostBudgetMb", size_t{256});
+    DeviceFramePool::instance().set_budget(device_budget_mb << 20);
+    PinnedHostPool::instance().set_budget(pinned_host_budget_mb << 20);
+    if (device_budget_mb > 0)
+      cv::cuda::GpuMat::setDefaultAllocator(&DeviceFramePool::instance());
+    SPDLOG_INFO("frame pools configured, device_budget_mb: {}, "
+                "pinned_host_budget_mb: {}",
+                device_budget_mb, pinned_host_budget_mb);
+  }
+
+  // Optional: runs all asynchronous units on one pool of threads sized to the
+  // core count, instead of one thread per unit
+  if (const auto executor = settings.value("executor", json::object());
+      executor.value("type", "dedicatedThreads") == "workStealing") {
+    MatrixPipeline::Utils::WorkStealingExecutor::init(
+        executor.value("threadCount", size_t{0}));
+  }
+
+  // Optional: records spans of every frame's trip through the pipeline, see
+  // the /trace endpoint below
+  if (const auto tracing = settings.value("tracing", json::object());
+      tracing.value("enabled", false)) {
+    MatrixPipeline::Utils::Tracer::enable(
+        tracing.value("eventsPerThread", size_t{16384}));
+    SPDLOG_INFO("tracing enabled, events_per_thread: {}",
+                tracing.value("eventsPerThread", size_t{16384}));
+  }
+
+  const auto device_configs =
+      MatrixPipeline::VideoFeedManager::get_device_configs(settings);
+  if (device_configs.empty()) {
+    SPDLOG_ERROR("Neither devices nor device is defined in {}", config_path);
     return EXIT_FAILURE;
   }
+  if (result.count("build-engines"))
+    return build_engines(device_configs) ? EXIT_SUCCESS : EXIT_FAILURE;
+  // All devices share one process, so heavy resources (TensorRT engines,
+  // nvJPEG handle, HTTP listeners, etc.) are created once and reused.
+  std::vector<std::shared_ptr<MatrixPipeline::VideoFeedManager>> mgrs;
+  for (const auto &device_config : device_configs) {
+    auto mgr =
+        std::make_shared<MatrixPipeline::VideoFeedManager>(device_config);
+    if (!mgr->init()) {
+      SPDLOG_ERROR("Failed to initialize video feed manager for device [{}]",
+                   device_config.value("name", "Unnamed Device"));
+      return EXIT_FAILURE;
+    }
+    mgrs.push_back(std::move(mgr));
+  }
+
+  // Prometheus scrape endpoint, on a listener of its own s.t. it isn't exposed
+  // on the HttpService ports. Scrapes only read atomics, the frame path is
+  // never blocked by them. The same listener serves /trace?seconds=N, which
+  // returns the last N sec of spans as Chrome trace JSON, and POST /reload,
+  // which does what SIGHUP does
+  if (const auto metrics = settings.value("metrics", json::object());
+      metrics.value("enabled", false)) {
+    const auto bind_addr = metrics.value("bindAddr", "127.0.0.1");
+    const auto port = metrics.value("port", uint16_t{9464});
+    app().addListener(bind_addr, port);
+    app().registerHandler(
+        "/metrics",
+        [port](const HttpRequestPtr &req,
+               std::function<void(const HttpResponsePtr &)> &&callback) {
+          auto resp = HttpResponse::newHttpResponse();
+          if (req->getLocalAddr().toPort() != port) {
+            resp->setStatusCode(k404NotFound);
+            callback(resp);
+            return;
+          }
+          resp->setStatusCode(k200OK);
+          resp->setContentTypeString("text/plain; version=0.0.4");
+          resp->setBody(
+              MatrixPipeline::Utils::MetricsRegistry::instance().render());
+          callback(resp);
+        },
+        {Get});
+    app().registerHandler(
+        "/trace",
+        [port](const HttpRequestPtr &req,
+               std::function<void(const HttpResponsePtr &)> &&callback) {
+          using namespace MatrixPipeline::Utils;
+          auto resp = HttpResponse::newHttpResponse();
+          if (req->getLocalAddr().toPort() != port || !Tracer::is_enabled()) {
+            resp->setStatusCode(k404NotFound);
+            callback(resp);
+            return;
+          }
+          double seconds = 5;
+          try {
+            if (const auto &param = req->getParameter("seconds");
+                !param.empty())
+              seconds = std::stod(param);
+          } catch (const std::exception &) {
+            resp->setStatusCode(k400BadRequest);
+            callback(resp);
+            return;
+          }
+          resp->setStatusCode(k200OK);
+          resp->setContentTypeCode(CT_APPLICATION_JSON);
+          resp->addHeader("Content-Disposition",
+                          "attachment; filename=\"trace.json\"");
+          resp->setBody(Tracer::export_chrome_json(
+              std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::duration<double>(seconds))));
+          callback(resp);
+        },
+        {Get});
+    app().registerHandler(
+        "/reload",
+        [port](const HttpRequestPtr &req,
+               std::function<void(const HttpResponsePtr &)> &&callback) {
+          auto resp = HttpResponse::newHttpResponse();
+          if (req->getLocalAddr().toPort() != port) {
+            resp->setStatusCode(k404NotFound);
+            callback(resp);
+            return;
+          }
+          // Only scheduled, as units may take long to init(). The outcome is
+          // logged and counted in matrix_pipeline_config_reloads_total
+          reload_requested.store(true);
+          resp->setStatusCode(k202Accepted);
+          callback(resp);
+        },
+        {Post});
+    SPDLOG_INFO("metrics endpoint enabled on http://{}:{}/metrics", bind_addr,
+                port);
+  } else if (MatrixPipeline::Utils::Tracer::is_enabled()) {
+    SPDLOG_WARN("tracing is enabled but metrics is not, i.e., there is no "
+                "endpoint to export the traces");
+  }
 
   SPDLOG_INFO("Starting Drogon web server");
   auto th_drogon = std::thread([] {
@@ -111,12 +330,46 @@ int main(int argc, char *argv[]) {
         .run();
   });
 
-  SPDLOG_INFO("Starting VideoFeedManager's event loop thread");
-  mgr->feed_capture_ev();
-  SPDLOG_INFO("VideoFeedManager's event loop exited gracefully");
+  // Reloads are served on a thread of their own, s.t. neither the frame path
+  // nor Drogon's event loops wait for units being init()ed
+  std::atomic<bool> feeds_exited{false};
+  auto th_reload = std::thread([&mgrs, &feeds_exited] {
+    using namespace std::chrono_literals;
+    auto &registry = MatrixPipeline::Utils::MetricsRegistry::instance();
+    const auto reloads = [&](const std::string &result) {
+      return registry.counter("matrix_pipeline_config_reloads_total",
+                              "Config reloads (SIGHUP or /reload) by result",
+                              {{"result", result}});
+    };
+    const auto succeeded = reloads("success");
+    const auto failed = reloads("failure");
+    while (ev_flag == 0 && !feeds_exited.load()) {
+      if (reload_requested.exchange(false))
+        (reload_pipelines(mgrs) ? succeeded : failed)->inc();
+      else
+        std::this_thread::sleep_for(100ms);
+    }
+  });
+
+  SPDLOG_INFO("Starting {} VideoFeedManager event loop thread(s)",
+              mgrs.size());
+  std::vector<std::thread> th_mgrs;
+  th_mgrs.reserve(mgrs.size());
+  for (const auto &mgr : mgrs)
+    th_mgrs.emplace_back([mgr] { mgr->feed_capture_ev(); });
+  for (auto &th : th_mgrs)
+    th.join();
+  SPDLOG_INFO("VideoFeedManager event loops exited gracefully");
+  feeds_exited.store(true);
+  th_reload.join();
+  // All feeds may end without a signal, e.g., when replaying files
+  app().quit();
 
   th_drogon.join();
   SPDLOG_INFO("Drogon exited");
+  // Units may still be scheduled on the executor until they are destroyed
+  mgrs.clear();
+  MatrixPipeline::Utils::WorkStealingExecutor::shutdown();
 
   SPDLOG_INFO("matrix-pipeline will now exit gracefully");
   return EXIT_SUCCESS;
@@ -19,7 +19,8 @@ SynchronousProcessingResult AutoZoom::process(cv::cuda::GpuMat &frame,
                                               PipelineContext &ctx) {
 
   cv::Size input_size = frame.size();
-  if (!m_bounding_box_scale_params.has_value())
+  if (!m_bounding_box_scale_params.has_value() ||
+      !m_bounding_box_scale_params->is_valid_for(frame, ctx))
     m_bounding_box_scale_params =
         YoloDetect::get_bounding_box_scale(frame, ctx);
   // 3. Lazy Initialization of Resolution-Dependent values (On First Frame)
@@ -72,15 +73,15 @@ cv::Rect AutoZoom::calculate_target_roi(const cv::Size &input_size,
   cv::Rect union_rect(0, 0, input_size.width, input_size.height);
   bool valid_box_found = false;
 
-  if (!ctx.yolo.bounding_boxes.empty()) {
+  if (const auto &detections = ctx.yolo->detections; !detections.empty()) {
     int min_x = input_size.width, min_y = input_size.height;
     int max_x = 0, max_y = 0;
 
-    for (const auto idx : ctx.yolo.indices) {
-      if (!ctx.yolo.is_detection_interesting[idx])
+    for (size_t i = 0; i < detections.size(); ++i) {
+      if (!detections.is_interesting()[i])
         continue;
       const auto scaled_box = YoloDetect::get_scaled_bounding_box_coordinates(
-          ctx.yolo.bounding_boxes[idx], m_bounding_box_scale_params.value());
+          detections.boxes()[i], m_bounding_box_scale_params.value());
 
       if (scaled_box.width <= 0 || scaled_box.height <= 0)
         continue;
@@ -24,6 +24,9 @@ bool CollectStats::init(const njson &config) {
         config.value("/changeRate/frameCompareIntervalMs"_json_pointer,
                      m_change_rate_frame_compare_interval.count()));
 
+    m_use_secondary_stream =
+        config.value("useSecondaryStream", m_use_secondary_stream);
+
     if (m_change_rate_frame_compare_interval < 0ms)
       m_change_rate_frame_compare_interval = 0ms;
 
@@ -40,11 +43,11 @@ bool CollectStats::init(const njson &config) {
         "change_rate_threshold_per_pixel: {}, "
         "change_rate_frame_compare_interval(ms): {}, "
         "fps_sliding_window_length(ms): {}, append_info_to_overlay_text: {}, "
-        "overlay_text_template: {:?}",
+        "use_secondary_stream: {}, overlay_text_template: {:?}",
         m_change_rate_threshold_per_pixel,
         m_change_rate_frame_compare_interval.count(),
         m_fps_sliding_window_length.count(), m_append_info_to_overlay_text,
-        m_overlay_text_template);
+        m_use_secondary_stream, m_overlay_text_template);
 
     return true;
   } catch (const std::exception &e) {
@@ -102,16 +105,23 @@ SynchronousProcessingResult CollectStats::process(cv::cuda::GpuMat &frame,
   // 2. Calculate Change Rate
   // =========================================================
 
+  // The change rate is resolution-agnostic, so the (cheaper) secondary stream
+  // can be used if available
+  const auto &input_frame =
+      m_use_secondary_stream && !ctx.secondary_frame.empty()
+          ? ctx.secondary_frame
+          : frame;
+
   // Resize
-  cv::Size small_size(static_cast<int>(frame.cols * m_scale_factor),
-                      static_cast<int>(frame.rows * m_scale_factor));
+  cv::Size small_size(static_cast<int>(input_frame.cols * m_scale_factor),
+                      static_cast<int>(input_frame.rows * m_scale_factor));
 
   if (d_small.size() != small_size) {
-    d_small.create(small_size, frame.type());
+    d_small.create(small_size, input_frame.type());
     m_history_buffer.clear(); // Reset history on size change
   }
 
-  cv::cuda::resize(frame, d_small, small_size);
+  cv::cuda::resize(input_frame, d_small, small_size);
 
   // Convert to Grayscale
   if (d_small.channels() > 1) {
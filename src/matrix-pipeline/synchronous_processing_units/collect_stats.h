@@ -24,6 +24,7 @@ public:
 
 private:
   bool m_append_info_to_overlay_text{true};
+  bool m_use_secondary_stream{false};
   std::string m_overlay_text_template;
   // --- Configuration ---
   const double m_scale_factor{0.25};
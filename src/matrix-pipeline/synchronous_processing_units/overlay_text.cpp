@@ -9,7 +9,8 @@
 
 #include <algorithm>
 #include <chrono>
-#include <sstream>
+#include <memory_resource>
+#include <string_view>
 #include <vector>
 
 namespace MatrixPipeline::ProcessingUnit {
@@ -43,12 +44,14 @@ SynchronousProcessingResult OverlayText::process(cv::cuda::GpuMat &frame,
     m_last_overlay_at = std::chrono::steady_clock::now();
 
     // --- 2. Split into Lines ---
-    std::vector<std::string> lines;
-    std::stringstream ss(ctx.text_to_overlay);
-    // SPDLOG_INFO("ctx.text_to_overlay: {}", ctx.text_to_overlay);
-    std::string line;
-    while (std::getline(ss, line, '\n')) {
-      lines.push_back(line);
+    // Views into ctx.text_to_overlay, split as std::getline() would, i.e.,
+    // without an empty line after a trailing '\n'
+    std::pmr::vector<std::string_view> lines(ctx.arena);
+    const std::string_view text = ctx.text_to_overlay;
+    for (size_t start = 0; start < text.size();) {
+      const auto end = std::min(text.find('\n', start), text.size());
+      lines.push_back(text.substr(start, end - start));
+      start = end + 1;
     }
 
     if (lines.empty())
@@ -83,15 +86,16 @@ SynchronousProcessingResult OverlayText::process(cv::cuda::GpuMat &frame,
       }
 
       cv::Point org(x, currentY);
+      m_line.assign(txt);
 
       if (m_outline_ratio > 0.0f) {
         // Draw thicker outline behind
-        cv::putText(m_h_text_strip, txt, org, cv::FONT_HERSHEY_DUPLEX,
+        cv::putText(m_h_text_strip, m_line, org, cv::FONT_HERSHEY_DUPLEX,
                     m_current_opencv_scale, m_glow_color,
                     m_current_outline_thickness, cv::LINE_AA);
       }
       // Draw main text
-      cv::putText(m_h_text_strip, txt, org, cv::FONT_HERSHEY_DUPLEX,
+      cv::putText(m_h_text_strip, m_line, org, cv::FONT_HERSHEY_DUPLEX,
                   m_current_opencv_scale, m_text_color, m_current_thickness,
                   cv::LINE_AA);
 
@@ -24,6 +24,8 @@ public:
   [[nodiscard]] SynchronousProcessingResult
   process(cv::cuda::GpuMat &frame, PipelineContext &ctx) override;
 
+  [[nodiscard]] bool writes_frame_in_place() const override { return true; }
+
 private:
   void update_font_metrics(int frameRows);
   void upload_and_overlay(const cv::cuda::GpuMat &frame, cv::Rect roi_rect);
@@ -56,6 +58,8 @@ private:
   cv::cuda::GpuMat m_d_text_strip;
   cv::cuda::GpuMat m_d_strip_gray;
   cv::cuda::GpuMat m_d_mask;
+  // The line being drawn, cv::putText() takes a std::string
+  std::string m_line;
 
   static constexpr float BASE_FONT_HEIGHT_PX = 22.0f;
 };
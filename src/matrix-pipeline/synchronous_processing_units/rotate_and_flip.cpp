@@ -13,27 +13,35 @@ RotateAndFlip::process(cv::cuda::GpuMat &frame,
     return failure_and_stop;
   }
   if (m_angle.has_value()) {
+    // Always render into a fresh buffer: frame may be shared with other
+    // asynchronous branches, so it must not be written in place
+    cv::cuda::GpuMat rotated;
     switch (m_angle.value()) {
     case 90:
-      cv::cuda::rotate(frame.clone(), frame,
+      cv::cuda::rotate(frame, rotated,
                        cv::Size(frame.size().height, frame.size().width),
                        m_angle.value(), 0, frame.size().width);
       break;
     case 180:
-      cv::cuda::rotate(frame.clone(), frame, frame.size(), m_angle.value(),
+      cv::cuda::rotate(frame, rotated, frame.size(), m_angle.value(),
                        frame.size().width, frame.size().height);
       break;
     case 270:
-      cv::cuda::rotate(frame.clone(), frame,
+      cv::cuda::rotate(frame, rotated,
                        cv::Size(frame.size().height, frame.size().width),
                        m_angle.value(), frame.size().height, 0);
       break;
     default: {
     }
     }
+    if (!rotated.empty())
+      frame = std::move(rotated);
+  }
+  if (m_flip_code.has_value()) {
+    cv::cuda::GpuMat flipped;
+    cv::cuda::flip(frame, flipped, m_flip_code.value());
+    frame = std::move(flipped);
   }
-  if (m_flip_code.has_value())
-    cv::cuda::flip(frame, frame, m_flip_code.value());
   return success_and_continue;
 }
 
@@ -222,15 +222,15 @@ SynchronousProcessingResult SfaceDetect::process(cv::cuda::GpuMat &frame,
   }
 
   m_last_inference_at = std::chrono::steady_clock::now();
-  ctx.yunet_sface.results.clear();
-  m_prev_yunet_sface_ctx.results.clear();
+  ctx.yunet_sface = {};
+  m_prev_yunet_sface_ctx = {};
 
   if (const auto res = m_yunet.process(frame, ctx);
       res == success_and_stop || res == failure_and_stop) {
     return failure_and_continue;
   }
 
-  if (ctx.yunet_sface.results.empty())
+  if (ctx.yunet_sface->results.empty())
     return success_and_continue;
 
   try {
@@ -242,11 +242,14 @@ SynchronousProcessingResult SfaceDetect::process(cv::cuda::GpuMat &frame,
   } catch (const cv::Exception &e) {
     SPDLOG_ERROR("frame.download() failed: {}", e.what());
     disable();
-    ctx.yunet_sface.results.clear();
+    ctx.yunet_sface = {};
     return success_and_continue;
   }
 
-  for (auto &[detection, recognition] : ctx.yunet_sface.results) {
+  // YuNet's detections are filled in with the recognitions and published as a
+  // new snapshot
+  auto yunet_sface = ctx.yunet_sface.copy();
+  for (auto &[detection, recognition] : yunet_sface.results) {
     // TODO: potentially problematic if YuNet has fixed input
     m_sface->alignCrop(m_frame_cpu, detection.yunet_output, m_aligned_face);
     if (m_aligned_face.empty())
@@ -308,6 +311,8 @@ SynchronousProcessingResult SfaceDetect::process(cv::cuda::GpuMat &frame,
     recognition.cosine_score = best_cosine_score;
   }
 
+  ctx.yunet_sface = std::move(yunet_sface);
+  // A pointer copy, reused by the frames skipped before the next inference
   m_prev_yunet_sface_ctx = ctx.yunet_sface;
   return success_and_continue;
 }
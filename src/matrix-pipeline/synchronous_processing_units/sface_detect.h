@@ -46,7 +46,7 @@ private:
   float m_inference_recognition_quality_confidence_threshold{10.0};
   std::chrono::milliseconds m_inference_interval{100ms};
   std::chrono::time_point<std::chrono::steady_clock> m_last_inference_at;
-  YuNetSFaceContext m_prev_yunet_sface_ctx;
+  SharedSnapshot<YuNetSFaceContext> m_prev_yunet_sface_ctx;
   std::vector<Identity> m_gallery;
 
   // Helper: Returns false if gallery cannot be populated
@@ -1,4 +1,6 @@
 #include "sface_overlay.h"
+#include "../utils/frame_cow.h"
+#include "../utils/json_text.h"
 #include "../utils/misc.h"
 
 #include <fmt/format.h>
@@ -6,6 +8,10 @@
 #include <opencv2/imgproc.hpp>
 #include <spdlog/spdlog.h>
 
+#include <iterator>
+#include <memory_resource>
+#include <string_view>
+
 namespace MatrixPipeline::ProcessingUnit {
 
 bool SFaceOverlay::init(const njson &config) {
@@ -37,27 +43,29 @@ bool SFaceOverlay::init(const njson &config) {
 SynchronousProcessingResult SFaceOverlay::process(cv::cuda::GpuMat &frame,
                                                   PipelineContext &ctx) {
 
-  // std::string yunet_text_to_overlay = "YuNet: ";
-  njson yunet_jsons;
-  njson sface_jsons;
-  // std::string sface_text_to_overlay = "SFace: ";
-  // ctx.text_to_overlay += "SFace: ";
   // We also check YuNet because SFace results rely on YuNet geometry.
-  if (ctx.yunet_sface.results.empty()) {
-    ctx.text_to_overlay += fmt::format("YuNet: []\nSFace: []\n");
+  if (ctx.yunet_sface->results.empty()) {
+    ctx.text_to_overlay += "YuNet: []\nSFace: []\n";
     return failure_and_continue;
   }
+  // The results as JSON arrays, formatted directly as they are only appended
+  // to the overlay text
+  std::pmr::string yunet_text(ctx.arena);
+  std::pmr::string sface_text(ctx.arena);
 
   frame.download(m_pinned_mem_for_cpu_frame);
   // point the cv::Mat directly to the pinned memory
   m_frame_cpu = m_pinned_mem_for_cpu_frame.createMatHeader();
 
-  // std::string text_to_overlay;
-  for (const auto &[detection, recognition] : ctx.yunet_sface.results) {
+  const auto &results = ctx.yunet_sface->results;
+  for (size_t i = 0; i < results.size(); ++i) {
+    const auto &[detection, recognition] = results[i];
 
-    njson yunet_json;
-    yunet_json["conf"] = std::round(detection.face_score * 100.0) / 100.0;
-    yunet_jsons.emplace_back(yunet_json);
+    Utils::begin_json_array_line(yunet_text, i);
+    yunet_text += R"({"conf":)";
+    Utils::append_json_number(yunet_text,
+                              std::round(detection.face_score * 100.0) / 100.0);
+    yunet_text += '}';
     // Convert Rect2f (float) to Rect (int) for cleaner pixel drawing
     const cv::Rect bounding_box = detection.bounding_box;
 
@@ -65,19 +73,25 @@ SynchronousProcessingResult SFaceOverlay::process(cv::cuda::GpuMat &frame,
     cv::rectangle(m_frame_cpu, bounding_box,
                   identity_to_box_color_bgr[recognition.category],
                   m_bounding_box_border_thickness);
-    njson sface_json;
-    sface_json["ID"] = recognition.identity;
-    sface_json["cos"] = std::round(recognition.cosine_score * 100.0) / 100.0;
-    sface_json["L2"] = std::round(recognition.l2_norm * 100.0) / 100.0;
-    sface_jsons.emplace_back(sface_json);
+    // Keys in the order njson would dump them
+    Utils::begin_json_array_line(sface_text, i);
+    sface_text += R"({"ID":)";
+    Utils::append_json_string(sface_text, recognition.identity);
+    sface_text += R"(,"L2":)";
+    Utils::append_json_number(sface_text,
+                              std::round(recognition.l2_norm * 100.0) / 100.0);
+    sface_text += R"(,"cos":)";
+    Utils::append_json_number(
+        sface_text, std::round(recognition.cosine_score * 100.0) / 100.0);
+    sface_text += '}';
     if (!recognition.l2_norm_threshold_crossed ||
         !recognition.cosine_score_threshold_crossed)
       continue;
 
-    const auto bounding_box_label_text =
-        recognition.category != IdentityCategory::Unknown
-            ? fmt::format("{}", recognition.identity)
-            : "?";
+    static const std::string unknown_label_text = "?";
+    const std::string &bounding_box_label_text =
+        recognition.category != IdentityCategory::Unknown ? recognition.identity
+                                                          : unknown_label_text;
 
     // --- POSITIONING LOGIC FIX START ---
 
@@ -132,11 +146,16 @@ SynchronousProcessingResult SFaceOverlay::process(cv::cuda::GpuMat &frame,
     // --- POSITIONING LOGIC FIX END ---
   }
 
-  ctx.text_to_overlay +=
-      fmt::format("YuNet: {}\n", Utils::hybrid_njson_array_dump(yunet_jsons));
-  ctx.text_to_overlay +=
-      fmt::format("SFace: {}\n", Utils::hybrid_njson_array_dump(sface_jsons));
+  Utils::end_json_array_lines(yunet_text, results.size());
+  Utils::end_json_array_lines(sface_text, results.size());
+  fmt::format_to(std::back_inserter(ctx.text_to_overlay),
+                 "YuNet: {}\nSFace: {}\n", std::string_view(yunet_text),
+                 std::string_view(sface_text));
 
+  // Re-upload into a fresh buffer if frame is shared with other branches,
+  // copying it on the GPU first would be wasted work
+  if (Utils::is_shared(frame))
+    frame.release();
   frame.upload(m_frame_cpu);
 
   return success_and_continue;
@@ -1,18 +1,35 @@
 #include "yolo_detect.h"
 #include "../utils/cuda_helper.h"
+#include "../utils/shared_resource_registry.h"
+#include "../utils/tensor_cast.h"
+#include "../utils/tracer.h"
+#include "../utils/trt_engine_cache.h"
+#include "../utils/yolo_decoder.h"
+#include "yolo_int8_calibrator.h"
 
 #include <fmt/ranges.h>
 #include <opencv2/core/cuda_stream_accessor.hpp>
-#include <opencv2/cudaarithm.hpp>
-#include <opencv2/cudaimgproc.hpp>
-#include <opencv2/cudawarping.hpp>
 #include <opencv2/dnn.hpp>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <string>
 #include <vector>
 
 namespace MatrixPipeline::ProcessingUnit {
+
+namespace {
+std::string get_default_engine_cache_dir() {
+  const char *home = std::getenv("HOME");
+  return home == nullptr
+             ? ""
+             : std::string(home) + "/.cache/ak-studio/cuda-motion/trt-engines";
+}
+} // namespace
+
 bool YoloDetect::init(const njson &config) {
   try {
     if (!config.contains("modelPath")) {
@@ -30,79 +47,163 @@ bool YoloDetect::init(const njson &config) {
         config.value("inferenceIntervalMs", m_inference_interval.count()));
     m_confidence_threshold =
         config.value("confidenceThreshold", m_confidence_threshold);
-
-    // 1. Initialize TensorRT Builder and Network
-    const auto builder = std::unique_ptr<nvinfer1::IBuilder>(
-        nvinfer1::createInferBuilder(Utils::g_logger));
-    constexpr auto flags =
-        1U << static_cast<uint32_t>(
-            nvinfer1::NetworkDefinitionCreationFlag::kSTRONGLY_TYPED);
-    const auto network = std::unique_ptr<nvinfer1::INetworkDefinition>(
-        builder->createNetworkV2(flags));
-
-    // 2. Parse ONNX
-    const auto parser = std::unique_ptr<nvonnxparser::IParser>(
-        nvonnxparser::createParser(*network, Utils::g_logger));
-    if (!parser->parseFromFile(
-            model_path.c_str(),
-            static_cast<int>(nvinfer1::ILogger::Severity::kWARNING))) {
-      SPDLOG_ERROR("Failed to parse ONNX file: {}", model_path);
+    m_use_secondary_stream =
+        config.value("useSecondaryStream", m_use_secondary_stream);
+    m_record_output_tensor_path =
+        config.value("recordOutputTensorPath", m_record_output_tensor_path);
+    m_decode_on_device = config.value("decodeOnDevice", m_decode_on_device);
+    // Empty to always build the engine
+    const auto engine_cache_dir =
+        config.value("engineCacheDir", get_default_engine_cache_dir());
+    EngineBuildOptions build_options;
+    build_options.precision =
+        config.value("precision", build_options.precision);
+    if (build_options.precision != "stronglyTyped" &&
+        build_options.precision != "fp16" &&
+        build_options.precision != "int8") {
+      SPDLOG_ERROR("precision must be stronglyTyped, fp16 or int8, not {}",
+                   build_options.precision);
+      return false;
+    }
+    build_options.input_size = m_model_input_size;
+    build_options.int8_calibration_images_dir =
+        config.value("int8CalibrationImagesDir", std::string{});
+    build_options.int8_calibration_table_path = config.value(
+        "int8CalibrationTable",
+        engine_cache_dir.empty()
+            ? model_path + ".int8-calibration"
+            : fmt::format(
+                  "{}/{}.int8-calibration", engine_cache_dir,
+                  std::filesystem::path(model_path).stem().string()));
+    build_options.int8_calibration_max_images =
+        config.value("int8CalibrationMaxImages",
+                     build_options.int8_calibration_max_images);
+    // Above 1, inference goes through an InferenceServer shared with the
+    // other units (of any device) using the same model, which batches their
+    // frames. Needs a model exported with a dynamic batch dimension
+    build_options.max_batch_size =
+        config.value("maxBatchSize", build_options.max_batch_size);
+    const std::chrono::microseconds max_queue_delay(
+        config.value("maxQueueDelayUs", 2000));
+    if (build_options.max_batch_size < 1) {
+      SPDLOG_ERROR("maxBatchSize must be at least 1, not {}",
+                   build_options.max_batch_size);
       return false;
     }
 
-    // 3. Build Engine
-    auto trt_config = std::unique_ptr<nvinfer1::IBuilderConfig>(
-        builder->createBuilderConfig());
-    trt_config->setMemoryPoolLimit(nvinfer1::MemoryPoolType::kWORKSPACE,
-                                   1ULL << 30); // 1GB
-
-    SPDLOG_INFO(
-        "Building TensorRT Plan for model: {}, this could take minutes...",
-        model_path);
-    const auto start_time = std::chrono::steady_clock::now();
-    const auto plan = std::unique_ptr<nvinfer1::IHostMemory>(
-        builder->buildSerializedNetwork(*network, *trt_config));
-    if (!plan) {
-      SPDLOG_ERROR("builder->buildSerializedNetwork() failed");
+    // TensorRT engines are immutable once built, so all YoloDetect instances
+    // (possibly from different devices) using the same model share one
+    // ICudaEngine, each of them only owns a (cheap) IExecutionContext, or
+    // shares an InferenceServer.
+    const auto engine_key = fmt::format(
+        "{}@{}x{}/{}/b{}", model_path, m_model_input_size.width,
+        m_model_input_size.height, build_options.precision,
+        build_options.max_batch_size);
+    const Utils::TrtEngineCacheKey engine_cache_key{
+        .model_path = model_path,
+        .input_width = m_model_input_size.width,
+        .input_height = m_model_input_size.height,
+        .precision = build_options.precision,
+        .max_batch_size = build_options.max_batch_size,
+        .builder_fingerprint = Utils::get_trt_builder_fingerprint()};
+    m_engine =
+        Utils::SharedResourceRegistry<nvinfer1::ICudaEngine>::instance()
+            .get_or_create(engine_key, [&] {
+              return load_engine(engine_cache_key, engine_cache_dir,
+                                 build_options);
+            });
+    if (!m_engine) {
+      SPDLOG_ERROR("load_engine({}) failed", model_path);
       return false;
     }
-    const auto end_time = std::chrono::steady_clock::now();
-    SPDLOG_INFO(
-        "TensorRT Plan built successfully in {} seconds.",
-        std::chrono::duration_cast<std::chrono::seconds>(end_time - start_time)
-            .count());
-    const auto runtime = std::unique_ptr<nvinfer1::IRuntime>(
-        nvinfer1::createInferRuntime(Utils::g_logger));
-    // Much of the above boilerplate code is using local variables only, the
-    // real things we need for inference are just m_engine and m_context
-    m_engine = std::shared_ptr<nvinfer1::ICudaEngine>(
-        runtime->deserializeCudaEngine(plan->data(), plan->size()));
-    m_context = std::unique_ptr<nvinfer1::IExecutionContext>(
-        m_engine->createExecutionContext());
+    if (build_options.max_batch_size > 1) {
+      // One per engine and queue delay, s.t. units agreeing on both batch
+      // together
+      m_inference_server =
+          Utils::SharedResourceRegistry<Utils::InferenceServer>::instance()
+              .get_or_create(
+                  fmt::format("{}/{}us", engine_key, max_queue_delay.count()),
+                  [&] {
+                    return std::make_shared<Utils::InferenceServer>(
+                        m_engine,
+                        Utils::InferenceServer::Options{
+                            .max_batch_size = build_options.max_batch_size,
+                            .max_queue_delay = max_queue_delay,
+                            .name = engine_key});
+                  });
+      if (cudaEventCreateWithFlags(&m_input_ready, cudaEventDisableTiming) !=
+          cudaSuccess) {
+        SPDLOG_ERROR("cudaEventCreateWithFlags() failed");
+        return false;
+      }
+    } else {
+      m_context = std::unique_ptr<nvinfer1::IExecutionContext>(
+          m_engine->createExecutionContext());
+      // A dynamic batch dimension (see build_plan()) is pinned to 1 here, a
+      // dynamic input size to the one the engine was built for
+      const char *input_name = m_engine->getIOTensorName(0);
+      auto input_dims = m_engine->getTensorShape(input_name);
+      if (input_dims.d[0] == -1 || input_dims.d[2] == -1 ||
+          input_dims.d[3] == -1) {
+        if (input_dims.d[0] == -1)
+          input_dims.d[0] = 1;
+        input_dims.d[2] = m_model_input_size.height;
+        input_dims.d[3] = m_model_input_size.width;
+        if (!m_context->setInputShape(input_name, input_dims))
+          throw std::runtime_error("Error: setInputShape() failed.");
+      }
+    }
 
     // 4. Prepare Device Buffers
     // We assume index 0 is input, index 1 is output (standard for YOLO ONNX)
+    // Resolved by a context with the input shape set, the engine's own shape
+    // still has -1s in it if the model has dynamic dimensions
     const auto output_dims =
-        m_engine->getTensorShape(m_engine->getIOTensorName(1));
+        m_context ? m_context->getTensorShape(m_engine->getIOTensorName(1))
+                  : m_inference_server->get_output_dims();
     // For YOLOv11, dims.d[1] is usually 84, dims.d[2] is 8400
     m_output_dimensions = output_dims.d[1];
     m_output_rows = output_dims.d[2];
     {
       // m_output_count is total number of scalar elements (floats) in the
-      // tensor if you were to lay them all out in a single straight line. Say
-      // your tensor's dimensions are [1, 84, 8400], m_output_count will be 1
-      // * 84 * 8400 = 705600
+      // tensor of one frame if you were to lay them all out in a single
+      // straight line. Say your tensor's dimensions are [1, 84, 8400] (or
+      // [-1, 84, 8400], if the batch is dynamic), m_output_count will be
+      // 84 * 8400 = 705600
       m_output_count = 1;
-      for (int i = 0; i < output_dims.nbDims; ++i)
+      for (int i = 1; i < output_dims.nbDims; ++i)
         m_output_count *= output_dims.d[i];
       m_output_buffer_gpu =
           Utils::make_device_unique<float>(m_output_count * sizeof(float));
       m_output_cpu.resize(m_output_count);
     }
 
+    {
+      // Keyed by class id, e.g., {"0": 0.35} to keep less confident persons
+      m_class_thresholds.assign(m_output_dimensions - 4,
+                                m_confidence_threshold);
+      const auto class_confidence_thresholds =
+          config.value("classConfidenceThresholds", njson::object());
+      for (const auto &[class_id, threshold] :
+           class_confidence_thresholds.items()) {
+        const auto idx = std::stoul(class_id);
+        if (idx >= m_class_thresholds.size()) {
+          SPDLOG_ERROR("classConfidenceThresholds: no class {} among {}",
+                       class_id, m_class_thresholds.size());
+          return false;
+        }
+        m_class_thresholds[idx] = threshold.get<float>();
+      }
+      m_min_class_threshold = std::ranges::min(m_class_thresholds);
+      if (m_decode_on_device)
+        m_device_decoder = std::make_unique<Utils::YoloDeviceDecoder>(
+            m_output_dimensions, m_output_rows, m_class_thresholds);
+    }
+
     m_input_buffer_gpu = Utils::make_device_unique<float>(
         3 * m_model_input_size.width * m_model_input_size.height *
         sizeof(float));
+    m_preprocessor = std::make_unique<YoloPreprocessor>(m_model_input_size);
 
     {
       if (cudaStreamCreate(&m_cuda_stream) != cudaSuccess) {
@@ -134,13 +235,49 @@ bool YoloDetect::init(const njson &config) {
         throw std::runtime_error("Error: Tensor at Index 1 must be OUTPUT.");
       }
 
-      // 4. If we survived, bind them strictly
-      m_context->setTensorAddress(input_name, m_input_buffer_gpu.get());
-      m_context->setTensorAddress(output_name, m_output_buffer_gpu.get());
+      // 4. If we survived, bind them strictly, as the engine's tensor types
+      // say, which depend on the model and the precision it was built with.
+      // The InferenceServer binds its own batched buffers instead
+      const auto bind = [this](const char *name, float *float_buffer,
+                               std::unique_ptr<uint16_t, Utils::CudaDeleter>
+                                   &half_buffer,
+                               const size_t count) {
+        switch (m_engine->getTensorDataType(name)) {
+        case nvinfer1::DataType::kFLOAT:
+          m_context->setTensorAddress(name, float_buffer);
+          return "fp32";
+        case nvinfer1::DataType::kHALF:
+          half_buffer = Utils::make_device_unique<uint16_t>(count);
+          m_context->setTensorAddress(name, half_buffer.get());
+          return "fp16";
+        default:
+          throw std::runtime_error(
+              fmt::format("Error: Tensor {} must be FP32 or FP16.", name));
+        }
+      };
+      if (m_context) {
+        const auto input_type =
+            bind(input_name, m_input_buffer_gpu.get(), m_input_half_gpu,
+                 3 * static_cast<size_t>(m_model_input_size.area()));
+        const auto output_type = bind(output_name, m_output_buffer_gpu.get(),
+                                      m_output_half_gpu, m_output_count);
+        SPDLOG_INFO("precision: {}, input tensor: {}, output tensor: {}",
+                    build_options.precision, input_type, output_type);
+      } else if (m_inference_server->get_input_count() !=
+                 3 * static_cast<size_t>(m_model_input_size.area())) {
+        throw std::runtime_error(
+            "Error: Input size differs from the InferenceServer's.");
+      }
     }
 
-    SPDLOG_INFO("TensorRT Engine initialized from ONNX. Output size: {}",
-                m_output_count);
+    SPDLOG_INFO("TensorRT Engine initialized from ONNX. Output size: {}, "
+                "max batch size: {}, output decoded on: {}",
+                m_output_count,
+                m_inference_server ? m_inference_server->get_max_batch_size()
+                                   : 1,
+                m_device_decoder ? "device"
+                                 : Utils::yolo_decoder_isa_to_string(
+                                       Utils::get_best_yolo_decoder_isa()));
     return true;
   } catch (const std::exception &e) {
     SPDLOG_ERROR("Init failed: {}", e.what());
@@ -148,108 +285,197 @@ bool YoloDetect::init(const njson &config) {
   }
 }
 
-void YoloDetect::post_process_yolo(PipelineContext &ctx) const {
-
-  // We use the dimensions calculated in init() (e.g., 84 x 8400)
-  // m_output_cpu contains the data copied from GPU in process()
-  cv::Mat result_wrapper(m_output_dimensions, m_output_rows, CV_32F,
-                         const_cast<float *>(m_output_cpu.data()));
-  cv::Mat output_t;
-  cv::transpose(result_wrapper,
-                output_t); // Transpose to [rows, dimensions] (e.g. [8400, 84])
-
-  // 3. Reset Context Data
-  ctx.yolo.class_ids.clear();
-  ctx.yolo.confidences.clear();
-  ctx.yolo.bounding_boxes.clear();
-  ctx.yolo.is_detection_interesting.clear(); // Important to clear this too
-
-  // 4. Iterate over rows (anchors)
-  // m_output_rows is typically 8400 for YOLOv11
-  for (int i = 0; i < m_output_rows; ++i) {
-    auto *row_ptr = output_t.ptr<float>(i);
-
-    // Scores start at index 4 (after cx, cy, w, h)
-    // length is dimensions - 4 (e.g., 84 - 4 = 80 classes)
-    cv::Mat scores(1, m_output_dimensions - 4, CV_32F, row_ptr + 4);
-
-    cv::Point class_id_point;
-    double max_class_score;
-    cv::minMaxLoc(scores, 0, &max_class_score, 0, &class_id_point);
-
-    if (max_class_score > m_confidence_threshold) {
-      // c in cx/cy means center. cx and cy are the coordinates of the frame
-      // center
-      const float cx = row_ptr[0];
-      const float cy = row_ptr[1];
-      float w = row_ptr[2];
-      float h = row_ptr[3];
-      float left = cx - (0.5f * w);
-      float top = cy - (0.5f * h);
-      ctx.yolo.bounding_boxes.emplace_back(left, top, w, h);
-      ctx.yolo.confidences.push_back(static_cast<float>(max_class_score));
-      ctx.yolo.class_ids.push_back(class_id_point.x);
-      ctx.yolo.is_detection_interesting.push_back(false);
+std::vector<char> YoloDetect::build_plan(const std::string &model_path,
+                                         const EngineBuildOptions &options) {
+  // 1. Initialize TensorRT Builder and Network
+  const auto builder = std::unique_ptr<nvinfer1::IBuilder>(
+      nvinfer1::createInferBuilder(Utils::g_logger));
+  // Strongly typed networks run in the model's own types, TensorRT can only
+  // pick lower precisions for a weakly typed one
+  const auto flags =
+      options.precision == "stronglyTyped"
+          ? 1U << static_cast<uint32_t>(
+                nvinfer1::NetworkDefinitionCreationFlag::kSTRONGLY_TYPED)
+          : 0U;
+  const auto network = std::unique_ptr<nvinfer1::INetworkDefinition>(
+      builder->createNetworkV2(flags));
+
+  // 2. Parse ONNX
+  const auto parser = std::unique_ptr<nvonnxparser::IParser>(
+      nvonnxparser::createParser(*network, Utils::g_logger));
+  if (!parser->parseFromFile(
+          model_path.c_str(),
+          static_cast<int>(nvinfer1::ILogger::Severity::kWARNING))) {
+    SPDLOG_ERROR("Failed to parse ONNX file: {}", model_path);
+    return {};
+  }
+
+  // 3. Build Engine
+  auto trt_config = std::unique_ptr<nvinfer1::IBuilderConfig>(
+      builder->createBuilderConfig());
+  trt_config->setMemoryPoolLimit(nvinfer1::MemoryPoolType::kWORKSPACE,
+                                 1ULL << 30); // 1GB
+  // A model exported with a dynamic batch (and possibly input size) needs a
+  // profile, batches of up to max_batch_size are optimized for the largest
+  const auto *input = network->getInput(0);
+  auto input_dims = input->getDimensions();
+  nvinfer1::IOptimizationProfile *profile = nullptr;
+  if (input_dims.d[0] == -1) {
+    input_dims.d[2] = options.input_size.height;
+    input_dims.d[3] = options.input_size.width;
+    auto min_dims = input_dims;
+    min_dims.d[0] = 1;
+    input_dims.d[0] = options.max_batch_size;
+    profile = builder->createOptimizationProfile();
+    profile->setDimensions(input->getName(),
+                           nvinfer1::OptProfileSelector::kMIN, min_dims);
+    profile->setDimensions(input->getName(),
+                           nvinfer1::OptProfileSelector::kOPT, input_dims);
+    profile->setDimensions(input->getName(),
+                           nvinfer1::OptProfileSelector::kMAX, input_dims);
+    trt_config->addOptimizationProfile(profile);
+  } else if (options.max_batch_size > input_dims.d[0]) {
+    SPDLOG_WARN("{} has a static batch size of {}, re-export it with a "
+                "dynamic one to batch up to {}",
+                model_path, input_dims.d[0], options.max_batch_size);
+  }
+
+  // INT8 falls back to FP16 (rather than FP32) for layers without INT8
+  // kernels
+  if (options.precision == "fp16" || options.precision == "int8")
+    trt_config->setFlag(nvinfer1::BuilderFlag::kFP16);
+  std::unique_ptr<YoloInt8Calibrator> calibrator;
+  if (options.precision == "int8") {
+    // Batches of the profile's kOPT size, i.e., input_dims
+    calibrator = std::make_unique<YoloInt8Calibrator>(
+        options.int8_calibration_images_dir,
+        options.int8_calibration_table_path, options.input_size,
+        static_cast<int>(input_dims.d[0]),
+        input->getType() == nvinfer1::DataType::kHALF,
+        options.int8_calibration_max_images);
+    if (!calibrator->has_data()) {
+      SPDLOG_ERROR("INT8 precision needs int8CalibrationImagesDir or an "
+                   "existing int8CalibrationTable ({})",
+                   options.int8_calibration_table_path);
+      return {};
     }
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+    trt_config->setFlag(nvinfer1::BuilderFlag::kINT8);
+    trt_config->setInt8Calibrator(calibrator.get());
+    if (profile != nullptr)
+      trt_config->setCalibrationProfile(profile);
+#pragma GCC diagnostic pop
   }
 
-  // 5. NMS
-  ctx.yolo.indices.clear();
-  cv::dnn::NMSBoxes(ctx.yolo.bounding_boxes, ctx.yolo.confidences,
-                    m_confidence_threshold, m_nms_thres, ctx.yolo.indices);
+  SPDLOG_INFO("Building TensorRT Plan for model: {} ({}), this could take "
+              "minutes...",
+              model_path, options.precision);
+  const auto start_time = std::chrono::steady_clock::now();
+  const auto plan = std::unique_ptr<nvinfer1::IHostMemory>(
+      builder->buildSerializedNetwork(*network, *trt_config));
+  if (!plan) {
+    SPDLOG_ERROR("builder->buildSerializedNetwork() failed");
+    return {};
+  }
+  const auto end_time = std::chrono::steady_clock::now();
+  SPDLOG_INFO(
+      "TensorRT Plan built successfully in {} seconds.",
+      std::chrono::duration_cast<std::chrono::seconds>(end_time - start_time)
+          .count());
+  // Much of the above boilerplate code is using local variables only, the
+  // real thing we need for inference is just the plan
+  const auto *data = static_cast<const char *>(plan->data());
+  return {data, data + plan->size()};
 }
 
-SynchronousProcessingResult YoloDetect::process(cv::cuda::GpuMat &frame,
-                                                PipelineContext &ctx) {
-  struct LetterboxProps {
-    float scale;
-    int x_offset;
-    int y_offset;
+std::shared_ptr<nvinfer1::ICudaEngine>
+YoloDetect::load_engine(const Utils::TrtEngineCacheKey &key,
+                        const std::string &engine_cache_dir,
+                        const EngineBuildOptions &options) {
+  const auto runtime = std::unique_ptr<nvinfer1::IRuntime>(
+      nvinfer1::createInferRuntime(Utils::g_logger));
+  const auto deserialize = [&runtime](const std::vector<char> &plan) {
+    return std::shared_ptr<nvinfer1::ICudaEngine>(
+        plan.empty() ? nullptr
+                     : runtime->deserializeCudaEngine(plan.data(),
+                                                      plan.size()));
   };
-
-  auto letterbox_resize =
-      [](const cv::cuda::GpuMat &src, cv::cuda::GpuMat &dst,
-         cv::cuda::GpuMat
-             &intermediate_buffer, // Optimized: Pass pre-allocated buffer
-         const cv::Size &target_size,
-         cv::cuda::Stream &stream) -> LetterboxProps {
-    // A. Calculate Scaling Ratio (Model / Input)
-    const float scale_x =
-        static_cast<float>(target_size.width) / static_cast<float>(src.cols);
-    const float scale_y =
-        static_cast<float>(target_size.height) / static_cast<float>(src.rows);
-    const float scale = std::min(scale_x, scale_y);
-
-    // B. Calculate New Dimensions (Unpadded)
-    const int new_w =
-        static_cast<int>(std::round(static_cast<float>(src.cols) * scale));
-    const int new_h =
-        static_cast<int>(std::round(static_cast<float>(src.rows) * scale));
-
-    // C. Resize into the intermediate buffer (Standard Linear Resize)
-    // Note: We use the passed 'intermediate_buffer' to avoid malloc on every
-    // frame
-    cv::cuda::resize(src, intermediate_buffer, cv::Size(new_w, new_h), 0, 0,
-                     cv::INTER_LINEAR, stream);
-
-    // D. Prepare Destination (Black/Grey Padding)
-    if (dst.size() != target_size || dst.type() != src.type()) {
-      dst.create(target_size, src.type());
+  const auto build = [&] { return build_plan(key.model_path, options); };
+  if (engine_cache_dir.empty())
+    return deserialize(build());
+
+  // An int8 plan also depends on the calibration table, s.t. deleting the
+  // table to recalibrate invalidates the plan too
+  const auto get_cache_key = [&key, &options] {
+    auto cache_key = key;
+    if (options.precision == "int8") {
+      const auto table_hash =
+          Utils::hash_file(options.int8_calibration_table_path);
+      cache_key.precision +=
+          table_hash.has_value()
+              ? fmt::format(";calibration={:016x}", *table_hash)
+              : std::string(";calibration=none");
     }
-    // 114 is the standard YOLO grey, 0 is black. Changing to 114 is safer for
-    // accuracy.
-    dst.setTo(cv::Scalar(114, 114, 114), stream);
-    // E. Copy Resized Image to Center of Destination
-    const int x_offset = (target_size.width - new_w) / 2;
-    const int y_offset = (target_size.height - new_h) / 2;
-
-    cv::cuda::GpuMat dst_roi = dst(cv::Rect(x_offset, y_offset, new_w, new_h));
-    intermediate_buffer.copyTo(dst_roi, stream);
-
-    // F. Return transformation properties for Post-Processing NMS
-    return LetterboxProps{scale, x_offset, y_offset};
+    return cache_key;
   };
+  Utils::TrtEngineCache cache(engine_cache_dir);
+  auto cache_key = get_cache_key();
+  auto plan = cache.get_or_build(cache_key, build);
+  if (plan.empty())
+    return nullptr;
+  if (const auto built_key = get_cache_key();
+      built_key.precision != cache_key.precision) {
+    // Calibrating has just written the table, the plan is filed under its
+    // hash instead, which is what the next start looks for
+    cache.invalidate(cache_key);
+    cache_key = built_key;
+    plan = cache.get_or_build(cache_key, [&plan] { return plan; });
+  }
+  if (auto engine = deserialize(plan))
+    return engine;
+  // Intact as far as the cache can tell, but TensorRT refused it anyway
+  SPDLOG_WARN("Failed to deserialize the cached plan of {}, rebuilding it",
+              key.model_path);
+  cache.invalidate(cache_key);
+  return deserialize(cache.get_or_build(cache_key, build));
+}
+
+void YoloDetect::post_process_yolo(YoloContext &yolo,
+                                   const LetterboxProps &letterbox) {
+  if (m_device_decoder) {
+    m_device_decoder->collect(m_candidates);
+  } else {
+    // m_output_cpu contains the data copied from GPU in process(), laid out
+    // as the dimensions calculated in init() (e.g., 84 x 8400). It is decoded
+    // as is, without transposing it to one row per anchor first
+    Utils::decode_yolo_output(m_output_cpu.data(), m_output_dimensions,
+                              m_output_rows, m_class_thresholds,
+                              m_candidates);
+  }
 
+  // Candidates already passed their class' threshold
+  cv::dnn::NMSBoxes(m_candidates.boxes, m_candidates.confidences,
+                    m_min_class_threshold, m_nms_thres, m_nms_indices);
+
+  // Survivors only, mapped from the letterboxed inference input back to the
+  // frame inference ran on
+  yolo.detections.clear();
+  for (const auto idx : m_nms_indices) {
+    const auto &box = m_candidates.boxes[idx];
+    yolo.detections.push_back(
+        cv::Rect(static_cast<int>((box.x - letterbox.x_offset) /
+                                  letterbox.scale),
+                 static_cast<int>((box.y - letterbox.y_offset) /
+                                  letterbox.scale),
+                 static_cast<int>(box.width / letterbox.scale),
+                 static_cast<int>(box.height / letterbox.scale)),
+        m_candidates.class_ids[idx], m_candidates.confidences[idx]);
+  }
+}
+
+SynchronousProcessingResult YoloDetect::process(cv::cuda::GpuMat &frame,
+                                                PipelineContext &ctx) {
   using namespace std::chrono;
 
   const auto steady_now = steady_clock::now();
@@ -259,65 +485,106 @@ SynchronousProcessingResult YoloDetect::process(cv::cuda::GpuMat &frame,
   }
   m_last_inference_time = steady_now;
 
-  if (frame.empty() || !m_context) {
+  // Detect on the (cheaper) secondary stream if asked to and a matching frame
+  // is available; boxes are mapped back via ctx.yolo.source_frame_size
+  const auto &input_frame =
+      m_use_secondary_stream && !ctx.secondary_frame.empty()
+          ? ctx.secondary_frame
+          : frame;
+  if (input_frame.empty() || (!m_context && !m_inference_server)) {
     return failure_and_continue;
   }
 
-  ctx.yolo.inference_input_size = m_model_input_size;
+  // Built aside and published as a whole, the snapshot in ctx may be shared
+  // with other branches
+  YoloContext yolo;
+  yolo.inference_input_size = m_model_input_size;
+  yolo.source_frame_size = input_frame.size();
 
   try {
-    // YOLO expects us to use "letterbox resize", not just resize()
-    letterbox_resize(frame, m_resized_gpu, m_resized_gpu_buffer,
-                     m_model_input_size, m_cv_stream);
-
-    // 2. Color Convert: BGR -> RGB
-    cv::cuda::cvtColor(m_resized_gpu, m_rgb, cv::COLOR_BGR2RGB, 0, m_cv_stream);
-    // alpha is  1.0/255.0, while in yunet_detect.cpp it is 1.0
-    // Convert to Float32 and Normalize (0-1 range) for YOLOv11
-    // This creates the exact memory layout TensorRT expects.
-    m_rgb.convertTo(m_normalized_gpu, CV_32FC3, 1.0 / 255.0, m_cv_stream);
-
-    // 4. HWC -> NCHW Conversion， We split the interleaved Mat into 3 separate
-    // planes (R, G, B)
-
-    cv::cuda::split(m_normalized_gpu, m_channels, m_cv_stream);
-
-    for (int i = 0; i < 3; ++i) {
-      // We use cudaMemcpy2DAsync because GpuMat rows might be padded (step !=
-      // width)
-      cudaMemcpy2DAsync(
-          // Dest: Offset for R, G, or B plane
-          m_input_buffer_gpu.get() + i * m_model_input_size.area(),
-          m_model_input_size.width *
-              sizeof(float),  // Dest Pitch (Linear, so equal to width)
-          m_channels[i].data, // Src: Ptr to GpuMat data
-          m_channels[i].step, // Src Pitch: GpuMat step (padding)
-          m_model_input_size.width * sizeof(float), // Width in bytes to copy
-          m_model_input_size.height,                // Height (rows)
-          cudaMemcpyDeviceToDevice, m_cuda_stream);
+    // 1-4. Letterbox, BGR -> RGB, normalize and HWC -> NCHW
+    const auto letterbox = m_preprocessor->run(
+        input_frame, m_input_buffer_gpu.get(), m_cv_stream);
+
+    // 5. Enqueue Inference, or have the InferenceServer batch it with other
+    // units' frames. Its stream (rather than this thread) waits for the
+    // preprocessing, and the output is complete once the future is ready
+    if (m_inference_server) {
+      if (cudaEventRecord(m_input_ready, m_cuda_stream) != cudaSuccess) {
+        SPDLOG_ERROR("cudaEventRecord() failed");
+        return failure_and_continue;
+      }
+      TRACE_SCOPE("InferenceServer", "cuda", ctx.frame_seq_num);
+      m_inference_server
+          ->submit(m_input_buffer_gpu.get(), m_input_ready,
+                   m_output_buffer_gpu.get())
+          .get();
+    } else {
+      if (m_input_half_gpu &&
+          Utils::cast_float_to_half(
+              m_input_buffer_gpu.get(), m_input_half_gpu.get(),
+              3 * static_cast<size_t>(m_model_input_size.area()),
+              m_cuda_stream) != cudaSuccess) {
+        SPDLOG_ERROR("cast_float_to_half() failed");
+        return failure_and_continue;
+      }
+      if (!m_context->enqueueV3(m_cuda_stream)) {
+        SPDLOG_ERROR("TensorRT enqueueV3 failed");
+        return failure_and_continue;
+      }
+      if (m_output_half_gpu &&
+          Utils::cast_half_to_float(m_output_half_gpu.get(),
+                                    m_output_buffer_gpu.get(), m_output_count,
+                                    m_cuda_stream) != cudaSuccess) {
+        SPDLOG_ERROR("cast_half_to_float() failed");
+        return failure_and_continue;
+      }
     }
 
-    // 5. Enqueue Inference
-    if (!m_context->enqueueV3(m_cuda_stream)) {
-      SPDLOG_ERROR("TensorRT enqueueV3 failed");
-      return failure_and_continue;
+    // 6. Decode on the device, s.t. only the candidates are copied back, or
+    // copy the whole output (GPU -> CPU) to decode it there
+    if (m_device_decoder) {
+      if (const auto err = m_device_decoder->enqueue(m_output_buffer_gpu.get(),
+                                                     m_cuda_stream);
+          err != cudaSuccess) {
+        SPDLOG_ERROR("YoloDeviceDecoder::enqueue() failed: {}",
+                     cudaGetErrorString(err));
+        return failure_and_continue;
+      }
+    }
+    if (!m_device_decoder || !m_record_output_tensor_path.empty()) {
+      // Moves data from m_output_buffer_gpu to m_output_cpu
+      cudaMemcpyAsync(m_output_cpu.data(), m_output_buffer_gpu.get(),
+                      m_output_count * sizeof(float), cudaMemcpyDeviceToHost,
+                      m_cuda_stream);
     }
-
-    // 6. Copy Output (GPU -> CPU)
-    // Moves data from m_output_buffer_gpu to m_output_cpu
-    cudaMemcpyAsync(m_output_cpu.data(), m_output_buffer_gpu.get(),
-                    m_output_count * sizeof(float), cudaMemcpyDeviceToHost,
-                    m_cuda_stream);
 
     // 7. Synchronize
     // This effectively "locks" the CPU until inference is done.
     // It prevents 'local_input' from being destroyed while GPU is still reading
     // it.
-    cudaStreamSynchronize(m_cuda_stream);
+    {
+      TRACE_SCOPE("cudaStreamSynchronize", "cuda", ctx.frame_seq_num);
+      cudaStreamSynchronize(m_cuda_stream);
+    }
+
+    // Once, s.t. the output decoding can be checked against real tensors
+    // offline, e.g., with yolo_decoder_bench
+    if (!m_record_output_tensor_path.empty()) {
+      std::ofstream file(m_record_output_tensor_path, std::ios::binary);
+      file.write(reinterpret_cast<const char *>(m_output_cpu.data()),
+                 static_cast<std::streamsize>(m_output_count * sizeof(float)));
+      SPDLOG_INFO("Output tensor ({} x {} float32) recorded to {}",
+                  m_output_dimensions, m_output_rows,
+                  m_record_output_tensor_path);
+      m_record_output_tensor_path.clear();
+    }
 
     // 8. Parse Results
-    post_process_yolo(ctx);
+    post_process_yolo(yolo, letterbox);
 
+    ctx.yolo = std::move(yolo);
+    // Skipped frames get the same snapshot, not a copy of it
     m_prev_yolo_ctx = ctx.yolo;
     return success_and_continue;
 
@@ -330,6 +597,9 @@ SynchronousProcessingResult YoloDetect::process(cv::cuda::GpuMat &frame,
 
 YoloDetect::~YoloDetect() {
 
+  if (m_input_ready) {
+    cudaEventDestroy(m_input_ready);
+  }
   if (m_cuda_stream) {
     cudaStreamDestroy(m_cuda_stream);
   }
@@ -339,31 +609,28 @@ BoundingBoxScaleParams
 YoloDetect::get_bounding_box_scale(const cv::cuda::GpuMat &frame,
                                    const PipelineContext &ctx) {
   BoundingBoxScaleParams params;
-  const auto scale_x =
-      static_cast<double>(ctx.yolo.inference_input_size.width) /
-      static_cast<double>(frame.cols);
-  const auto scale_y =
-      static_cast<double>(ctx.yolo.inference_input_size.height) /
-      static_cast<double>(frame.rows);
-  params.scale = std::min(scale_x, scale_y);
-  params.x_offset =
-      (ctx.yolo.inference_input_size.width - (frame.cols * params.scale)) / 2;
-  params.y_offset =
-      (ctx.yolo.inference_input_size.height - frame.rows * params.scale) / 2;
+  params.target_frame_size = frame.size();
+  params.source_frame_size = ctx.yolo->source_frame_size.empty()
+                                 ? frame.size()
+                                 : ctx.yolo->source_frame_size;
+  const auto &source = params.source_frame_size;
+  // Both streams cover the same field of view, so the mapping between them is
+  // a plain per-axis stretch, even if their aspect ratios differ
+  params.target_scale_x = static_cast<double>(params.target_frame_size.width) /
+                          static_cast<double>(source.width);
+  params.target_scale_y =
+      static_cast<double>(params.target_frame_size.height) /
+      static_cast<double>(source.height);
 
   return params;
 }
 
 cv::Rect YoloDetect::get_scaled_bounding_box_coordinates(
     const cv::Rect &orig_box, const BoundingBoxScaleParams &params) {
-  const float x_original = (orig_box.x - params.x_offset) / params.scale;
-  const float y_original = (orig_box.y - params.y_offset) / params.scale;
-  const float w_original = orig_box.width / params.scale;
-  const float h_original = orig_box.height / params.scale;
-  cv::Rect drawn_box(static_cast<int>(x_original), static_cast<int>(y_original),
-                     static_cast<int>(w_original),
-                     static_cast<int>(h_original));
-  return drawn_box;
+  return {static_cast<int>(orig_box.x * params.target_scale_x),
+          static_cast<int>(orig_box.y * params.target_scale_y),
+          static_cast<int>(orig_box.width * params.target_scale_x),
+          static_cast<int>(orig_box.height * params.target_scale_y)};
 }
 
 } // namespace MatrixPipeline::ProcessingUnit
\ No newline at end of file
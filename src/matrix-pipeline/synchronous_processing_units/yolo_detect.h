@@ -2,6 +2,11 @@
 
 #include "../interfaces/i_synchronous_processing_unit.h"
 #include "../utils/cuda_helper.h"
+#include "../utils/inference_server.h"
+#include "../utils/trt_engine_cache.h"
+#include "../utils/yolo_decoder.h"
+#include "../utils/yolo_device_decoder.h"
+#include "yolo_preprocessor.h"
 
 #include <NvInfer.h> // TensorRT Core Header
 #include <NvOnnxParser.h> // ONNX Parser Header (Required to build the engine from .onnx at runtime)
@@ -12,9 +17,20 @@ namespace MatrixPipeline::ProcessingUnit {
 using namespace std::chrono_literals;
 
 struct BoundingBoxScaleParams {
-  double scale;
-  int x_offset;
-  int y_offset;
+  // Maps the frame inference ran on (e.g., the secondary stream) to the frame
+  // boxes are applied to, 1.0 if they are the same
+  double target_scale_x = 1.0;
+  double target_scale_y = 1.0;
+  cv::Size source_frame_size;
+  cv::Size target_frame_size;
+
+  [[nodiscard]] bool is_valid_for(const cv::cuda::GpuMat &frame,
+                                  const PipelineContext &ctx) const {
+    return target_frame_size == frame.size() &&
+           source_frame_size == (ctx.yolo->source_frame_size.empty()
+                                     ? frame.size()
+                                     : ctx.yolo->source_frame_size);
+  }
 };
 
 class YoloDetect final : public ISynchronousProcessingUnit {
@@ -22,12 +38,21 @@ private:
   // --- TensorRT Smart Pointers ---
   // We use unique_ptrs with custom deleters or shared_ptrs for TRT objects
   std::shared_ptr<nvinfer1::ICudaEngine> m_engine;
+  // Exactly one of them: the unit's own context if maxBatchSize is 1, or the
+  // server it shares with every unit using the same engine
   std::unique_ptr<nvinfer1::IExecutionContext> m_context;
+  std::shared_ptr<Utils::InferenceServer> m_inference_server;
+  // Recorded once the input is preprocessed, for m_inference_server to wait
+  cudaEvent_t m_input_ready = nullptr;
 
   // --- GPU Memory Management ---
   // Raw pointer for TRT binding
   std::unique_ptr<float, Utils::CudaDeleter> m_output_buffer_gpu = nullptr;
   std::unique_ptr<float, Utils::CudaDeleter> m_input_buffer_gpu = nullptr;
+  // Only if the engine's tensor is FP16, bound instead of the float buffers
+  // above, which preprocessing and decoding keep working with
+  std::unique_ptr<uint16_t, Utils::CudaDeleter> m_input_half_gpu = nullptr;
+  std::unique_ptr<uint16_t, Utils::CudaDeleter> m_output_half_gpu = nullptr;
   std::vector<float> m_output_cpu; // For downloading inference results
   size_t m_output_count = 0;       // Total floats in the output tensor
 
@@ -35,22 +60,53 @@ private:
   cv::cuda::Stream m_cv_stream;
   int m_output_dimensions{-1};
   int m_output_rows{-1};
-  // --- OpenCV GpuMat Buffers (Reuse these to avoid re-allocation) ---
-  cv::cuda::GpuMat m_resized_gpu, m_resized_gpu_buffer;
-  cv::cuda::GpuMat m_normalized_gpu;
-  cv::cuda::GpuMat m_rgb;
-  std::vector<cv::cuda::GpuMat> m_channels;
+  // Owns the GpuMat buffers, reused to avoid re-allocation
+  std::unique_ptr<YoloPreprocessor> m_preprocessor;
 
   // Non-TRT-related
   cv::Size m_model_input_size = {640, 640}; // Default YOLO size
   float m_confidence_threshold = 0.5f;
+  // Per class id, m_confidence_threshold unless overridden
+  std::vector<float> m_class_thresholds;
+  float m_min_class_threshold = 0.5f;
   float m_nms_thres = 0.45f;
   int m_frame_interval = 10;
+  bool m_use_secondary_stream = false;
+  // Raw float32 output of the first inference is written here if set
+  std::string m_record_output_tensor_path;
   std::chrono::milliseconds m_inference_interval = 100ms;
   std::chrono::time_point<std::chrono::steady_clock> m_last_inference_time;
-  YoloContext m_prev_yolo_ctx;
-
-  void post_process_yolo(PipelineContext &ctx) const;
+  SharedSnapshot<YoloContext> m_prev_yolo_ctx;
+  // NMS candidates, in inference input space. Members s.t. their capacity is
+  // reused across frames
+  Utils::YoloCandidates m_candidates;
+  bool m_decode_on_device = true;
+  // Null if the output is decoded on the CPU
+  std::unique_ptr<Utils::YoloDeviceDecoder> m_device_decoder;
+  std::vector<int> m_nms_indices;
+
+  struct EngineBuildOptions {
+    // "stronglyTyped" (i.e., the types the model itself says), "fp16" or
+    // "int8", the latter two let TensorRT pick lower precision kernels
+    std::string precision = "stronglyTyped";
+    cv::Size input_size;
+    // INT8 only, see YoloInt8Calibrator
+    std::string int8_calibration_images_dir;
+    std::string int8_calibration_table_path;
+    size_t int8_calibration_max_images = 512;
+    // Of the optimization profile, if the model's batch dimension is dynamic
+    int max_batch_size = 1;
+  };
+
+  void post_process_yolo(YoloContext &yolo, const LetterboxProps &letterbox);
+  // The serialized plan of model_path, empty on failure
+  static std::vector<char> build_plan(const std::string &model_path,
+                                      const EngineBuildOptions &options);
+  // From the plan cached in engine_cache_dir if any, see Utils::TrtEngineCache
+  static std::shared_ptr<nvinfer1::ICudaEngine>
+  load_engine(const Utils::TrtEngineCacheKey &key,
+              const std::string &engine_cache_dir,
+              const EngineBuildOptions &options);
 
 public:
   explicit YoloDetect(const std::string &unit_path)
@@ -0,0 +1,149 @@
+#include "yolo_int8_calibrator.h"
+#include "../utils/tensor_cast.h"
+
+#include <opencv2/core/cuda_stream_accessor.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+namespace MatrixPipeline::ProcessingUnit {
+
+namespace {
+bool is_image(const std::filesystem::path &path) {
+  static constexpr std::array extensions = {".jpg", ".jpeg", ".png", ".bmp"};
+  auto extension = path.extension().string();
+  std::ranges::transform(extension, extension.begin(), [](const char c) {
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  });
+  return std::ranges::find(extensions, extension) != extensions.end();
+}
+} // namespace
+
+YoloInt8Calibrator::YoloInt8Calibrator(const std::string &images_dir,
+                                       std::string table_path,
+                                       const cv::Size &input_size,
+                                       const int batch_size,
+                                       const bool half_input,
+                                       const size_t max_images)
+    : m_table_path(std::move(table_path)), m_input_size(input_size),
+      m_batch_size(std::max(batch_size, 1)), m_half_input(half_input),
+      m_preprocessor(input_size) {
+  if (!images_dir.empty()) {
+    std::error_code ec;
+    for (const auto &entry :
+         std::filesystem::directory_iterator(images_dir, ec)) {
+      if (entry.is_regular_file() && is_image(entry.path()))
+        m_image_paths.push_back(entry.path());
+    }
+    if (ec)
+      SPDLOG_WARN("Failed to list INT8 calibration images in {}: {}",
+                  images_dir, ec.message());
+    // Sorted, s.t. the same images give the same table
+    std::ranges::sort(m_image_paths);
+    if (m_image_paths.size() > max_images)
+      m_image_paths.resize(max_images);
+  }
+  const auto tensor_size = static_cast<size_t>(m_batch_size) * 3 *
+                           static_cast<size_t>(m_input_size.area());
+  m_batch_gpu = Utils::make_device_unique<float>(tensor_size);
+  if (m_half_input)
+    m_batch_half_gpu = Utils::make_device_unique<uint16_t>(tensor_size);
+  SPDLOG_INFO("INT8 calibrator: {} images from [{}], table: {}",
+              m_image_paths.size(), images_dir, m_table_path);
+}
+
+bool YoloInt8Calibrator::has_data() const {
+  std::error_code ec;
+  return !m_image_paths.empty() || std::filesystem::exists(m_table_path, ec);
+}
+
+bool YoloInt8Calibrator::getBatch(void *bindings[],
+                                  [[maybe_unused]] const char *names[],
+                                  const int32_t nb_bindings) noexcept {
+  if (nb_bindings != 1)
+    return false;
+  try {
+    const auto plane_count = 3 * static_cast<size_t>(m_input_size.area());
+    int filled = 0;
+    while (filled < m_batch_size && m_next_image < m_image_paths.size()) {
+      const auto &path = m_image_paths[m_next_image++];
+      const auto image = cv::imread(path.string(), cv::IMREAD_COLOR);
+      if (image.empty()) {
+        SPDLOG_WARN("Failed to read INT8 calibration image {}, skipped",
+                    path.string());
+        continue;
+      }
+      m_frame.upload(image, m_stream);
+      m_preprocessor.run(m_frame, m_batch_gpu.get() + filled * plane_count,
+                         m_stream);
+      // m_frame is reused by the next image
+      m_stream.waitForCompletion();
+      ++filled;
+    }
+    // A partial last batch would skew the statistics, it is dropped
+    if (filled < m_batch_size)
+      return false;
+    if (m_half_input) {
+      if (Utils::cast_float_to_half(
+              m_batch_gpu.get(), m_batch_half_gpu.get(),
+              plane_count * m_batch_size,
+              cv::cuda::StreamAccessor::getStream(m_stream)) != cudaSuccess)
+        return false;
+      m_stream.waitForCompletion();
+      bindings[0] = m_batch_half_gpu.get();
+    } else {
+      bindings[0] = m_batch_gpu.get();
+    }
+    SPDLOG_INFO("INT8 calibration: {}/{} images", m_next_image,
+                m_image_paths.size());
+    return true;
+  } catch (const std::exception &e) {
+    SPDLOG_ERROR("INT8 calibration batch failed: {}", e.what());
+    return false;
+  }
+}
+
+const void *YoloInt8Calibrator::readCalibrationCache(size_t &length) noexcept {
+  m_table.clear();
+  std::ifstream file(m_table_path, std::ios::binary);
+  if (file)
+    m_table.assign(std::istreambuf_iterator<char>(file),
+                   std::istreambuf_iterator<char>());
+  length = m_table.size();
+  if (m_table.empty())
+    return nullptr;
+  SPDLOG_INFO("INT8 calibration table read from {}", m_table_path);
+  return m_table.data();
+}
+
+void YoloInt8Calibrator::writeCalibrationCache(const void *cache,
+                                               const size_t length) noexcept {
+  // Renamed into place, s.t. a crash never leaves a truncated table behind
+  const auto tmp_path = m_table_path + ".tmp";
+  {
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    file.write(static_cast<const char *>(cache),
+               static_cast<std::streamsize>(length));
+    if (!file) {
+      SPDLOG_WARN("Failed to write INT8 calibration table {}", tmp_path);
+      return;
+    }
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp_path, m_table_path, ec);
+  if (ec) {
+    SPDLOG_WARN("Failed to move INT8 calibration table into {}: {}",
+                m_table_path, ec.message());
+    return;
+  }
+  SPDLOG_INFO("INT8 calibration table ({} bytes) written to {}", length,
+              m_table_path);
+}
+
+} // namespace MatrixPipeline::ProcessingUnit
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "../utils/cuda_helper.h"
+#include "yolo_preprocessor.h"
+
+#include <NvInfer.h>
+#include <opencv2/core/cuda.hpp>
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace MatrixPipeline::ProcessingUnit {
+
+// Implicit (calibrated) INT8 quantization is deprecated as of TensorRT 10.1
+// in favor of explicit Q/DQ nodes in the model, but remains what works on a
+// plain FP32 ONNX export
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+
+/**
+ * @brief Feeds TensorRT's INT8 entropy calibration with sample frames (image
+ * files, e.g., snapshots from the very cameras) preprocessed as at inference.
+ *
+ * The resulting calibration table is persisted at table_path and reused by
+ * later builds, which then need no sample frames at all. Delete it to
+ * recalibrate, e.g., after replacing the model.
+ */
+class YoloInt8Calibrator final : public nvinfer1::IInt8EntropyCalibrator2 {
+public:
+  /**
+   * @param images_dir may be empty if the table at table_path exists
+   * @param batch_size the network input's batch dimension
+   * @param half_input whether the network input is FP16 rather than FP32
+   */
+  YoloInt8Calibrator(const std::string &images_dir, std::string table_path,
+                     const cv::Size &input_size, int batch_size,
+                     bool half_input, size_t max_images);
+
+  // Whether there are sample frames or a table to calibrate with
+  [[nodiscard]] bool has_data() const;
+
+  int32_t getBatchSize() const noexcept override { return m_batch_size; }
+  bool getBatch(void *bindings[], const char *names[],
+                int32_t nb_bindings) noexcept override;
+  const void *readCalibrationCache(size_t &length) noexcept override;
+  void writeCalibrationCache(const void *cache,
+                             size_t length) noexcept override;
+
+private:
+  std::vector<std::filesystem::path> m_image_paths;
+  size_t m_next_image = 0;
+  std::string m_table_path;
+  std::vector<char> m_table;
+  cv::Size m_input_size;
+  int m_batch_size;
+  bool m_half_input;
+  YoloPreprocessor m_preprocessor;
+  cv::cuda::Stream m_stream;
+  cv::cuda::GpuMat m_frame;
+  std::unique_ptr<float, Utils::CudaDeleter> m_batch_gpu;
+  // Only if the network input is FP16
+  std::unique_ptr<uint16_t, Utils::CudaDeleter> m_batch_half_gpu;
+};
+
+#pragma GCC diagnostic pop
+
+} // namespace MatrixPipeline::ProcessingUnit
@@ -1,4 +1,5 @@
 #include "yolo_overlay.h"
+#include "../utils/json_text.h"
 #include "../utils/misc.h"
 #include "yolo_detect.h"
 
@@ -9,6 +10,9 @@
 #include <spdlog/spdlog.h>
 
 #include <algorithm>
+#include <iterator>
+#include <memory_resource>
+#include <string_view>
 
 namespace MatrixPipeline::ProcessingUnit {
 
@@ -23,16 +27,17 @@ bool YoloOverlay::init([[maybe_unused]] const njson &config) {
 
 SynchronousProcessingResult YoloOverlay::process(cv::cuda::GpuMat &frame,
                                                  PipelineContext &ctx) {
-  if (frame.empty() || ctx.yolo.indices.empty()) {
-    ctx.text_to_overlay += fmt::format("Yolo: []\n");
+  if (frame.empty() || ctx.yolo->detections.empty()) {
+    ctx.text_to_overlay += "Yolo: []\n";
     return success_and_continue;
   }
-  if (!m_scaling_params.has_value())
+  if (!m_scaling_params.has_value() ||
+      !m_scaling_params->is_valid_for(frame, ctx))
     m_scaling_params = YoloDetect::get_bounding_box_scale(frame, ctx);
   try {
-    njson detection_jsons;
-
-    // Calculate the padding that was added to the model input
+    // The detections as a JSON array, formatted directly as it is only
+    // appended to the overlay text
+    std::pmr::string detections_text(ctx.arena);
 
     // ---------------------------------------------------------
     // 2. Prepare CPU Canvas
@@ -47,33 +52,36 @@ SynchronousProcessingResult YoloOverlay::process(cv::cuda::GpuMat &frame,
     // ---------------------------------------------------------
     // 3. Draw Detections
     // ---------------------------------------------------------
-    for (const auto idx : ctx.yolo.indices) {
-      njson detection_json;
-      const auto class_id = ctx.yolo.class_ids[idx];
-      const auto &orig_box =
-          ctx.yolo.bounding_boxes[idx]; // Box in 640x640 space
-      float conf = ctx.yolo.confidences[idx];
+    const auto &detections = ctx.yolo->detections;
+    for (size_t i = 0; i < detections.size(); ++i) {
+      const auto class_id = static_cast<size_t>(detections.class_ids()[i]);
+      const bool is_interesting = detections.is_interesting()[i];
+      float conf = detections.confidences()[i];
       auto drawn_box = YoloDetect::get_scaled_bounding_box_coordinates(
-          orig_box, m_scaling_params.value());
+          detections.boxes()[i], m_scaling_params.value());
       // clip the bounding box so that it stays strictly within the image
       // boundaries.
       drawn_box &= cv::Rect(0, 0, frame.cols, frame.rows);
 
-      std::string label = "Undefined";
+      std::string_view label = "Undefined";
       if (class_id < m_class_names.size()) {
         label = m_class_names[class_id];
       }
 
-      std::string label_text = fmt::format(
-          "{}{} {:.2f} ", !ctx.yolo.is_detection_interesting[idx] ? "(!)" : "",
-          label, conf);
-      detection_json["lbl"] = label;
-      detection_json["conf"] = fmt::format("{:.2f}", conf);
-      detection_json["roi"] = ctx.yolo.is_detection_interesting[idx];
+      m_label_text.clear();
+      fmt::format_to(std::back_inserter(m_label_text), "{}{} {:.2f} ",
+                     !is_interesting ? "(!)" : "", label, conf);
+      // Keys in the order njson would dump them
+      Utils::begin_json_array_line(detections_text, i);
+      fmt::format_to(std::back_inserter(detections_text),
+                     R"({{"conf":"{:.2f}","lbl":)", conf);
+      Utils::append_json_string(detections_text, label);
+      detections_text +=
+          is_interesting ? R"(,"roi":true})" : R"(,"roi":false})";
 
       // Determine Color
       cv::Scalar color;
-      if (!ctx.yolo.is_detection_interesting[idx])
+      if (!is_interesting)
         color = cv::Scalar(127, 127, 127);
       else {
         while (m_colors.size() <= class_id) {
@@ -88,8 +96,9 @@ SynchronousProcessingResult YoloOverlay::process(cv::cuda::GpuMat &frame,
 
       // Draw Label Background
       int baseLine;
-      cv::Size labelSize = cv::getTextSize(label_text, cv::FONT_HERSHEY_SIMPLEX,
-                                           m_label_font_scale, 1, &baseLine);
+      cv::Size labelSize =
+          cv::getTextSize(m_label_text, cv::FONT_HERSHEY_SIMPLEX,
+                          m_label_font_scale, 1, &baseLine);
       int top = std::max(drawn_box.y, labelSize.height);
 
       cv::rectangle(m_h_overlay_canvas,
@@ -98,10 +107,9 @@ SynchronousProcessingResult YoloOverlay::process(cv::cuda::GpuMat &frame,
                     color, cv::FILLED);
 
       // Draw Label Text
-      cv::putText(m_h_overlay_canvas, label_text, cv::Point(drawn_box.x, top),
-                  cv::FONT_HERSHEY_SIMPLEX, m_label_font_scale,
-                  cv::Scalar(255, 255, 255), 1);
-      detection_jsons.emplace_back(detection_json);
+      cv::putText(m_h_overlay_canvas, m_label_text,
+                  cv::Point(drawn_box.x, top), cv::FONT_HERSHEY_SIMPLEX,
+                  m_label_font_scale, cv::Scalar(255, 255, 255), 1);
     }
 
     // ---------------------------------------------------------
@@ -120,12 +128,14 @@ SynchronousProcessingResult YoloOverlay::process(cv::cuda::GpuMat &frame,
                         cv::THRESH_BINARY);
     m_d_overlay_canvas.copyTo(frame, d_overlay_mask);
 
-    ctx.text_to_overlay += fmt::format(
-        "Yolo: {}\n", Utils::hybrid_njson_array_dump(detection_jsons));
+    Utils::end_json_array_lines(detections_text, detections.size());
+    fmt::format_to(std::back_inserter(ctx.text_to_overlay), "Yolo: {}\n",
+                   std::string_view(detections_text));
     return success_and_continue;
 
   } catch (const cv::Exception &e) {
-    ctx.text_to_overlay += fmt::format("Yolo: {}\n", e.what());
+    fmt::format_to(std::back_inserter(ctx.text_to_overlay), "Yolo: {}\n",
+                   e.what());
     SPDLOG_ERROR("YoloOverlay OpenCV Error: {}", e.what());
     return failure_and_continue;
   }
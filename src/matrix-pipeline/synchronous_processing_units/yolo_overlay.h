@@ -18,6 +18,8 @@ public:
   SynchronousProcessingResult process(cv::cuda::GpuMat &frame,
                                       PipelineContext &ctx) override;
 
+  [[nodiscard]] bool writes_frame_in_place() const override { return true; }
+
 private:
   // --- State ---;
   float m_label_font_scale{0.5};
@@ -57,6 +59,7 @@ private:
   cv::cuda::GpuMat m_d_overlay_canvas; // Device (GPU) Canvas
   cv::cuda::GpuMat m_d_overlay_gray;   // Intermediate Gray for masking
   cv::cuda::GpuMat d_overlay_mask;     // Final Mask
+  std::string m_label_text;            // Label being drawn
   std::optional<BoundingBoxScaleParams> m_scaling_params{std::nullopt};
 };
 
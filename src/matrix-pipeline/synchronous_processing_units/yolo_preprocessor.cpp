@@ -0,0 +1,94 @@
+#include "yolo_preprocessor.h"
+
+#include <opencv2/core/cuda_stream_accessor.hpp>
+#include <opencv2/cudaarithm.hpp>
+#include <opencv2/cudaimgproc.hpp>
+#include <opencv2/cudawarping.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace MatrixPipeline::ProcessingUnit {
+
+namespace {
+LetterboxProps letterbox_resize(
+    const cv::cuda::GpuMat &src, cv::cuda::GpuMat &dst,
+    cv::cuda::GpuMat
+        &intermediate_buffer, // Optimized: Pass pre-allocated buffer
+    const cv::Size &target_size, cv::cuda::Stream &stream) {
+  // A. Calculate Scaling Ratio (Model / Input)
+  const float scale_x =
+      static_cast<float>(target_size.width) / static_cast<float>(src.cols);
+  const float scale_y =
+      static_cast<float>(target_size.height) / static_cast<float>(src.rows);
+  const float scale = std::min(scale_x, scale_y);
+
+  // B. Calculate New Dimensions (Unpadded)
+  const int new_w =
+      static_cast<int>(std::round(static_cast<float>(src.cols) * scale));
+  const int new_h =
+      static_cast<int>(std::round(static_cast<float>(src.rows) * scale));
+
+  // C. Resize into the intermediate buffer (Standard Linear Resize)
+  // Note: We use the passed 'intermediate_buffer' to avoid malloc on every
+  // frame
+  cv::cuda::resize(src, intermediate_buffer, cv::Size(new_w, new_h), 0, 0,
+                   cv::INTER_LINEAR, stream);
+
+  // D. Prepare Destination (Black/Grey Padding)
+  if (dst.size() != target_size || dst.type() != src.type()) {
+    dst.create(target_size, src.type());
+  }
+  // 114 is the standard YOLO grey, 0 is black. Changing to 114 is safer for
+  // accuracy.
+  dst.setTo(cv::Scalar(114, 114, 114), stream);
+  // E. Copy Resized Image to Center of Destination
+  const int x_offset = (target_size.width - new_w) / 2;
+  const int y_offset = (target_size.height - new_h) / 2;
+
+  cv::cuda::GpuMat dst_roi = dst(cv::Rect(x_offset, y_offset, new_w, new_h));
+  intermediate_buffer.copyTo(dst_roi, stream);
+
+  // F. Return transformation properties for Post-Processing NMS
+  return LetterboxProps{scale, x_offset, y_offset};
+}
+} // namespace
+
+LetterboxProps YoloPreprocessor::run(const cv::cuda::GpuMat &src, float *dst,
+                                     cv::cuda::Stream &stream) {
+  // YOLO expects us to use "letterbox resize", not just resize()
+  const auto letterbox = letterbox_resize(src, m_resized_gpu,
+                                          m_resized_gpu_buffer, m_input_size,
+                                          stream);
+
+  // 2. Color Convert: BGR -> RGB
+  cv::cuda::cvtColor(m_resized_gpu, m_rgb, cv::COLOR_BGR2RGB, 0, stream);
+  // alpha is  1.0/255.0, while in yunet_detect.cpp it is 1.0
+  // Convert to Float32 and Normalize (0-1 range) for YOLOv11
+  // This creates the exact memory layout TensorRT expects.
+  m_rgb.convertTo(m_normalized_gpu, CV_32FC3, 1.0 / 255.0, stream);
+
+  // 4. HWC -> NCHW Conversion， We split the interleaved Mat into 3 separate
+  // planes (R, G, B)
+
+  cv::cuda::split(m_normalized_gpu, m_channels, stream);
+
+  for (int i = 0; i < 3; ++i) {
+    // We use cudaMemcpy2DAsync because GpuMat rows might be padded (step !=
+    // width)
+    cudaMemcpy2DAsync(
+        // Dest: Offset for R, G, or B plane
+        dst + i * m_input_size.area(),
+        m_input_size.width *
+            sizeof(float),  // Dest Pitch (Linear, so equal to width)
+        m_channels[i].data, // Src: Ptr to GpuMat data
+        m_channels[i].step, // Src Pitch: GpuMat step (padding)
+        m_input_size.width * sizeof(float), // Width in bytes to copy
+        m_input_size.height,                // Height (rows)
+        cudaMemcpyDeviceToDevice,
+        cv::cuda::StreamAccessor::getStream(stream));
+  }
+  return letterbox;
+}
+
+} // namespace MatrixPipeline::ProcessingUnit
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <opencv2/core/cuda.hpp>
+
+#include <vector>
+
+namespace MatrixPipeline::ProcessingUnit {
+
+// How a frame was letterboxed into the inference input, to map boxes back
+struct LetterboxProps {
+  float scale;
+  int x_offset;
+  int y_offset;
+};
+
+/**
+ * @brief Turns a BGR frame into YOLO's input tensor: letterboxed to the
+ * input size, RGB, scaled to [0, 1] and planar (NCHW). Shared by inference
+ * and INT8 calibration, s.t. the latter sees exactly what the former will.
+ * Its GpuMat buffers are reused across frames, i.e., one instance per thread
+ */
+class YoloPreprocessor {
+public:
+  explicit YoloPreprocessor(const cv::Size &input_size)
+      : m_input_size(input_size) {}
+
+  /**
+   * @param dst device memory of 3 * input_size.area() floats
+   */
+  LetterboxProps run(const cv::cuda::GpuMat &src, float *dst,
+                     cv::cuda::Stream &stream);
+
+private:
+  cv::Size m_input_size;
+  cv::cuda::GpuMat m_resized_gpu, m_resized_gpu_buffer;
+  cv::cuda::GpuMat m_normalized_gpu;
+  cv::cuda::GpuMat m_rgb;
+  std::vector<cv::cuda::GpuMat> m_channels;
+};
+
+} // namespace MatrixPipeline::ProcessingUnit
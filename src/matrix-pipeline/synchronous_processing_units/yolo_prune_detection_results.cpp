@@ -82,7 +82,8 @@ YoloPruneDetectionResults::process(cv::cuda::GpuMat &frame,
                                    PipelineContext &ctx) {
   int img_w = frame.cols;
   int img_h = frame.rows;
-  if (!m_scaling_params.has_value())
+  if (!m_scaling_params.has_value() ||
+      !m_scaling_params->is_valid_for(frame, ctx))
     m_scaling_params = YoloDetect::get_bounding_box_scale(frame, ctx);
 
   if (img_w == 0 || img_h == 0)
@@ -159,21 +160,23 @@ YoloPruneDetectionResults::process(cv::cuda::GpuMat &frame,
   // ---------------------------------------------------------
   // 2. LOGIC (Filter Boxes) - Updated with Size Check
   // ---------------------------------------------------------
-  const size_t box_count = ctx.yolo.bounding_boxes.size();
-  if (ctx.yolo.is_detection_interesting.size() != box_count) {
-    ctx.yolo.is_detection_interesting = std::vector<short>(box_count);
-  }
-
-  if (box_count == 0)
+  if (ctx.yolo->detections.empty())
     return success_and_continue;
+  // The snapshot in ctx may be shared with other branches (and with
+  // YoloDetect's later frames), so the flags go into a copy
+  auto yolo = ctx.yolo.copy();
+  const auto boxes = yolo.detections.boxes();
+  const auto class_ids = yolo.detections.class_ids();
+  const auto is_interesting = yolo.detections.is_interesting();
 
   // Pre-calculate frame area for ratio checks
   double frame_area = static_cast<double>(img_w) * static_cast<double>(img_h);
 
-  for (const auto idx : ctx.yolo.indices) {
-    const cv::Rect &box = ctx.yolo.bounding_boxes[idx];
+  for (size_t i = 0; i < yolo.detections.size(); ++i) {
     auto rect = YoloDetect::get_scaled_bounding_box_coordinates(
-        box, m_scaling_params.value());
+        boxes[i], m_scaling_params.value());
+    // In the same (frame) coordinates as frame_area, before clipping
+    const auto box_area = static_cast<double>(rect.area());
     // clip the bounding box so that it stays strictly within the image
     // boundaries.
     rect &= cv::Rect(0, 0, frame.cols, frame.rows);
@@ -198,7 +201,6 @@ YoloPruneDetectionResults::process(cv::cuda::GpuMat &frame,
     // --- B. Size Logic ---
     bool valid_size = true;
     if (m_size_limit_mode != SizeMode::NONE) {
-      const auto box_area = static_cast<double>(box.width * box.height);
       const auto ratio = box_area / frame_area;
 
       if (m_size_limit_mode == SizeMode::MIN_RATIO) {
@@ -211,11 +213,11 @@ YoloPruneDetectionResults::process(cv::cuda::GpuMat &frame,
     }
 
     // Combine all checks
-    ctx.yolo.is_detection_interesting[idx] =
+    is_interesting[i] =
         valid_left && valid_right && valid_top && valid_bottom && valid_size &&
-        m_class_ids_of_interest.contains(
-            static_cast<int>(ctx.yolo.class_ids[idx]));
+        m_class_ids_of_interest.contains(class_ids[i]);
   }
+  ctx.yolo = std::move(yolo);
 
   return success_and_continue;
 }
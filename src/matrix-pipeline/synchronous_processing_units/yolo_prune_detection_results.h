@@ -19,6 +19,11 @@ public:
   SynchronousProcessingResult process(cv::cuda::GpuMat &frame,
                                       PipelineContext &ctx) override;
 
+  // The debug overlay blends the corridors into the frame
+  [[nodiscard]] bool writes_frame_in_place() const override {
+    return m_debug_overlay_alpha > 0;
+  }
+
 private:
   struct Range {
     // Make the range slightly wider to handle suspected precision is
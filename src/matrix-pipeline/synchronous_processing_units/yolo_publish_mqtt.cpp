@@ -182,14 +182,16 @@ YoloPublishMqtt::process([[maybe_unused]] cv::cuda::GpuMat &frame,
 
   njson payload;
   payload["bounding_boxes"] = {};
-  for (const auto idx : ctx.yolo.indices) {
-    if (!ctx.yolo.is_detection_interesting[idx])
+  const auto &detections = ctx.yolo->detections;
+  for (size_t i = 0; i < detections.size(); ++i) {
+    if (!detections.is_interesting()[i])
       continue;
+    const auto &bounding_box = detections.boxes()[i];
     njson box;
-    box["x"] = ctx.yolo.bounding_boxes[idx].x;
-    box["y"] = ctx.yolo.bounding_boxes[idx].y;
-    box["w"] = ctx.yolo.bounding_boxes[idx].width;
-    box["h"] = ctx.yolo.bounding_boxes[idx].height;
+    box["x"] = bounding_box.x;
+    box["y"] = bounding_box.y;
+    box["w"] = bounding_box.width;
+    box["h"] = bounding_box.height;
     payload["bounding_boxes"].push_back(box);
   }
   if (payload["bounding_boxes"].empty())
@@ -38,12 +38,13 @@ bool YuNetDetect::init(const njson &config) {
 SynchronousProcessingResult YuNetDetect::process(cv::cuda::GpuMat &frame,
                                                  PipelineContext &ctx) {
 
-  ctx.yunet_sface.results.clear();
-  ctx.yunet_sface.yunet_input_frame_size = frame.size();
+  // Built aside and published as a whole, the snapshot in ctx may be shared
+  // with other branches
+  YuNetSFaceContext yunet_sface;
+  yunet_sface.yunet_input_frame_size = frame.size();
   if (m_detector->getInputSize() != frame.size()) {
     m_detector->setInputSize(frame.size());
   }
-  ctx.yunet_sface.yunet_input_frame_size = frame.size();
   frame.download(m_pinned_buffer);
   // point the cv::Mat directly to the pinned memory
   auto frame_cpu = m_pinned_buffer.createMatHeader();
@@ -79,9 +80,10 @@ SynchronousProcessingResult YuNetDetect::process(cv::cuda::GpuMat &frame,
       YuNetSFaceResult res;
       res.detection = std::move(detection);
       // res.recognition = std::nullopt;
-      ctx.yunet_sface.results.push_back(std::move(res));
+      yunet_sface.results.push_back(std::move(res));
     }
   }
+  ctx.yunet_sface = std::move(yunet_sface);
 
   return success_and_continue;
 }
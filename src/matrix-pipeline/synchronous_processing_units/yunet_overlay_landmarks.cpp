@@ -1,4 +1,7 @@
 #include "yunet_overlay_landmarks.h"
+#include "../utils/frame_cow.h"
+#include "../utils/frame_pool.h"
+
 #include <opencv2/imgproc.hpp>
 
 namespace MatrixPipeline::ProcessingUnit {
@@ -28,17 +31,18 @@ bool YuNetOverlayLandmarks::init(const njson &config) {
 SynchronousProcessingResult
 YuNetOverlayLandmarks::process(cv::cuda::GpuMat &frame, PipelineContext &ctx) {
   // 1. Check if YuNet data exists in context
-  if (ctx.yunet_sface.results.empty()) {
+  if (ctx.yunet_sface->results.empty()) {
     return failure_and_continue;
   }
 
   // 2. OpenCV drawing functions require CPU Mat.
   // We download the frame to CPU to draw the overlays.
-  cv::Mat cpu_frame;
+  cv::Mat cpu_frame = Utils::PinnedHostPool::instance().acquire(
+      frame.size(), frame.type());
   frame.download(cpu_frame);
 
   // 3. Iterate through detected faces and draw landmarks
-  for (const auto &result : ctx.yunet_sface.results) {
+  for (const auto &result : ctx.yunet_sface->results) {
     for (const auto &landmark : result.detection.landmarks) {
       // Draw a circle for each of the 5 points (eyes, nose, mouth corners)
       cv::circle(cpu_frame, landmark, m_radius, m_landmark_color_bgr,
@@ -47,6 +51,10 @@ YuNetOverlayLandmarks::process(cv::cuda::GpuMat &frame, PipelineContext &ctx) {
   }
 
   // 4. Upload the modified frame back to GPU
+  // Re-upload into a fresh buffer if frame is shared with other branches,
+  // copying it on the GPU first would be wasted work
+  if (Utils::is_shared(frame))
+    frame.release();
   frame.upload(cpu_frame);
 
   return success_and_continue;
@@ -1,6 +1,7 @@
 #include "cuda_helper.h"
 
 #include <boost/stacktrace.hpp>
+#include <fmt/format.h>
 #include <spdlog/spdlog.h>
 
 namespace MatrixPipeline::Utils {
@@ -18,4 +19,14 @@ void TRTLogger::log(Severity severity, const char *msg) noexcept {
 
 TRTLogger g_logger; // The actual memory allocation happens here
 
+std::string get_trt_builder_fingerprint() {
+  int device = 0;
+  cudaDeviceProp prop{};
+  if (cudaGetDevice(&device) != cudaSuccess ||
+      cudaGetDeviceProperties(&prop, device) != cudaSuccess)
+    return fmt::format("trt={};device=unknown", getInferLibVersion());
+  return fmt::format("trt={};sm={}{};device={}", getInferLibVersion(),
+                     prop.major, prop.minor, prop.name);
+}
+
 } // namespace MatrixPipeline::Utils
\ No newline at end of file
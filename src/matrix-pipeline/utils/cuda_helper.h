@@ -3,6 +3,7 @@
 #include <NvInfer.h>
 
 #include <memory>
+#include <string>
 
 namespace MatrixPipeline::Utils {
 
@@ -10,6 +11,11 @@ struct CudaDeleter {
   void operator()(void *ptr) const { cudaFree(ptr); }
 };
 
+// For pinned host memory, i.e., from cudaHostAlloc()
+struct CudaHostDeleter {
+  void operator()(void *ptr) const { cudaFreeHost(ptr); }
+};
+
 template <typename T>
 std::unique_ptr<T, CudaDeleter> make_device_unique(const size_t count) {
   T *ptr = nullptr;
@@ -28,4 +34,11 @@ public:
 // Use 'extern' to tell other modules this exists elsewhere
 extern TRTLogger g_logger;
 
+/**
+ * @brief What a serialized TensorRT plan is specific to besides its model and
+ * builder flags, i.e., the TensorRT version and the current device, e.g.,
+ * "trt=100300;sm=86;device=NVIDIA GeForce RTX 3060"
+ */
+std::string get_trt_builder_fingerprint();
+
 } // namespace MatrixPipeline::Utils
\ No newline at end of file
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <utility>
+
+namespace MatrixPipeline::Utils {
+
+/**
+ * @brief A monotonic arena for the transient per-frame data of a branch's
+ * units (text being formatted, split lines, etc.): allocating is a pointer
+ * bump, nothing is freed until reset(), which makes all of it available again
+ * at once.
+ *
+ * Its buffer is kept across frames and doubled (up to max_bytes) whenever a
+ * frame didn't fit, s.t. in steady state a frame makes no heap allocations
+ * for this data at all. Not thread-safe, each branch (or stage) owns one.
+ */
+class FrameArena {
+public:
+  static constexpr size_t default_initial_bytes = 16 << 10;
+  static constexpr size_t max_bytes = 1 << 20;
+
+  /**
+   * @param heap_allocations counts allocations the buffer couldn't serve,
+   * nullable
+   */
+  explicit FrameArena(std::shared_ptr<Counter> heap_allocations = nullptr,
+                      const size_t initial_bytes = default_initial_bytes)
+      : m_buffer_bytes(initial_bytes),
+        m_heap_allocations(std::move(heap_allocations)) {
+    rebuild();
+  }
+  FrameArena(const FrameArena &) = delete;
+  FrameArena &operator=(const FrameArena &) = delete;
+
+  [[nodiscard]] std::pmr::memory_resource *resource() { return &*m_resource; }
+
+  /**
+   * @brief Releases everything allocated since the last reset(), i.e., when
+   * the frame retires. Nothing allocated from the arena may be used
+   * afterwards
+   */
+  void reset() {
+    m_resource->release();
+    const auto overflows = m_upstream.take_allocation_count();
+    if (overflows == 0)
+      return;
+    if (m_heap_allocations != nullptr)
+      m_heap_allocations->inc(overflows);
+    if (m_buffer_bytes < max_bytes) {
+      m_buffer_bytes = std::min(m_buffer_bytes * 2, max_bytes);
+      rebuild();
+    }
+  }
+
+private:
+  // Counts what spills over the buffer to the heap
+  class CountingResource final : public std::pmr::memory_resource {
+  public:
+    size_t take_allocation_count() { return std::exchange(m_count, 0); }
+
+  private:
+    void *do_allocate(const size_t bytes, const size_t alignment) override {
+      ++m_count;
+      return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+    void do_deallocate(void *p, const size_t bytes,
+                       const size_t alignment) override {
+      std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+    [[nodiscard]] bool do_is_equal(
+        const std::pmr::memory_resource &other) const noexcept override {
+      return this == &other;
+    }
+    size_t m_count = 0;
+  };
+
+  void rebuild() {
+    m_resource.reset();
+    m_buffer = std::make_unique_for_overwrite<std::byte[]>(m_buffer_bytes);
+    m_resource.emplace(m_buffer.get(), m_buffer_bytes, &m_upstream);
+  }
+
+  size_t m_buffer_bytes;
+  std::unique_ptr<std::byte[]> m_buffer;
+  CountingResource m_upstream;
+  std::optional<std::pmr::monotonic_buffer_resource> m_resource;
+  std::shared_ptr<Counter> m_heap_allocations;
+};
+
+} // namespace MatrixPipeline::Utils
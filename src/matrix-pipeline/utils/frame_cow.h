@@ -0,0 +1,45 @@
+#pragma once
+
+#include <opencv2/core/cuda.hpp>
+
+#include <atomic>
+
+namespace MatrixPipeline::Utils {
+
+/**
+ * @brief Copy-on-write helpers for frames shared by reference.
+ *
+ * A cv::cuda::GpuMat is already an immutable-by-convention, reference-counted
+ * handle: copying it (or taking an ROI of it) only bumps a refcount on the
+ * underlying device buffer. The pipeline hands the same buffer to all
+ * asynchronous branches and relies on the following rule instead of deep
+ * copies: a frame may only be written in place after make_writable() has been
+ * called on it.
+ */
+
+/**
+ * @brief Whether any other GpuMat (including ROIs) references frame's buffer.
+ * Frames wrapping user-allocated memory carry no refcount, we can't tell who
+ * else is using them, so they are conservatively reported as shared.
+ */
+inline bool is_shared(const cv::cuda::GpuMat &frame) {
+  if (frame.empty())
+    return false;
+  if (frame.refcount == nullptr)
+    return true;
+  return std::atomic_ref(*frame.refcount).load(std::memory_order_acquire) > 1;
+}
+
+/**
+ * @brief Ensures frame exclusively owns its buffer, deep-copying it if (and
+ * only if) it is shared.
+ * @return true if a copy was made
+ */
+inline bool make_writable(cv::cuda::GpuMat &frame) {
+  if (!is_shared(frame))
+    return false;
+  frame = frame.clone();
+  return true;
+}
+
+} // namespace MatrixPipeline::Utils
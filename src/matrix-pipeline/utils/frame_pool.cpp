@@ -0,0 +1,288 @@
+#include "frame_pool.h"
+
+#include <cuda_runtime.h>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+namespace MatrixPipeline::Utils {
+
+FrameBufferCache::FrameBufferCache(const std::string &name,
+                                   RawAllocate raw_allocate, RawFree raw_free)
+    : m_raw_allocate(std::move(raw_allocate)),
+      m_raw_free(std::move(raw_free)) {
+  auto &registry = MetricsRegistry::instance();
+  const MetricLabels labels{{"pool", name}};
+  m_metrics.requests =
+      registry.counter("matrix_pipeline_frame_pool_requests_total",
+                       "Buffer requests served by the pool or refused",
+                       labels);
+  m_metrics.hits =
+      registry.counter("matrix_pipeline_frame_pool_hits_total",
+                       "Requests served from the pool's cached buffers",
+                       labels);
+  m_metrics.misses = registry.counter(
+      "matrix_pipeline_frame_pool_misses_total",
+      "Requests that needed a raw allocation, e.g., cudaMalloc()", labels);
+  m_metrics.bypasses = registry.counter(
+      "matrix_pipeline_frame_pool_bypasses_total",
+      "Requests refused due to the budget or a failed raw allocation", labels);
+  m_metrics.bytes_in_use =
+      registry.gauge("matrix_pipeline_frame_pool_in_use_bytes",
+                     "Bytes of the pool's buffers handed out", labels);
+  m_metrics.bytes_cached =
+      registry.gauge("matrix_pipeline_frame_pool_cached_bytes",
+                     "Bytes of the pool's buffers kept for reuse", labels);
+  m_metrics.high_watermark_bytes =
+      registry.gauge("matrix_pipeline_frame_pool_high_watermark_bytes",
+                     "Peak of the pool's in-use bytes", labels);
+}
+
+FrameBufferCache::~FrameBufferCache() {
+  // Buffers still in use are left alone, their owners free them the usual way
+  std::lock_guard lock(m_mutex);
+  for (auto &[key, blocks] : m_free_blocks) {
+    for (const auto &block : blocks)
+      m_raw_free(block.ptr);
+  }
+}
+
+void FrameBufferCache::set_budget(const size_t budget_bytes) {
+  std::lock_guard lock(m_mutex);
+  m_budget_bytes = budget_bytes;
+  evict_until_fits(0);
+  publish_byte_counts();
+}
+
+void FrameBufferCache::publish_byte_counts() {
+  m_metrics.bytes_in_use->set(m_stats.bytes_in_use);
+  m_metrics.bytes_cached->set(m_stats.bytes_cached);
+  m_metrics.high_watermark_bytes->set(m_stats.high_watermark_bytes);
+}
+
+void FrameBufferCache::evict_until_fits(const size_t bytes) {
+  for (auto it = m_free_blocks.begin(); it != m_free_blocks.end();) {
+    auto &blocks = it->second;
+    while (!blocks.empty() &&
+           m_stats.bytes_in_use + m_stats.bytes_cached + bytes >
+               m_budget_bytes) {
+      m_raw_free(blocks.back().ptr);
+      m_stats.bytes_cached -= blocks.back().bytes;
+      blocks.pop_back();
+    }
+    it = blocks.empty() ? m_free_blocks.erase(it) : std::next(it);
+  }
+}
+
+bool FrameBufferCache::acquire(const Key &key, Block &block) {
+  std::lock_guard lock(m_mutex);
+  ++m_stats.requests;
+  m_metrics.requests->inc();
+  Block acquired;
+  if (const auto it = m_free_blocks.find(key);
+      it != m_free_blocks.end() && !it->second.empty()) {
+    acquired = it->second.back();
+    it->second.pop_back();
+    m_stats.bytes_cached -= acquired.bytes;
+    ++m_stats.hits;
+    m_metrics.hits->inc();
+  } else {
+    const auto [rows, cols, elem_size] = key;
+    // Pitched allocations may be slightly larger, close enough for budgeting
+    const auto estimated_bytes = static_cast<size_t>(rows) * cols * elem_size;
+    evict_until_fits(estimated_bytes);
+    if (m_stats.bytes_in_use + m_stats.bytes_cached + estimated_bytes >
+            m_budget_bytes ||
+        !m_raw_allocate(key, acquired)) {
+      ++m_stats.bypasses;
+      m_metrics.bypasses->inc();
+      publish_byte_counts();
+      return false;
+    }
+    ++m_stats.misses;
+    m_metrics.misses->inc();
+  }
+  m_stats.bytes_in_use += acquired.bytes;
+  m_stats.high_watermark_bytes =
+      std::max(m_stats.high_watermark_bytes, m_stats.bytes_in_use);
+  m_blocks_in_use.emplace(acquired.ptr, std::make_pair(key, acquired));
+  publish_byte_counts();
+  block = acquired;
+  return true;
+}
+
+bool FrameBufferCache::release(void *ptr) {
+  std::lock_guard lock(m_mutex);
+  const auto it = m_blocks_in_use.find(ptr);
+  if (it == m_blocks_in_use.end())
+    return false;
+  const auto &[key, block] = it->second;
+  m_stats.bytes_in_use -= block.bytes;
+  m_stats.bytes_cached += block.bytes;
+  m_free_blocks[key].push_back(block);
+  m_blocks_in_use.erase(it);
+  // The budget may have been lowered in the meantime
+  evict_until_fits(0);
+  publish_byte_counts();
+  return true;
+}
+
+FrameBufferCache::Stats FrameBufferCache::get_stats() const {
+  std::lock_guard lock(m_mutex);
+  return m_stats;
+}
+
+namespace {
+
+// Same layout as OpenCV's default allocator
+bool allocate_device_block(const FrameBufferCache::Key &key,
+                           FrameBufferCache::Block &block) {
+  const auto [rows, cols, elem_size] = key;
+  cudaError_t err;
+  if (rows > 1 && cols > 1) {
+    err = cudaMallocPitch(&block.ptr, &block.step, elem_size * cols, rows);
+  } else {
+    block.step = elem_size * cols;
+    err = cudaMalloc(&block.ptr, block.step * rows);
+  }
+  if (err != cudaSuccess) {
+    SPDLOG_WARN("Failed to allocate {}x{}x{} bytes of device memory: {}", rows,
+                cols, elem_size, cudaGetErrorString(err));
+    return false;
+  }
+  block.bytes = block.step * rows;
+  return true;
+}
+
+} // namespace
+
+DeviceFramePool &DeviceFramePool::instance() {
+  static auto *pool = new DeviceFramePool();
+  return *pool;
+}
+
+DeviceFramePool::DeviceFramePool()
+    : m_cache("device", allocate_device_block,
+              [](void *ptr) { cudaFree(ptr); }) {}
+
+bool DeviceFramePool::allocate(cv::cuda::GpuMat *mat, const int rows,
+                               const int cols, const size_t elemSize) {
+  FrameBufferCache::Block block;
+  // Beyond the budget: a buffer the cache doesn't own, see free()
+  if (!m_cache.acquire({rows, cols, elemSize}, block) &&
+      !allocate_device_block({rows, cols, elemSize}, block))
+    return false;
+  mat->data = static_cast<uchar *>(block.ptr);
+  mat->step = block.step;
+  mat->refcount = static_cast<int *>(cv::fastMalloc(sizeof(int)));
+  return true;
+}
+
+void DeviceFramePool::free(cv::cuda::GpuMat *mat) {
+  // datastart instead of data: the last reference may well be an ROI
+  if (!m_cache.release(mat->datastart))
+    cudaFree(mat->datastart);
+  cv::fastFree(mat->refcount);
+}
+
+PinnedHostPool &PinnedHostPool::instance() {
+  static auto *pool = new PinnedHostPool();
+  return *pool;
+}
+
+PinnedHostPool::PinnedHostPool()
+    : m_cache(
+          "pinned_host",
+          [](const FrameBufferCache::Key &key, FrameBufferCache::Block &block) {
+            const auto [rows, cols, elem_size] = key;
+            block.step = elem_size * cols;
+            block.bytes = block.step * rows;
+            if (const auto err = cudaHostAlloc(&block.ptr, block.bytes,
+                                               cudaHostAllocDefault);
+                err != cudaSuccess) {
+              SPDLOG_WARN("Failed to allocate {} bytes of pinned host memory: "
+                          "{}",
+                          block.bytes, cudaGetErrorString(err));
+              return false;
+            }
+            return true;
+          },
+          [](void *ptr) { cudaFreeHost(ptr); }) {}
+
+cv::Mat PinnedHostPool::acquire(const cv::Size size, const int type) {
+  cv::Mat mat;
+  mat.allocator = this;
+  mat.create(size, type);
+  return mat;
+}
+
+cv::UMatData *PinnedHostPool::allocate(const int dims, const int *sizes,
+                                       const int type, void *data,
+                                       size_t *step,
+                                       [[maybe_unused]] cv::AccessFlag flags,
+                                       [[maybe_unused]] cv::UMatUsageFlags
+                                           usageFlags) const {
+  // Mirrors cv::StdMatAllocator, except where the memory comes from
+  const size_t elem_size = CV_ELEM_SIZE(type);
+  size_t total = elem_size;
+  for (int i = dims - 1; i >= 0; --i) {
+    if (step != nullptr) {
+      if (data != nullptr && step[i] != CV_AUTOSTEP)
+        total = step[i];
+      else
+        step[i] = total;
+    }
+    total *= sizes[i];
+  }
+  auto *u = new cv::UMatData(this);
+  if (data != nullptr) {
+    u->flags |= cv::UMatData::USER_ALLOCATED;
+  } else {
+    using Key = FrameBufferCache::Key;
+    const auto key =
+        dims == 2 ? Key{sizes[0], sizes[1], elem_size}
+                  : Key{1, static_cast<int>(total / elem_size), elem_size};
+    if (FrameBufferCache::Block block; m_cache.acquire(key, block))
+      data = block.ptr;
+    else
+      data = cv::fastMalloc(total);
+  }
+  u->data = u->origdata = static_cast<uchar *>(data);
+  u->size = total;
+  return u;
+}
+
+bool PinnedHostPool::allocate(cv::UMatData *data,
+                              [[maybe_unused]] cv::AccessFlag accessflags,
+                              [[maybe_unused]] cv::UMatUsageFlags usageFlags)
+    const {
+  return data != nullptr;
+}
+
+void PinnedHostPool::deallocate(cv::UMatData *data) const {
+  if (data == nullptr)
+    return;
+  if (!(data->flags & cv::UMatData::USER_ALLOCATED) &&
+      !m_cache.release(data->origdata))
+    cv::fastFree(data->origdata);
+  delete data;
+}
+
+std::string get_frame_pool_stats_summary() {
+  constexpr double mb = 1024.0 * 1024.0;
+  const auto format = [&](const FrameBufferCache::Stats &stats) {
+    return fmt::format("{:.1f}%/{:.0f}/{:.0f}/{:.0f}/{}/{}",
+                       stats.hit_rate() * 100, stats.bytes_in_use / mb,
+                       stats.bytes_cached / mb,
+                       stats.high_watermark_bytes / mb, stats.misses,
+                       stats.bypasses);
+  };
+  return fmt::format(
+      "frame_pool(hit_rate/in_use_mb/cached_mb/peak_mb/mallocs/bypasses): "
+      "device: {}, pinned_host: {}",
+      format(DeviceFramePool::instance().get_stats()),
+      format(PinnedHostPool::instance().get_stats()));
+}
+
+} // namespace MatrixPipeline::Utils
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "metrics.h"
+
+#include <opencv2/core/cuda.hpp>
+#include <opencv2/core/mat.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace MatrixPipeline::Utils {
+
+/**
+ * @brief The size- and type-bucketed bookkeeping shared by the device and the
+ * pinned host pools.
+ *
+ * Released buffers are kept in per-{rows, cols, elemSize} free lists and
+ * handed out again to the next request of the very same shape, so once every
+ * shape the pipeline uses has been seen, no more raw allocations happen.
+ * The memory held by the cache (in use + cached) never exceeds the budget:
+ * cached buffers of other shapes are evicted first, and if that's not enough
+ * the request is refused s.t. the caller falls back to a plain allocation.
+ */
+class FrameBufferCache {
+public:
+  // {rows, cols, elemSize}
+  using Key = std::tuple<int, int, size_t>;
+  struct Block {
+    void *ptr = nullptr;
+    size_t step = 0;
+    size_t bytes = 0;
+  };
+  using RawAllocate = std::function<bool(const Key &key, Block &block)>;
+  using RawFree = std::function<void(void *ptr)>;
+
+  struct Stats {
+    uint64_t requests = 0;
+    uint64_t hits = 0;
+    // Raw allocations, i.e., cudaMalloc()/cudaHostAlloc() calls
+    uint64_t misses = 0;
+    // Requests refused due to the budget (or a failed raw allocation)
+    uint64_t bypasses = 0;
+    size_t bytes_in_use = 0;
+    size_t bytes_cached = 0;
+    size_t high_watermark_bytes = 0;
+    [[nodiscard]] double hit_rate() const {
+      return requests > 0 ? static_cast<double>(hits) / requests : 0.0;
+    }
+  };
+
+  // name labels the cache's metrics, e.g., "device"
+  FrameBufferCache(const std::string &name, RawAllocate raw_allocate,
+                   RawFree raw_free);
+  ~FrameBufferCache();
+
+  void set_budget(size_t budget_bytes);
+  /**
+   * @return false if the request can't be served within the budget, block is
+   * left untouched in this case
+   */
+  bool acquire(const Key &key, Block &block);
+  /**
+   * @return false if ptr was not handed out by this cache
+   */
+  bool release(void *ptr);
+  [[nodiscard]] Stats get_stats() const;
+
+private:
+  RawAllocate m_raw_allocate;
+  RawFree m_raw_free;
+  size_t m_budget_bytes = 0;
+  mutable std::mutex m_mutex;
+  std::map<Key, std::vector<Block>> m_free_blocks;
+  // ptr -> {key, block} of all buffers currently handed out
+  std::unordered_map<void *, std::pair<Key, Block>> m_blocks_in_use;
+  Stats m_stats;
+  // m_stats mirrored for /metrics, s.t. scrapes don't take m_mutex
+  struct Metrics {
+    std::shared_ptr<Counter> requests;
+    std::shared_ptr<Counter> hits;
+    std::shared_ptr<Counter> misses;
+    std::shared_ptr<Counter> bypasses;
+    std::shared_ptr<Gauge> bytes_in_use;
+    std::shared_ptr<Gauge> bytes_cached;
+    std::shared_ptr<Gauge> high_watermark_bytes;
+  } m_metrics;
+
+  void evict_until_fits(size_t bytes);
+  // Must be called with m_mutex held
+  void publish_byte_counts();
+};
+
+/**
+ * @brief A cv::cuda::GpuMat allocator recycling device buffers, meant to be
+ * installed process-wide with cv::cuda::GpuMat::setDefaultAllocator() s.t.
+ * all the per-frame GpuMats (decoded frames, resized/rotated copies, history
+ * buffers, etc.) are served from the pool without any code change.
+ *
+ * Requests beyond the budget get a plain cudaMallocPitch()/cudaMalloc()
+ * buffer instead, which free() releases directly. OpenCV's own fallback can't
+ * be relied on: once installed, its defaultAllocator() is this pool.
+ */
+class DeviceFramePool final : public cv::cuda::GpuMat::Allocator {
+public:
+  // Intentionally leaked: GpuMats living in static storage may be released
+  // after static destruction has begun
+  static DeviceFramePool &instance();
+
+  bool allocate(cv::cuda::GpuMat *mat, int rows, int cols,
+                size_t elemSize) override;
+  void free(cv::cuda::GpuMat *mat) override;
+
+  void set_budget(const size_t budget_bytes) {
+    m_cache.set_budget(budget_bytes);
+  }
+  [[nodiscard]] FrameBufferCache::Stats get_stats() const {
+    return m_cache.get_stats();
+  }
+
+private:
+  DeviceFramePool();
+  FrameBufferCache m_cache;
+};
+
+/**
+ * @brief A cv::Mat allocator recycling page-locked host buffers, s.t. GPU
+ * downloads/uploads are fast and don't pay for cudaHostAlloc() every frame.
+ * Unlike DeviceFramePool it's opt-in per Mat (see acquire()), as installing
+ * it as the default cv::Mat allocator would pin all host memory OpenCV
+ * touches. Requests beyond the budget get pageable memory instead.
+ */
+class PinnedHostPool final : public cv::MatAllocator {
+public:
+  // Intentionally leaked, see DeviceFramePool::instance()
+  static PinnedHostPool &instance();
+
+  /**
+   * @brief Returns a Mat backed by the pool. The Mat keeps using the pool if
+   * it is later create()d with another size/type, e.g., by
+   * GpuMat::download().
+   */
+  cv::Mat acquire(cv::Size size, int type);
+
+  cv::UMatData *allocate(int dims, const int *sizes, int type, void *data,
+                         size_t *step, cv::AccessFlag flags,
+                         cv::UMatUsageFlags usageFlags) const override;
+  bool allocate(cv::UMatData *data, cv::AccessFlag accessflags,
+                cv::UMatUsageFlags usageFlags) const override;
+  void deallocate(cv::UMatData *data) const override;
+
+  void set_budget(const size_t budget_bytes) {
+    m_cache.set_budget(budget_bytes);
+  }
+  [[nodiscard]] FrameBufferCache::Stats get_stats() const {
+    return m_cache.get_stats();
+  }
+
+private:
+  PinnedHostPool();
+  // cv::MatAllocator's interface is const
+  mutable FrameBufferCache m_cache;
+};
+
+/**
+ * @brief One line of hit rate, bytes in use/cached, high watermark, raw
+ * allocations and bypasses of both pools, for periodic logging
+ */
+std::string get_frame_pool_stats_summary();
+
+} // namespace MatrixPipeline::Utils
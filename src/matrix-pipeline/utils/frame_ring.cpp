@@ -0,0 +1,103 @@
+#include "frame_ring.h"
+#include "frame_cow.h"
+
+#include <spdlog/spdlog.h>
+
+namespace MatrixPipeline::Utils {
+
+void StageLatencyStats::record(
+    const std::chrono::steady_clock::duration elapsed) {
+  const auto us = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+  m_count.fetch_add(1, std::memory_order_relaxed);
+  m_total_us.fetch_add(us, std::memory_order_relaxed);
+  auto prev_max = m_max_us.load(std::memory_order_relaxed);
+  while (us > prev_max &&
+         !m_max_us.compare_exchange_weak(prev_max, us,
+                                         std::memory_order_relaxed)) {
+  }
+}
+
+StageLatencyStats::Snapshot StageLatencyStats::take_snapshot() {
+  Snapshot snapshot;
+  snapshot.count = m_count.exchange(0, std::memory_order_relaxed);
+  const auto total_us = m_total_us.exchange(0, std::memory_order_relaxed);
+  snapshot.max_us = m_max_us.exchange(0, std::memory_order_relaxed);
+  if (snapshot.count > 0)
+    snapshot.avg_us = static_cast<double>(total_us) / snapshot.count;
+  return snapshot;
+}
+
+FrameRing::FrameRing(const size_t capacity, const cv::Size &frame_size,
+                     const int frame_type)
+    : m_slots(capacity),
+      // Bounds the memory a pipeline which never lets go of its frames could
+      // pin, beyond it buffers are allocated per frame again
+      m_max_spare_frames(capacity * 4), m_frame_size(frame_size),
+      m_frame_type(frame_type), m_free_slots(capacity),
+      m_published_slots(capacity) {
+  for (size_t i = 0; i < m_slots.size(); ++i) {
+    m_slots[i].idx = i;
+    m_slots[i].frame.create(frame_size, frame_type);
+    m_free_slots.try_enqueue(i);
+  }
+  SPDLOG_INFO("FrameRing initialized, capacity: {}, frame_size: {}x{}",
+              capacity, frame_size.width, frame_size.height);
+}
+
+FrameRing::Slot *FrameRing::try_acquire() {
+  size_t idx;
+  if (!m_free_slots.try_dequeue(idx)) {
+    m_overrun_count.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  return prepare(idx);
+}
+
+FrameRing::Slot *
+FrameRing::wait_for_free(const std::chrono::microseconds timeout) {
+  size_t idx;
+  if (!m_free_slots.wait_dequeue_timed(idx, timeout))
+    return nullptr;
+  return prepare(idx);
+}
+
+FrameRing::Slot *FrameRing::prepare(const size_t idx) {
+  auto &frame = m_slots[idx].frame;
+  if (!is_shared(frame))
+    return &m_slots[idx];
+  for (auto &spare : m_spare_frames) {
+    if (!is_shared(spare)) {
+      frame.swap(spare);
+      return &m_slots[idx];
+    }
+  }
+  // Every buffer is still in flight, the pipeline's one becomes a spare
+  if (m_spare_frames.size() < m_max_spare_frames) {
+    m_spare_frames.push_back(frame);
+    SPDLOG_DEBUG("FrameRing spare buffers grown to {}", m_spare_frames.size());
+  }
+  frame = cv::cuda::GpuMat(m_frame_size, m_frame_type);
+  return &m_slots[idx];
+}
+
+void FrameRing::publish(Slot *slot) {
+  m_occupancy.fetch_add(1, std::memory_order_relaxed);
+  // Can't fail: there are never more indices in flight than capacity
+  m_published_slots.try_enqueue(slot->idx);
+}
+
+FrameRing::Slot *
+FrameRing::wait_for_published(const std::chrono::microseconds timeout) {
+  size_t idx;
+  if (!m_published_slots.wait_dequeue_timed(idx, timeout))
+    return nullptr;
+  return &m_slots[idx];
+}
+
+void FrameRing::release(Slot *slot) {
+  m_occupancy.fetch_sub(1, std::memory_order_relaxed);
+  m_free_slots.try_enqueue(slot->idx);
+}
+
+} // namespace MatrixPipeline::Utils
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "../entities/processing_context.h"
+
+#include <opencv2/core/cuda.hpp>
+#include <readerwriterqueue/readerwritercircularbuffer.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace MatrixPipeline::Utils {
+
+/**
+ * @brief Lock-free count/avg/max accumulator of a pipeline stage's duration,
+ * written by one thread and periodically drained by another one for logging.
+ */
+class StageLatencyStats {
+public:
+  struct Snapshot {
+    uint64_t count = 0;
+    double avg_us = 0;
+    uint64_t max_us = 0;
+  };
+
+  void record(std::chrono::steady_clock::duration elapsed);
+  // Returns the stats accumulated since the last call and resets them
+  Snapshot take_snapshot();
+
+private:
+  std::atomic<uint64_t> m_count{0};
+  std::atomic<uint64_t> m_total_us{0};
+  std::atomic<uint64_t> m_max_us{0};
+};
+
+/**
+ * @brief A fixed-capacity single-producer/single-consumer ring of frame slots
+ * sitting between the capture (decoding) thread and the dispatching thread.
+ *
+ * All slots are allocated upfront: the producer decodes directly into a free
+ * slot and publishes it, the consumer hands the slot to the pipeline and
+ * releases it back. As the pipeline shares frames by reference, a slot's
+ * buffer is only decoded into again once the pipeline is done with it (see
+ * Utils::is_shared()), otherwise it is swapped for a spare buffer the
+ * pipeline has let go of. Spares are allocated as needed only, i.e., until
+ * there are enough of them to cover the frames the pipeline holds on to.
+ * Slot ownership is passed around by index via two lock-free SPSC queues
+ * (free: consumer -> producer, ready: producer -> consumer).
+ */
+class FrameRing {
+public:
+  struct Slot {
+    cv::cuda::GpuMat frame;
+    ProcessingUnit::PipelineContext ctx;
+    size_t idx = 0;
+  };
+
+  FrameRing(size_t capacity, const cv::Size &frame_size, int frame_type);
+
+  // --- Producer side ---
+  /**
+   * @brief Returns a free slot, whose buffer can be decoded into, or nullptr
+   * if all slots are in use (i.e., the consumer is lagging behind). A nullptr
+   * increments the overrun counter, the caller is expected to drop the frame.
+   */
+  Slot *try_acquire();
+  /**
+   * @brief Blocks up to timeout for a free slot, nullptr on timeout. Used by
+   * lossless producers, which prefer to wait rather than to drop frames.
+   */
+  Slot *wait_for_free(std::chrono::microseconds timeout);
+  void publish(Slot *slot);
+
+  // --- Consumer side ---
+  /**
+   * @brief Blocks up to timeout for a published slot, nullptr on timeout.
+   */
+  Slot *wait_for_published(std::chrono::microseconds timeout);
+  void release(Slot *slot);
+
+  [[nodiscard]] size_t capacity() const { return m_slots.size(); }
+  // Number of slots published but not yet released by the consumer
+  [[nodiscard]] size_t occupancy() const {
+    return m_occupancy.load(std::memory_order_relaxed);
+  }
+  [[nodiscard]] uint64_t overrun_count() const {
+    return m_overrun_count.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::vector<Slot> m_slots;
+  // Producer side only, see prepare()
+  std::vector<cv::cuda::GpuMat> m_spare_frames;
+  size_t m_max_spare_frames;
+  cv::Size m_frame_size;
+  int m_frame_type;
+  moodycamel::BlockingReaderWriterCircularBuffer<size_t> m_free_slots;
+  moodycamel::BlockingReaderWriterCircularBuffer<size_t> m_published_slots;
+  std::atomic<size_t> m_occupancy{0};
+  std::atomic<uint64_t> m_overrun_count{0};
+
+  // Ensures the slot's buffer isn't referenced by the pipeline anymore
+  Slot *prepare(size_t idx);
+};
+
+} // namespace MatrixPipeline::Utils
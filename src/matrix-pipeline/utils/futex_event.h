@@ -0,0 +1,67 @@
+#pragma once
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+
+namespace MatrixPipeline::Utils {
+
+/**
+ * @brief A 32-bit word producers and consumers can sleep on, backed by a raw
+ * futex s.t. waits can time out (std::atomic::wait() can't).
+ *
+ * Wakers only pay for the syscall (and for touching the epoch) when someone is
+ * actually waiting.
+ */
+class FutexEvent {
+public:
+  /**
+   * @brief Returns the current epoch, to be passed to wait_for() after the
+   * caller has re-checked its condition. Any notify() in between makes
+   * wait_for() return immediately, i.e., wake-ups are never lost.
+   */
+  [[nodiscard]] uint32_t prepare_wait() {
+    m_waiters.fetch_add(1, std::memory_order_seq_cst);
+    return m_epoch.load(std::memory_order_seq_cst);
+  }
+
+  void wait_for(const uint32_t epoch, const std::chrono::nanoseconds timeout) {
+    const auto secs = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+    const timespec ts{.tv_sec = static_cast<time_t>(secs.count()),
+                      .tv_nsec = static_cast<long>((timeout - secs).count())};
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&m_epoch),
+            FUTEX_WAIT_PRIVATE, epoch, &ts, nullptr, 0);
+    m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+  }
+
+  // For a caller that re-checked its condition after prepare_wait() and
+  // decided not to sleep after all
+  void cancel_wait() { m_waiters.fetch_sub(1, std::memory_order_seq_cst); }
+
+  void notify_one() { notify(1); }
+  void notify_all() { notify(INT32_MAX); }
+
+private:
+  void notify(const int count) {
+    // Pairs with prepare_wait(): either we see the waiter, or the waiter's
+    // re-check sees what the caller published before notifying
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_waiters.load(std::memory_order_relaxed) == 0)
+      return;
+    m_epoch.fetch_add(1, std::memory_order_seq_cst);
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&m_epoch),
+            FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+  }
+
+  static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) &&
+                std::atomic<uint32_t>::is_always_lock_free);
+  std::atomic<uint32_t> m_epoch{0};
+  std::atomic<uint32_t> m_waiters{0};
+};
+
+} // namespace MatrixPipeline::Utils
@@ -0,0 +1,252 @@
+#include "inference_server.h"
+#include "tensor_cast.h"
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <array>
+#include <exception>
+#include <stdexcept>
+
+namespace MatrixPipeline::Utils {
+
+namespace {
+
+constexpr std::array<double, 7> batch_size_bounds{1, 2, 4, 8, 16, 32, 64};
+// Upper bounds in seconds, finer than the latency default as queue delays
+// are meant to be a few ms at most
+constexpr std::array<double, 11> queue_wait_bounds{
+    0.0001, 0.00025, 0.0005, 0.001, 0.002, 0.005,
+    0.01,   0.025,   0.05,   0.1,   0.25};
+
+void throw_on_error(const cudaError_t err, const char *what) {
+  if (err != cudaSuccess)
+    throw std::runtime_error(
+        fmt::format("{} failed: {}", what, cudaGetErrorString(err)));
+}
+
+// Of every dimension but the first (the batch)
+size_t get_sample_count(const nvinfer1::Dims &dims) {
+  size_t count = 1;
+  for (int i = 1; i < dims.nbDims; ++i) {
+    if (dims.d[i] < 0)
+      throw std::runtime_error("Error: Tensor has an unresolved dimension.");
+    count *= dims.d[i];
+  }
+  return count;
+}
+
+} // namespace
+
+InferenceServer::InferenceServer(
+    std::shared_ptr<nvinfer1::ICudaEngine> engine, Options options)
+    : m_engine(std::move(engine)),
+      m_context(m_engine->createExecutionContext()),
+      m_options(std::move(options)),
+      m_batch_size(MetricsRegistry::instance().histogram(
+          "matrix_pipeline_inference_batch_size",
+          "Requests per batch run by the inference server",
+          {{"server", m_options.name}}, batch_size_bounds)),
+      m_queue_wait(MetricsRegistry::instance().histogram(
+          "matrix_pipeline_inference_queue_wait_seconds",
+          "Time requests waited for their batch to be launched",
+          {{"server", m_options.name}}, queue_wait_bounds)) {
+  if (!m_context)
+    throw std::runtime_error("createExecutionContext() failed");
+  if (m_engine->getNbIOTensors() != 2 ||
+      m_engine->getTensorIOMode(m_engine->getIOTensorName(0)) !=
+          nvinfer1::TensorIOMode::kINPUT ||
+      m_engine->getTensorIOMode(m_engine->getIOTensorName(1)) !=
+          nvinfer1::TensorIOMode::kOUTPUT)
+    throw std::runtime_error(
+        "Error: Model must have exactly 1 Input and 1 Output.");
+  m_input_name = m_engine->getIOTensorName(0);
+  const char *output_name = m_engine->getIOTensorName(1);
+
+  m_input_dims = m_engine->getTensorShape(m_input_name);
+  const bool is_dynamic_batch = m_input_dims.d[0] == -1;
+  const bool has_dynamic_dims =
+      std::find(m_input_dims.d, m_input_dims.d + m_input_dims.nbDims, -1) !=
+      m_input_dims.d + m_input_dims.nbDims;
+  auto max_input_dims = m_input_dims;
+  if (has_dynamic_dims) {
+    // Be it the batch or the input size (e.g., a model exported with dynamic
+    // H/W), the profile pins what the engine leaves open
+    max_input_dims = m_engine->getProfileShape(
+        m_input_name, 0, nvinfer1::OptProfileSelector::kMAX);
+  }
+  if (is_dynamic_batch) {
+    m_max_batch_size = static_cast<int>(std::min<int64_t>(
+        m_options.max_batch_size, max_input_dims.d[0]));
+    max_input_dims.d[0] = m_max_batch_size;
+  } else {
+    m_max_batch_size = static_cast<int>(m_input_dims.d[0]);
+    if (m_max_batch_size != m_options.max_batch_size)
+      SPDLOG_WARN("[{}] the engine has a static batch size of {}, batches "
+                  "are run at that size rather than up to {}",
+                  m_options.name, m_max_batch_size, m_options.max_batch_size);
+  }
+  m_input_dims = max_input_dims;
+  if (is_dynamic_batch)
+    m_input_dims.d[0] = -1;
+  if (has_dynamic_dims &&
+      !m_context->setInputShape(m_input_name, max_input_dims))
+    throw std::runtime_error("setInputShape() failed");
+  m_input_count = get_sample_count(max_input_dims);
+  // Resolved by the context, the engine's own shape may still have -1s in it
+  m_output_dims = m_context->getTensorShape(output_name);
+  m_output_count = get_sample_count(m_output_dims);
+
+  const auto batch_size = static_cast<size_t>(m_max_batch_size);
+  m_input_gpu = make_device_unique<float>(batch_size * m_input_count);
+  m_output_gpu = make_device_unique<float>(batch_size * m_output_count);
+  const auto bind = [this, batch_size](
+                        const char *name, float *float_buffer,
+                        std::unique_ptr<uint16_t, CudaDeleter> &half_buffer,
+                        const size_t count) {
+    switch (m_engine->getTensorDataType(name)) {
+    case nvinfer1::DataType::kFLOAT:
+      m_context->setTensorAddress(name, float_buffer);
+      break;
+    case nvinfer1::DataType::kHALF:
+      half_buffer = make_device_unique<uint16_t>(batch_size * count);
+      m_context->setTensorAddress(name, half_buffer.get());
+      break;
+    default:
+      throw std::runtime_error(
+          fmt::format("Error: Tensor {} must be FP32 or FP16.", name));
+    }
+  };
+  bind(m_input_name, m_input_gpu.get(), m_input_half_gpu, m_input_count);
+  bind(output_name, m_output_gpu.get(), m_output_half_gpu, m_output_count);
+  throw_on_error(cudaStreamCreate(&m_stream), "cudaStreamCreate()");
+
+  SPDLOG_INFO("[{}] inference server started, max_batch_size: {}, "
+              "max_queue_delay: {}us, dynamic batch: {}",
+              m_options.name, m_max_batch_size,
+              m_options.max_queue_delay.count(), is_dynamic_batch);
+  m_worker_thread = std::thread(&InferenceServer::worker_loop, this);
+}
+
+InferenceServer::~InferenceServer() {
+  {
+    std::lock_guard lock(m_queue_mutex);
+    m_running = false;
+  }
+  m_queue_cv.notify_all();
+  if (m_worker_thread.joinable())
+    m_worker_thread.join();
+  for (auto &request : m_queue)
+    request.done.set_exception(std::make_exception_ptr(
+        std::runtime_error("InferenceServer stopped")));
+  if (m_stream != nullptr)
+    cudaStreamDestroy(m_stream);
+}
+
+std::future<void> InferenceServer::submit(const float *input,
+                                          cudaEvent_t input_ready,
+                                          float *output) {
+  Request request{.input = input,
+                  .input_ready = input_ready,
+                  .output = output,
+                  .enqueued_at = std::chrono::steady_clock::now(),
+                  .done = {}};
+  auto future = request.done.get_future();
+  {
+    std::lock_guard lock(m_queue_mutex);
+    m_queue.push_back(std::move(request));
+  }
+  m_queue_cv.notify_one();
+  return future;
+}
+
+void InferenceServer::worker_loop() {
+  std::vector<Request> batch;
+  batch.reserve(m_max_batch_size);
+  const auto is_full = [this] {
+    return !m_running ||
+           m_queue.size() >= static_cast<size_t>(m_max_batch_size);
+  };
+  while (true) {
+    {
+      std::unique_lock lock(m_queue_mutex);
+      m_queue_cv.wait(lock, [this] { return !m_running || !m_queue.empty(); });
+      if (!m_running)
+        return;
+      // Until the batch is full, but the oldest request waits no longer than
+      // max_queue_delay
+      m_queue_cv.wait_until(
+          lock, m_queue.front().enqueued_at + m_options.max_queue_delay,
+          is_full);
+      if (!m_running)
+        return;
+      const auto count =
+          std::min(m_queue.size(), static_cast<size_t>(m_max_batch_size));
+      for (size_t i = 0; i < count; ++i) {
+        batch.push_back(std::move(m_queue.front()));
+        m_queue.pop_front();
+      }
+    }
+
+    const auto dequeued_at = std::chrono::steady_clock::now();
+    for (const auto &request : batch)
+      m_queue_wait->observe(dequeued_at - request.enqueued_at);
+    m_batch_size->observe(static_cast<double>(batch.size()));
+    try {
+      run_batch(batch);
+      for (auto &request : batch)
+        request.done.set_value();
+    } catch (const std::exception &e) {
+      SPDLOG_ERROR("[{}] batch of {} failed: {}", m_options.name, batch.size(),
+                   e.what());
+      const auto err = std::current_exception();
+      for (auto &request : batch)
+        request.done.set_exception(err);
+    }
+    batch.clear();
+  }
+}
+
+void InferenceServer::run_batch(std::vector<Request> &batch) {
+  // Static batches are run whole, with whatever the unused slots hold
+  const bool is_dynamic = m_input_dims.d[0] == -1;
+  const auto run_size =
+      is_dynamic ? batch.size() : static_cast<size_t>(m_max_batch_size);
+
+  for (size_t i = 0; i < batch.size(); ++i) {
+    throw_on_error(cudaStreamWaitEvent(m_stream, batch[i].input_ready),
+                   "cudaStreamWaitEvent()");
+    throw_on_error(cudaMemcpyAsync(m_input_gpu.get() + i * m_input_count,
+                                   batch[i].input,
+                                   m_input_count * sizeof(float),
+                                   cudaMemcpyDeviceToDevice, m_stream),
+                   "cudaMemcpyAsync()");
+  }
+  if (m_input_half_gpu)
+    throw_on_error(cast_float_to_half(m_input_gpu.get(), m_input_half_gpu.get(),
+                                      run_size * m_input_count, m_stream),
+                   "cast_float_to_half()");
+  if (is_dynamic) {
+    auto dims = m_input_dims;
+    dims.d[0] = static_cast<int64_t>(run_size);
+    if (!m_context->setInputShape(m_input_name, dims))
+      throw std::runtime_error("setInputShape() failed");
+  }
+  if (!m_context->enqueueV3(m_stream))
+    throw std::runtime_error("enqueueV3() failed");
+  if (m_output_half_gpu)
+    throw_on_error(cast_half_to_float(m_output_half_gpu.get(),
+                                      m_output_gpu.get(),
+                                      run_size * m_output_count, m_stream),
+                   "cast_half_to_float()");
+  for (size_t i = 0; i < batch.size(); ++i)
+    throw_on_error(cudaMemcpyAsync(batch[i].output,
+                                   m_output_gpu.get() + i * m_output_count,
+                                   m_output_count * sizeof(float),
+                                   cudaMemcpyDeviceToDevice, m_stream),
+                   "cudaMemcpyAsync()");
+  throw_on_error(cudaStreamSynchronize(m_stream), "cudaStreamSynchronize()");
+}
+
+} // namespace MatrixPipeline::Utils
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "cuda_helper.h"
+#include "metrics.h"
+
+#include <NvInfer.h>
+#include <cuda_runtime.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace MatrixPipeline::Utils {
+
+/**
+ * @brief Runs a TensorRT engine on behalf of all the units (of any camera or
+ * branch) using it, s.t. their requests are grouped into dynamic batches
+ * rather than each unit running many tiny batch-of-one inferences.
+ *
+ * A batch is launched once max_batch_size requests are queued or the oldest
+ * of them has waited for max_queue_delay, whichever comes first. A single
+ * worker thread owns the execution context, the stream and the batched
+ * buffers; it gathers the requests' inputs (device to device), runs the batch
+ * and scatters the outputs back before fulfilling the requests' futures.
+ *
+ * Batching needs an engine with a dynamic batch dimension, i.e., built with
+ * an optimization profile up to max_batch_size; with a static one, batches
+ * are always run at that size.
+ *
+ * Instances are shared through SharedResourceRegistry, keyed by engine and
+ * Options, and stop (failing whatever is still queued) with their last user.
+ */
+class InferenceServer {
+public:
+  struct Options {
+    int max_batch_size = 8;
+    std::chrono::microseconds max_queue_delay{2000};
+    // Labels the server's metrics, e.g., the model it runs
+    std::string name;
+  };
+
+  /**
+   * @param engine must have exactly one input and one output (in this
+   * order), FP32 or FP16, both with the batch as their first dimension
+   * @throws std::runtime_error if it doesn't, or if CUDA resources can't be
+   * allocated
+   */
+  InferenceServer(std::shared_ptr<nvinfer1::ICudaEngine> engine,
+                  Options options);
+  ~InferenceServer();
+
+  InferenceServer(const InferenceServer &) = delete;
+  InferenceServer &operator=(const InferenceServer &) = delete;
+
+  // Per sample, in floats
+  [[nodiscard]] size_t get_input_count() const { return m_input_count; }
+  [[nodiscard]] size_t get_output_count() const { return m_output_count; }
+  // Resolved at the profile's maximum, the first (batch) dimension included
+  [[nodiscard]] const nvinfer1::Dims &get_output_dims() const {
+    return m_output_dims;
+  }
+  [[nodiscard]] int get_max_batch_size() const { return m_max_batch_size; }
+
+  /**
+   * @brief Queues one sample.
+   * @param input get_input_count() floats in device memory, to be read once
+   * input_ready (recorded by the caller on its own stream) has completed
+   * @param output get_output_count() floats in device memory, written before
+   * the future becomes ready. Neither buffer may be reused before then
+   * @return holds a std::runtime_error if the batch failed
+   */
+  std::future<void> submit(const float *input, cudaEvent_t input_ready,
+                           float *output);
+
+private:
+  struct Request {
+    const float *input;
+    cudaEvent_t input_ready;
+    float *output;
+    std::chrono::steady_clock::time_point enqueued_at;
+    std::promise<void> done;
+  };
+
+  const std::shared_ptr<nvinfer1::ICudaEngine> m_engine;
+  std::unique_ptr<nvinfer1::IExecutionContext> m_context;
+  const Options m_options;
+  const char *m_input_name = nullptr;
+  // With the batch dimension being -1 if it is dynamic, the others resolved
+  nvinfer1::Dims m_input_dims{};
+  nvinfer1::Dims m_output_dims{};
+  int m_max_batch_size = 1;
+  size_t m_input_count = 1;
+  size_t m_output_count = 1;
+
+  cudaStream_t m_stream = nullptr;
+  // m_max_batch_size samples each
+  std::unique_ptr<float, CudaDeleter> m_input_gpu;
+  std::unique_ptr<float, CudaDeleter> m_output_gpu;
+  // Only if the engine's tensor is FP16, bound instead of the float buffers
+  // above, which requests are gathered into and scattered from
+  std::unique_ptr<uint16_t, CudaDeleter> m_input_half_gpu;
+  std::unique_ptr<uint16_t, CudaDeleter> m_output_half_gpu;
+
+  std::shared_ptr<Histogram> m_batch_size;
+  std::shared_ptr<Histogram> m_queue_wait;
+
+  std::thread m_worker_thread;
+  std::mutex m_queue_mutex;
+  std::condition_variable m_queue_cv;
+  std::deque<Request> m_queue;
+  bool m_running = true;
+
+  void worker_loop();
+  // Throws std::runtime_error if any step of the batch fails
+  void run_batch(std::vector<Request> &batch);
+};
+
+} // namespace MatrixPipeline::Utils
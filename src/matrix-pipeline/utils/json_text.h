@@ -0,0 +1,76 @@
+#pragma once
+
+#include <fmt/format.h>
+
+#include <cmath>
+#include <iterator>
+#include <string_view>
+
+namespace MatrixPipeline::Utils {
+
+// Helpers writing JSON-formatted text straight into a string (usually one
+// allocated from the frame's arena), for per-frame text such as the overlay's
+// "Yolo: [...]" lines, where building an njson first would allocate every
+// node and key on the heap.
+
+// Appends str quoted and escaped, as njson::dump() would
+template <typename String>
+void append_json_string(String &out, const std::string_view str) {
+  out += '"';
+  for (const char c : str) {
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    case '\r':
+      out += "\\r";
+      break;
+    case '\t':
+      out += "\\t";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20)
+        fmt::format_to(std::back_inserter(out), "\\u{:04x}", c);
+      else
+        out += c;
+    }
+  }
+  out += '"';
+}
+
+// Appends value as njson::dump() would, i.e., null if not finite and with a
+// ".0" if it would otherwise read as an integer
+template <typename String>
+void append_json_number(String &out, const double value) {
+  if (!std::isfinite(value)) {
+    out += "null";
+    return;
+  }
+  const auto start = out.size();
+  fmt::format_to(std::back_inserter(out), "{}", value);
+  const std::string_view text(out);
+  if (text.find_first_of(".e", start) == std::string_view::npos)
+    out += ".0";
+}
+
+/**
+ * @brief Starts element idx of an array written one element per line, i.e.,
+ * "[\n  elem0, \n  elem1\n]", as the overlay text has always shown them. The
+ * array is opened by the first call and closed by end_json_array_lines()
+ */
+template <typename String>
+void begin_json_array_line(String &out, const size_t idx) {
+  out += idx == 0 ? "[\n  " : ", \n  ";
+}
+template <typename String>
+void end_json_array_lines(String &out, const size_t size) {
+  out += size == 0 ? "[\n]" : "\n]";
+}
+
+} // namespace MatrixPipeline::Utils
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <fmt/format.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace MatrixPipeline::Utils {
+
+/**
+ * @brief Process-wide telemetry, exported in Prometheus' text format by the
+ * /metrics endpoint.
+ *
+ * Units, devices, etc. get their metrics from MetricsRegistry once (at
+ * construction/init) and update them on the frame path with relaxed atomics
+ * only. The registry keeps weak references, s.t. a metric lives as long as its
+ * owner does. Scraping takes the registry's mutex, which the frame path never
+ * touches.
+ */
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+class Metric {
+public:
+  virtual ~Metric() = default;
+  // Appends the metric's sample line(s)
+  virtual void render(const std::string &name, const MetricLabels &labels,
+                      std::string &out) const = 0;
+
+  // {key="value",...}, or "" if labels is empty
+  static std::string format_labels(const MetricLabels &labels) {
+    if (labels.empty())
+      return "";
+    std::string out = "{";
+    for (const auto &[key, value] : labels) {
+      if (out.size() > 1)
+        out += ',';
+      out += key;
+      out += "=\"";
+      for (const auto c : value) {
+        if (c == '\\' || c == '"')
+          out += '\\';
+        if (c == '\n')
+          out += "\\n";
+        else
+          out += c;
+      }
+      out += '"';
+    }
+    out += '}';
+    return out;
+  }
+};
+
+class Counter final : public Metric {
+public:
+  // scale is applied when rendering, e.g., 1e-9 for nanoseconds counted
+  // internally but exported as seconds
+  explicit Counter(const double scale = 1.0) : m_scale(scale) {}
+
+  void inc(const uint64_t n = 1) {
+    m_value.fetch_add(n, std::memory_order_relaxed);
+  }
+  [[nodiscard]] uint64_t value() const {
+    return m_value.load(std::memory_order_relaxed);
+  }
+
+  void render(const std::string &name, const MetricLabels &labels,
+              std::string &out) const override {
+    if (m_scale == 1.0)
+      out += fmt::format("{}{} {}\n", name, format_labels(labels), value());
+    else
+      out += fmt::format("{}{} {}\n", name, format_labels(labels),
+                         value() * m_scale);
+  }
+
+private:
+  const double m_scale;
+  std::atomic<uint64_t> m_value{0};
+};
+
+class Gauge final : public Metric {
+public:
+  void set(const double value) {
+    m_value.store(value, std::memory_order_relaxed);
+  }
+  [[nodiscard]] double value() const {
+    return m_value.load(std::memory_order_relaxed);
+  }
+
+  void render(const std::string &name, const MetricLabels &labels,
+              std::string &out) const override {
+    out += fmt::format("{}{} {}\n", name, format_labels(labels), value());
+  }
+
+private:
+  std::atomic<double> m_value{0};
+};
+
+/**
+ * @brief A histogram with fixed buckets, by default latency ones from 0.5 ms
+ * (a trivial synchronous unit) to 10 sec (a branch that fell far behind its
+ * capture).
+ */
+class Histogram final : public Metric {
+public:
+  // Upper bounds in seconds
+  static constexpr std::array<double, 14> latency_bounds{
+      0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05,
+      0.1,    0.25,  0.5,    1.0,   2.5,  5.0,   10.0};
+
+  // bucket_bounds are the buckets' upper bounds, ascending
+  explicit Histogram(
+      const std::span<const double> bucket_bounds = latency_bounds)
+      : m_bucket_bounds(bucket_bounds.begin(), bucket_bounds.end()),
+        m_buckets(m_bucket_bounds.size() + 1) {}
+
+  void observe(const std::chrono::nanoseconds elapsed) {
+    observe(std::chrono::duration<double>(elapsed).count());
+  }
+  void observe(const double value) {
+    size_t idx = 0;
+    while (idx < m_bucket_bounds.size() && value > m_bucket_bounds[idx])
+      ++idx;
+    // Not cumulative here, render() sums them up
+    m_buckets[idx].fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+  }
+  [[nodiscard]] uint64_t count() const {
+    return m_count.load(std::memory_order_relaxed);
+  }
+  [[nodiscard]] double sum() const {
+    return m_sum.load(std::memory_order_relaxed);
+  }
+
+  void render(const std::string &name, const MetricLabels &labels,
+              std::string &out) const override {
+    auto bucket_labels = labels;
+    bucket_labels.emplace_back("le", "");
+    uint64_t cumulative_count = 0;
+    for (size_t i = 0; i <= m_bucket_bounds.size(); ++i) {
+      cumulative_count += m_buckets[i].load(std::memory_order_relaxed);
+      bucket_labels.back().second =
+          i < m_bucket_bounds.size() ? fmt::format("{}", m_bucket_bounds[i])
+                                     : "+Inf";
+      out += fmt::format("{}_bucket{} {}\n", name,
+                         format_labels(bucket_labels), cumulative_count);
+    }
+    out += fmt::format("{}_sum{} {}\n", name, format_labels(labels), sum());
+    out += fmt::format("{}_count{} {}\n", name, format_labels(labels),
+                       cumulative_count);
+  }
+
+private:
+  const std::vector<double> m_bucket_bounds;
+  // The last one is +Inf
+  std::vector<std::atomic<uint64_t>> m_buckets;
+  std::atomic<double> m_sum{0};
+  std::atomic<uint64_t> m_count{0};
+};
+
+class MetricsRegistry {
+public:
+  // Intentionally leaked: metrics may be updated during static destruction,
+  // e.g., by the frame pools
+  static MetricsRegistry &instance() {
+    static auto *registry = new MetricsRegistry();
+    return *registry;
+  }
+
+  /**
+   * @brief The getters return the live metric with the same name and labels
+   * if there is one (e.g., two units sharing a unit path share their metrics),
+   * or a new one otherwise.
+   */
+  std::shared_ptr<Counter> counter(const std::string &name,
+                                   const std::string &help,
+                                   const MetricLabels &labels,
+                                   const double scale = 1.0) {
+    return get_or_create<Counter>("counter", name, help, labels, scale);
+  }
+  std::shared_ptr<Gauge> gauge(const std::string &name,
+                               const std::string &help,
+                               const MetricLabels &labels) {
+    return get_or_create<Gauge>("gauge", name, help, labels);
+  }
+  std::shared_ptr<Histogram>
+  histogram(const std::string &name, const std::string &help,
+            const MetricLabels &labels,
+            const std::span<const double> bucket_bounds =
+                Histogram::latency_bounds) {
+    return get_or_create<Histogram>("histogram", name, help, labels,
+                                    bucket_bounds);
+  }
+
+  // All live metrics in Prometheus' text exposition format
+  std::string render() {
+    std::string out;
+    std::lock_guard lock(m_mutex);
+    for (auto &[name, family] : m_families) {
+      std::erase_if(family.metrics,
+                    [](const auto &entry) { return entry.second.expired(); });
+      if (family.metrics.empty())
+        continue;
+      out += fmt::format("# HELP {} {}\n# TYPE {} {}\n", name, family.help,
+                         name, family.type);
+      for (const auto &[labels, weak_metric] : family.metrics) {
+        if (const auto metric = weak_metric.lock())
+          metric->render(name, labels, out);
+      }
+    }
+    return out;
+  }
+
+private:
+  struct Family {
+    std::string type;
+    std::string help;
+    std::map<MetricLabels, std::weak_ptr<Metric>> metrics;
+  };
+
+  MetricsRegistry() = default;
+
+  template <typename T, typename... Args>
+  std::shared_ptr<T> get_or_create(const std::string &type,
+                                   const std::string &name,
+                                   const std::string &help,
+                                   const MetricLabels &labels,
+                                   Args &&...args) {
+    std::lock_guard lock(m_mutex);
+    auto &family = m_families[name];
+    family.type = type;
+    family.help = help;
+    auto &weak_metric = family.metrics[labels];
+    if (const auto metric = std::dynamic_pointer_cast<T>(weak_metric.lock()))
+      return metric;
+    auto metric = std::make_shared<T>(std::forward<Args>(args)...);
+    weak_metric = metric;
+    return metric;
+  }
+
+  std::mutex m_mutex;
+  std::map<std::string, Family> m_families;
+};
+
+} // namespace MatrixPipeline::Utils
@@ -56,6 +56,7 @@ void install_signal_handler(const signal_handler_callback cb) {
   be invoked consecutively, breaking the program.  */
   // act.sa_flags = SA_RESETHAND;
   if (sigaction(SIGINT, &act, nullptr) + sigaction(SIGABRT, &act, nullptr) +
+          sigaction(SIGHUP, &act, nullptr) +
           sigaction(SIGQUIT, &act, nullptr) +
           sigaction(SIGTERM, &act, nullptr) +
           sigaction(SIGPIPE, &act, nullptr) +
@@ -67,17 +68,4 @@ void install_signal_handler(const signal_handler_callback cb) {
   }
 }
 
-std::string hybrid_njson_array_dump(const njson &j_array) {
-  if (!j_array.is_array())
-    return j_array.dump();
-
-  std::string out = "[\n";
-  for (size_t i = 0; i < j_array.size(); ++i) {
-    out += fmt::format("  {}{}\n", j_array[i].dump(),
-                       (i < j_array.size() - 1 ? ", " : ""));
-  }
-  out += "]";
-  return out;
-}
-
 } // namespace MatrixPipeline::Utils
\ No newline at end of file
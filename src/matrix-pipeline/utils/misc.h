@@ -20,8 +20,6 @@ typedef auto (*signal_handler_callback)(int) -> void;
 
 void install_signal_handler(signal_handler_callback cb);
 
-std::string hybrid_njson_array_dump(const njson &j_array);
-
 // a temporary solution, we should not need it after C++23 is fully implemented
 template <typename Duration>
 auto steady_clock_to_system_time(
@@ -77,7 +75,7 @@ inline std::optional<std::string> evaluate_text_template(
   try {
     evaluated_string = fmt::format(
         fmt::runtime(evaluated_string),
-        fmt::arg("deviceName", ctx->device_info.name),
+        fmt::arg("deviceName", ctx->device_info->name),
         fmt::arg("fps", ctx->fps), fmt::arg("changeRate", ctx->change_rate),
         fmt::arg("changeRatePct", ctx->change_rate * 100));
   } catch (const std::exception &e) {
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "futex_event.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace MatrixPipeline::Utils {
+
+/**
+ * @brief A bounded lock-free queue with preallocated slots, after Dmitry
+ * Vyukov's bounded MPMC queue: each slot carries a sequence number telling
+ * producers and consumers whose turn it is, so push() and pop() are one CAS
+ * on the shared index plus a move into/out of the slot.
+ *
+ * It's meant for many producers and one consumer, but pop() is safe to call
+ * from producers too, which lets them evict the oldest element when the ring
+ * is full. Popped slots are moved from, i.e., the ring doesn't keep elements
+ * (say, GPU frames) alive after they have been consumed.
+ */
+template <typename T> class MpscRing {
+public:
+  // capacity is rounded up to a power of two
+  explicit MpscRing(const size_t capacity)
+      : m_mask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1),
+        m_slots(std::make_unique<Slot[]>(m_mask + 1)) {
+    for (size_t i = 0; i <= m_mask; ++i)
+      m_slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  MpscRing(const MpscRing &) = delete;
+  MpscRing &operator=(const MpscRing &) = delete;
+
+  /**
+   * @return false if the ring is full, value is left untouched in this case
+   */
+  bool try_push(T &&value) {
+    size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true) {
+      slot = &m_slots[pos & m_mask];
+      const size_t seq = slot->sequence.load(std::memory_order_acquire);
+      const auto diff =
+          static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+      if (diff == 0) {
+        if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                                std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = m_enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+    slot->value = std::move(value);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    m_not_empty.notify_one();
+    return true;
+  }
+
+  /**
+   * @return false if the ring is empty
+   */
+  bool try_pop(T &value) {
+    size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true) {
+      slot = &m_slots[pos & m_mask];
+      const size_t seq = slot->sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::ptrdiff_t>(seq) -
+                        static_cast<std::ptrdiff_t>(pos + 1);
+      if (diff == 0) {
+        if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1,
+                                                std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = m_dequeue_pos.load(std::memory_order_relaxed);
+      }
+    }
+    value = std::move(slot->value);
+    slot->value = T{};
+    slot->sequence.store(pos + m_mask + 1, std::memory_order_release);
+    m_not_full.notify_one();
+    return true;
+  }
+
+  /**
+   * @brief Blocks until an element is available, timeout expires or
+   * wake_all() is called, whichever comes first.
+   */
+  bool wait_pop(T &value, const std::chrono::nanoseconds timeout) {
+    // A short spin first, a futex round trip costs several microseconds
+    for (int i = 0; i < spin_count; ++i) {
+      if (try_pop(value))
+        return true;
+    }
+    const auto epoch = m_not_empty.prepare_wait();
+    if (try_pop(value)) {
+      m_not_empty.cancel_wait();
+      return true;
+    }
+    m_not_empty.wait_for(epoch, timeout);
+    return try_pop(value);
+  }
+
+  /**
+   * @brief Sleeps while is_full() holds, until something is popped, timeout
+   * expires or wake_all() is called. is_full() lets the caller apply its own
+   * notion of "full" (e.g., a byte limit), it's re-checked by the caller
+   * afterwards.
+   */
+  template <typename Predicate>
+  void wait_while_full(Predicate is_full,
+                       const std::chrono::nanoseconds timeout) {
+    for (int i = 0; i < spin_count; ++i) {
+      if (!is_full())
+        return;
+    }
+    const auto epoch = m_not_full.prepare_wait();
+    if (!is_full()) {
+      m_not_full.cancel_wait();
+      return;
+    }
+    m_not_full.wait_for(epoch, timeout);
+  }
+
+  void wake_all() {
+    m_not_empty.notify_all();
+    m_not_full.notify_all();
+  }
+
+  // Exact when no push()/pop() is in flight
+  [[nodiscard]] size_t size_approx() const {
+    const auto enqueue_pos = m_enqueue_pos.load(std::memory_order_acquire);
+    const auto dequeue_pos = m_dequeue_pos.load(std::memory_order_acquire);
+    return enqueue_pos > dequeue_pos ? enqueue_pos - dequeue_pos : 0;
+  }
+
+  [[nodiscard]] size_t capacity() const { return m_mask + 1; }
+
+private:
+  // std::hardware_destructive_interference_size triggers -Winterference-size
+  // in headers
+  static constexpr size_t cache_line_size = 64;
+  static constexpr int spin_count = 128;
+  struct alignas(cache_line_size) Slot {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  const size_t m_mask;
+  std::unique_ptr<Slot[]> m_slots;
+  alignas(cache_line_size) std::atomic<size_t> m_enqueue_pos{0};
+  alignas(cache_line_size) std::atomic<size_t> m_dequeue_pos{0};
+  alignas(cache_line_size) FutexEvent m_not_empty;
+  alignas(cache_line_size) FutexEvent m_not_full;
+};
+
+} // namespace MatrixPipeline::Utils
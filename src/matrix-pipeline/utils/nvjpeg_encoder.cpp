@@ -1,12 +1,33 @@
 #include "nvjpeg_encoder.h"
+#include "shared_resource_registry.h"
 
 #include <spdlog/spdlog.h>
 
 namespace MatrixPipeline::Utils {
-NvJpegEncoder::NvJpegEncoder() {
-  check(nvjpegCreateSimple(&m_handle), "CreateSimple");
-  check(nvjpegEncoderStateCreate(m_handle, &m_state, nullptr), "StateCreate");
-  check(nvjpegEncoderParamsCreate(m_handle, &m_params, nullptr),
+std::shared_ptr<std::remove_pointer_t<nvjpegHandle_t>>
+NvJpegEncoder::get_shared_handle() {
+  return SharedResourceRegistry<std::remove_pointer_t<nvjpegHandle_t>>::
+      instance()
+          .get_or_create(
+              "nvjpeg",
+              []() -> std::shared_ptr<std::remove_pointer_t<nvjpegHandle_t>> {
+                nvjpegHandle_t handle = nullptr;
+                if (const auto status = nvjpegCreateSimple(&handle);
+                    status != NVJPEG_STATUS_SUCCESS) {
+                  SPDLOG_ERROR("nvjpegCreateSimple() failed: {}",
+                               (int)status);
+                  return nullptr;
+                }
+                return {handle, nvjpegDestroy};
+              });
+}
+
+NvJpegEncoder::NvJpegEncoder() : m_handle(get_shared_handle()) {
+  if (!m_handle)
+    return;
+  check(nvjpegEncoderStateCreate(m_handle.get(), &m_state, nullptr),
+        "StateCreate");
+  check(nvjpegEncoderParamsCreate(m_handle.get(), &m_params, nullptr),
         "ParamsCreate");
 }
 
@@ -15,8 +36,6 @@ NvJpegEncoder::~NvJpegEncoder() {
     nvjpegEncoderParamsDestroy(m_params);
   if (m_state)
     nvjpegEncoderStateDestroy(m_state);
-  if (m_handle)
-    nvjpegDestroy(m_handle);
 }
 
 void NvJpegEncoder::check(nvjpegStatus_t status, const char *msg) {
@@ -28,7 +47,7 @@ void NvJpegEncoder::check(nvjpegStatus_t status, const char *msg) {
 bool NvJpegEncoder::encode(const cv::cuda::GpuMat &src,
                            std::string &output_buffer,
                            const int quality) const {
-  if (src.empty())
+  if (src.empty() || m_state == nullptr || m_params == nullptr)
     return false;
 
   check(nvjpegEncoderParamsSetSamplingFactors(m_params, NVJPEG_CSS_444, NULL),
@@ -40,7 +59,7 @@ bool NvJpegEncoder::encode(const cv::cuda::GpuMat &src,
   img_desc.pitch[0] = (unsigned int)src.step;
 
   nvjpegStatus_t status =
-      nvjpegEncodeImage(m_handle, m_state, m_params, &img_desc,
+      nvjpegEncodeImage(m_handle.get(), m_state, m_params, &img_desc,
                         NVJPEG_INPUT_BGRI, src.cols, src.rows, NULL);
 
   if (status != NVJPEG_STATUS_SUCCESS) {
@@ -49,11 +68,12 @@ bool NvJpegEncoder::encode(const cv::cuda::GpuMat &src,
   }
 
   size_t length;
-  check(nvjpegEncodeRetrieveBitstream(m_handle, m_state, NULL, &length, NULL),
+  check(nvjpegEncodeRetrieveBitstream(m_handle.get(), m_state, NULL, &length,
+                                      NULL),
         "RetrieveLength");
   output_buffer.resize(length);
   check(nvjpegEncodeRetrieveBitstream(
-            m_handle, m_state,
+            m_handle.get(), m_state,
             reinterpret_cast<unsigned char *>(output_buffer.data()), &length,
             nullptr),
         "RetrieveData");
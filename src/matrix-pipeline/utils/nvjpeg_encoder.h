@@ -3,6 +3,8 @@
 #include <nvjpeg.h>
 #include <opencv2/cudaimgproc.hpp>
 
+#include <memory>
+#include <type_traits>
 #include <vector>
 
 namespace MatrixPipeline::Utils{
@@ -16,10 +18,14 @@ public:
   bool encode(const cv::cuda::GpuMat &src, std::string &output_buffer, int quality = 90) const;
 
 private:
-  nvjpegHandle_t m_handle = nullptr;
+  // The library handle is thread-safe and relatively expensive to create, it
+  // is shared by all encoders in the process; states/params are per-encoder.
+  std::shared_ptr<std::remove_pointer_t<nvjpegHandle_t>> m_handle;
   nvjpegEncoderState_t m_state = nullptr;
   nvjpegEncoderParams_t m_params = nullptr;
 
+  static std::shared_ptr<std::remove_pointer_t<nvjpegHandle_t>>
+  get_shared_handle();
   static void check(nvjpegStatus_t status, const char *msg);
 };
 }
\ No newline at end of file
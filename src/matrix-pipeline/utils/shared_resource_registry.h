@@ -0,0 +1,55 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace MatrixPipeline::Utils {
+
+/**
+ * @brief A process-wide cache of heavy resources (TensorRT engines, nvJPEG
+ * handles, etc.) so that they can be shared by all devices and processing
+ * units living in the same process.
+ *
+ * Entries are held by weak_ptr, i.e., the registry never keeps a resource
+ * alive on its own: it is destroyed as soon as its last user goes away.
+ */
+template <typename T> class SharedResourceRegistry {
+public:
+  static SharedResourceRegistry &instance() {
+    static SharedResourceRegistry registry;
+    return registry;
+  }
+
+  /**
+   * @brief Returns the resource registered under key, creating it with
+   * factory() if it does not exist (anymore).
+   * factory() runs with the registry lock held, so concurrent callers asking
+   * for the same key wait for the first one instead of building the resource
+   * twice. factory() may return nullptr to signal failure, in which case
+   * nothing is registered.
+   */
+  std::shared_ptr<T>
+  get_or_create(const std::string &key,
+                const std::function<std::shared_ptr<T>()> &factory) {
+    std::lock_guard lock(m_mutex);
+    if (const auto it = m_resources.find(key); it != m_resources.end()) {
+      if (auto resource = it->second.lock())
+        return resource;
+    }
+    auto resource = factory();
+    if (resource)
+      m_resources[key] = resource;
+    return resource;
+  }
+
+private:
+  SharedResourceRegistry() = default;
+
+  std::mutex m_mutex;
+  std::map<std::string, std::weak_ptr<T>> m_resources;
+};
+
+} // namespace MatrixPipeline::Utils
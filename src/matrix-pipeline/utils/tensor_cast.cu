@@ -0,0 +1,55 @@
+#include "tensor_cast.h"
+
+#include <cuda_fp16.h>
+
+namespace MatrixPipeline::Utils {
+
+namespace {
+
+constexpr int threads_per_block = 256;
+
+__global__ void float_to_half_kernel(const float *__restrict__ src,
+                                     __half *__restrict__ dst,
+                                     const size_t count) {
+  const size_t i = static_cast<size_t>(blockIdx.x) * blockDim.x + threadIdx.x;
+  if (i < count)
+    dst[i] = __float2half(src[i]);
+}
+
+__global__ void half_to_float_kernel(const __half *__restrict__ src,
+                                     float *__restrict__ dst,
+                                     const size_t count) {
+  const size_t i = static_cast<size_t>(blockIdx.x) * blockDim.x + threadIdx.x;
+  if (i < count)
+    dst[i] = __half2float(src[i]);
+}
+
+unsigned get_block_count(const size_t count) {
+  return static_cast<unsigned>((count + threads_per_block - 1) /
+                               threads_per_block);
+}
+
+} // namespace
+
+static_assert(sizeof(__half) == half_size);
+
+cudaError_t cast_float_to_half(const float *src, void *dst,
+                               const size_t count, cudaStream_t stream) {
+  if (count == 0)
+    return cudaSuccess;
+  float_to_half_kernel<<<get_block_count(count), threads_per_block, 0,
+                         stream>>>(src, static_cast<__half *>(dst), count);
+  return cudaGetLastError();
+}
+
+cudaError_t cast_half_to_float(const void *src, float *dst,
+                               const size_t count, cudaStream_t stream) {
+  if (count == 0)
+    return cudaSuccess;
+  half_to_float_kernel<<<get_block_count(count), threads_per_block, 0,
+                         stream>>>(static_cast<const __half *>(src), dst,
+                                   count);
+  return cudaGetLastError();
+}
+
+} // namespace MatrixPipeline::Utils
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cuda_runtime.h>
+
+#include <cstddef>
+
+namespace MatrixPipeline::Utils {
+
+// Bytes per element of an FP16 tensor
+inline constexpr size_t half_size = 2;
+
+// Converts between the float buffers preprocessing and decoding work with
+// and the FP16 (__half, passed as void * s.t. C++ callers needn't include
+// cuda_fp16.h) tensors an engine may take or return. Enqueued on stream
+cudaError_t cast_float_to_half(const float *src, void *dst, size_t count,
+                               cudaStream_t stream);
+cudaError_t cast_half_to_float(const void *src, float *dst, size_t count,
+                               cudaStream_t stream);
+
+} // namespace MatrixPipeline::Utils
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <fmt/format.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace MatrixPipeline::Utils {
+
+/**
+ * @brief A low-overhead in-process tracer: spans (capture, enqueue, each
+ * unit's process()/on_frame_ready(), CUDA stream syncs, etc.) tagged with
+ * their frame_seq_num are recorded into per-thread ring buffers, and the last
+ * few seconds of them can be exported as Chrome trace JSON (chrome://tracing,
+ * https://ui.perfetto.dev). Unlike sampling profilers, this also covers the
+ * time threads spend waiting for each other and for the GPU, and lets one
+ * frame be followed across all branches.
+ *
+ * Disabled unless enable() is called, a disabled TRACE_SCOPE costs one relaxed
+ * atomic load. Once enabled, recording a span is a handful of relaxed stores
+ * into the calling thread's own buffer, no locks and no allocations.
+ */
+class Tracer {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * @param events_per_thread each thread keeps its most recent this many spans
+   * (rounded up to a power of two)
+   */
+  static void enable(const size_t events_per_thread) {
+    {
+      auto &state = get_state();
+      std::lock_guard lock(state.mutex);
+      state.events_per_thread =
+          std::bit_ceil(std::max<size_t>(events_per_thread, 1));
+    }
+    s_enabled.store(true, std::memory_order_release);
+  }
+  static bool is_enabled() {
+    return s_enabled.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Returns a pointer to a copy of name that is valid for the rest of
+   * the process' life, as spans only store pointers. Not meant for the frame
+   * path, call it once (e.g., in a constructor) and keep the result.
+   */
+  static const char *intern(const std::string &name) {
+    auto &state = get_state();
+    std::lock_guard lock(state.mutex);
+    return state.interned_names.insert(name).first->c_str();
+  }
+
+  /**
+   * @param name, category must be string literals or intern()ed
+   */
+  static void record(const char *name, const char *category,
+                     const Clock::time_point begin, const Clock::time_point end,
+                     const uint32_t frame_seq_num) {
+    if (!is_enabled())
+      return;
+    auto &buffer = get_thread_buffer();
+    const auto idx = buffer.next_idx++;
+    auto &event = buffer.events[idx & (buffer.events.size() - 1)];
+    // A seqlock per event: odd while being written, s.t. a concurrent
+    // export skips it instead of reading a torn event
+    const auto seq = event.seq.load(std::memory_order_relaxed);
+    event.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.name.store(name, std::memory_order_relaxed);
+    event.category.store(category, std::memory_order_relaxed);
+    event.begin_ns.store(to_ns(begin), std::memory_order_relaxed);
+    event.end_ns.store(to_ns(end), std::memory_order_relaxed);
+    event.frame_seq_num.store(frame_seq_num, std::memory_order_relaxed);
+    event.seq.store(seq + 2, std::memory_order_release);
+  }
+
+  /**
+   * @brief Spans of all threads that ended within the last window, as a
+   * Chrome trace JSON object. Safe to call while spans are being recorded.
+   */
+  static std::string
+  export_chrome_json(const std::chrono::nanoseconds window) {
+    auto &state = get_state();
+    const auto min_end_ns = to_ns(Clock::now()) - window.count();
+    std::string out = R"({"displayTimeUnit":"ms","traceEvents":[)";
+    bool first = true;
+    const auto append = [&](const std::string &event) {
+      if (!first)
+        out += ',';
+      out += event;
+      first = false;
+    };
+    std::lock_guard lock(state.mutex);
+    for (const auto &buffer : state.thread_buffers) {
+      append(fmt::format(R"({{"name":"thread_name","ph":"M","pid":1,)"
+                         R"("tid":{},"args":{{"name":"{}"}}}})",
+                         buffer->tid, escape(buffer->thread_name)));
+      for (const auto &event : buffer->events) {
+        const auto seq = event.seq.load(std::memory_order_acquire);
+        if (seq == 0 || seq % 2 != 0)
+          continue;
+        const auto *name = event.name.load(std::memory_order_relaxed);
+        const auto *category = event.category.load(std::memory_order_relaxed);
+        const auto begin_ns = event.begin_ns.load(std::memory_order_relaxed);
+        const auto end_ns = event.end_ns.load(std::memory_order_relaxed);
+        const auto frame_seq_num =
+            event.frame_seq_num.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (event.seq.load(std::memory_order_relaxed) != seq ||
+            end_ns < min_end_ns)
+          continue;
+        append(fmt::format(
+            R"({{"name":"{}","cat":"{}","ph":"X","ts":{:.3f},"dur":{:.3f},)"
+            R"("pid":1,"tid":{},"args":{{"frame_seq_num":{}}}}})",
+            escape(name), escape(category), begin_ns / 1000.0,
+            (end_ns - begin_ns) / 1000.0, buffer->tid, frame_seq_num));
+      }
+    }
+    out += "]}";
+    return out;
+  }
+
+private:
+  struct Event {
+    std::atomic<uint64_t> seq{0};
+    std::atomic<const char *> name{nullptr};
+    std::atomic<const char *> category{nullptr};
+    std::atomic<int64_t> begin_ns{0};
+    std::atomic<int64_t> end_ns{0};
+    std::atomic<uint32_t> frame_seq_num{0};
+  };
+
+  struct ThreadBuffer {
+    explicit ThreadBuffer(const size_t capacity) : events(capacity) {}
+    std::vector<Event> events;
+    // Only ever touched by the owning thread
+    uint64_t next_idx = 0;
+    pid_t tid = 0;
+    std::string thread_name;
+  };
+
+  struct State {
+    std::mutex mutex;
+    size_t events_per_thread = 16384;
+    // Kept after their threads exit, s.t. their spans can still be exported
+    std::vector<std::unique_ptr<ThreadBuffer>> thread_buffers;
+    std::unordered_set<std::string> interned_names;
+  };
+
+  static inline std::atomic<bool> s_enabled{false};
+
+  // Intentionally leaked, threads may record spans during static destruction
+  static State &get_state() {
+    static auto *state = new State();
+    return *state;
+  }
+
+  static ThreadBuffer &get_thread_buffer() {
+    // A raw pointer, i.e., no TLS destructor to register, State owns it
+    thread_local ThreadBuffer *buffer = nullptr;
+    if (buffer == nullptr) {
+      auto &state = get_state();
+      std::lock_guard lock(state.mutex);
+      auto new_buffer =
+          std::make_unique<ThreadBuffer>(state.events_per_thread);
+      new_buffer->tid = static_cast<pid_t>(syscall(SYS_gettid));
+      char thread_name[16] = {};
+      pthread_getname_np(pthread_self(), thread_name, sizeof(thread_name));
+      new_buffer->thread_name = thread_name;
+      buffer = new_buffer.get();
+      state.thread_buffers.push_back(std::move(new_buffer));
+    }
+    return *buffer;
+  }
+
+  static int64_t to_ns(const Clock::time_point time_point) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               time_point.time_since_epoch())
+        .count();
+  }
+
+  static std::string escape(const char *str) {
+    std::string escaped;
+    for (; str != nullptr && *str != '\0'; ++str) {
+      if (*str == '"' || *str == '\\')
+        escaped += '\\';
+      if (static_cast<unsigned char>(*str) >= 0x20)
+        escaped += *str;
+    }
+    return escaped;
+  }
+  static std::string escape(const std::string &str) {
+    return escape(str.c_str());
+  }
+};
+
+/**
+ * @brief Records the span from its construction to its destruction
+ */
+class TraceScope {
+public:
+  TraceScope(const char *name, const char *category,
+             const uint32_t frame_seq_num)
+      : m_enabled(Tracer::is_enabled()), m_name(name), m_category(category),
+        m_frame_seq_num(frame_seq_num) {
+    if (m_enabled)
+      m_begin = Tracer::Clock::now();
+  }
+  ~TraceScope() {
+    if (m_enabled)
+      Tracer::record(m_name, m_category, m_begin, Tracer::Clock::now(),
+                     m_frame_seq_num);
+  }
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+  const bool m_enabled;
+  const char *m_name;
+  const char *m_category;
+  const uint32_t m_frame_seq_num;
+  Tracer::Clock::time_point m_begin;
+};
+
+} // namespace MatrixPipeline::Utils
+
+#define TRACE_SCOPE_CONCAT_INNER(a, b) a##b
+#define TRACE_SCOPE_CONCAT(a, b) TRACE_SCOPE_CONCAT_INNER(a, b)
+// name and category must be string literals or Tracer::intern()ed
+#define TRACE_SCOPE(name, category, frame_seq_num)                             \
+  const ::MatrixPipeline::Utils::TraceScope TRACE_SCOPE_CONCAT(                \
+      trace_scope_, __LINE__)(name, category, frame_seq_num)
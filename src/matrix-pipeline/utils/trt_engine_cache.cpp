@@ -0,0 +1,213 @@
+#include "trt_engine_cache.h"
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string_view>
+#include <system_error>
+#include <unistd.h>
+
+namespace MatrixPipeline::Utils {
+
+namespace {
+
+constexpr std::array<char, 8> entry_magic = {'M', 'P', 'T', 'R',
+                                             'T', 'P', 'L', 'N'};
+// Bump whenever the entry layout changes
+constexpr uint32_t entry_format_version = 1;
+
+// FNV-1a, stable across builds and platforms unlike std::hash
+class Fnv1a64 {
+public:
+  void update(const void *data, const size_t size) {
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; ++i) {
+      m_hash ^= bytes[i];
+      m_hash *= 0x100000001b3ULL;
+    }
+  }
+  [[nodiscard]] uint64_t digest() const { return m_hash; }
+
+private:
+  uint64_t m_hash = 0xcbf29ce484222325ULL;
+};
+
+uint64_t hash_bytes(const void *data, const size_t size) {
+  Fnv1a64 hash;
+  hash.update(data, size);
+  return hash.digest();
+}
+
+template <typename T> void write_pod(std::ofstream &file, const T &value) {
+  file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T> bool read_pod(std::ifstream &file, T &value) {
+  return static_cast<bool>(
+      file.read(reinterpret_cast<char *>(&value), sizeof(value)));
+}
+
+} // namespace
+
+std::optional<uint64_t> hash_file(const std::filesystem::path &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    return std::nullopt;
+  Fnv1a64 hash;
+  std::vector<char> buffer(1 << 20);
+  while (file) {
+    file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    hash.update(buffer.data(), static_cast<size_t>(file.gcount()));
+  }
+  if (!file.eof())
+    return std::nullopt;
+  return hash.digest();
+}
+
+TrtEngineCache::TrtEngineCache(std::filesystem::path dir)
+    : m_dir(std::move(dir)) {
+  std::error_code ec;
+  std::filesystem::create_directories(m_dir, ec);
+  if (ec)
+    SPDLOG_WARN("Failed to create TensorRT engine cache dir {}: {}",
+                m_dir.string(), ec.message());
+}
+
+std::optional<TrtEngineCache::Entry>
+TrtEngineCache::get_entry(const TrtEngineCacheKey &key) const {
+  const auto model_hash = hash_file(key.model_path);
+  if (!model_hash.has_value())
+    return std::nullopt;
+  Entry entry;
+  entry.fingerprint = fmt::format(
+      "model={:016x};input={}x{};precision={};batch={};builder={}",
+      *model_hash, key.input_width, key.input_height, key.precision,
+      key.max_batch_size, key.builder_fingerprint);
+  entry.path =
+      m_dir / fmt::format("{}-{:016x}.plan",
+                          std::filesystem::path(key.model_path).stem().string(),
+                          hash_bytes(entry.fingerprint.data(),
+                                     entry.fingerprint.size()));
+  return entry;
+}
+
+std::optional<std::vector<char>> TrtEngineCache::load(const Entry &entry) {
+  std::ifstream file(entry.path, std::ios::binary);
+  if (!file)
+    return std::nullopt;
+  const auto reject = [&entry](const std::string_view reason) {
+    SPDLOG_WARN("TensorRT engine cache entry {} {}, it will be rebuilt",
+                entry.path.string(), reason);
+    std::error_code ec;
+    std::filesystem::remove(entry.path, ec);
+    return std::nullopt;
+  };
+
+  std::array<char, entry_magic.size()> magic{};
+  uint32_t format_version = 0;
+  if (!file.read(magic.data(), magic.size()) || magic != entry_magic ||
+      !read_pod(file, format_version) ||
+      format_version != entry_format_version)
+    return reject("is not in the current format");
+
+  uint64_t fingerprint_size = 0;
+  if (!read_pod(file, fingerprint_size) ||
+      fingerprint_size != entry.fingerprint.size())
+    return reject("belongs to another key");
+  std::string fingerprint(fingerprint_size, '\0');
+  if (!file.read(fingerprint.data(),
+                 static_cast<std::streamsize>(fingerprint_size)) ||
+      fingerprint != entry.fingerprint)
+    return reject("belongs to another key");
+
+  uint64_t plan_size = 0;
+  uint64_t plan_hash = 0;
+  if (!read_pod(file, plan_size) || !read_pod(file, plan_hash))
+    return reject("is truncated");
+  // Checked before allocating, a corrupted size could be anything
+  std::error_code ec;
+  const auto file_size = std::filesystem::file_size(entry.path, ec);
+  const auto header_size = static_cast<uint64_t>(file.tellg());
+  if (ec || file_size < header_size || plan_size != file_size - header_size)
+    return reject("is truncated or has trailing bytes");
+  std::vector<char> plan(plan_size);
+  if (!file.read(plan.data(), static_cast<std::streamsize>(plan_size)) ||
+      file.peek() != std::ifstream::traits_type::eof())
+    return reject("is truncated or has trailing bytes");
+  if (hash_bytes(plan.data(), plan.size()) != plan_hash)
+    return reject("is corrupted");
+  return plan;
+}
+
+void TrtEngineCache::store(const Entry &entry, const std::vector<char> &plan) {
+  // Unique per process and call, s.t. concurrent writers never share one
+  static std::atomic<uint64_t> tmp_seq{0};
+  auto tmp_path = entry.path;
+  tmp_path += fmt::format(".{}.{}.tmp", getpid(), tmp_seq.fetch_add(1));
+  {
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    file.write(entry_magic.data(), entry_magic.size());
+    write_pod(file, entry_format_version);
+    write_pod(file, static_cast<uint64_t>(entry.fingerprint.size()));
+    file.write(entry.fingerprint.data(),
+               static_cast<std::streamsize>(entry.fingerprint.size()));
+    write_pod(file, static_cast<uint64_t>(plan.size()));
+    write_pod(file, hash_bytes(plan.data(), plan.size()));
+    file.write(plan.data(), static_cast<std::streamsize>(plan.size()));
+    file.flush();
+    if (!file) {
+      SPDLOG_WARN("Failed to write TensorRT engine cache entry {}",
+                  tmp_path.string());
+      std::error_code ec;
+      std::filesystem::remove(tmp_path, ec);
+      return;
+    }
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp_path, entry.path, ec);
+  if (ec) {
+    SPDLOG_WARN("Failed to move TensorRT engine cache entry into {}: {}",
+                entry.path.string(), ec.message());
+    std::filesystem::remove(tmp_path, ec);
+    return;
+  }
+  SPDLOG_INFO("TensorRT plan ({} bytes) cached as {}", plan.size(),
+              entry.path.string());
+}
+
+std::vector<char> TrtEngineCache::get_or_build(const TrtEngineCacheKey &key,
+                                               const PlanBuilder &build_plan) {
+  const auto entry = get_entry(key);
+  if (!entry.has_value()) {
+    SPDLOG_ERROR("Failed to read model {}", key.model_path);
+    return {};
+  }
+  if (auto plan = load(*entry); plan.has_value()) {
+    SPDLOG_INFO("TensorRT plan of {} loaded from {}", key.model_path,
+                entry->path.string());
+    return std::move(*plan);
+  }
+  SPDLOG_INFO("No cached TensorRT plan of {} ({}), building it",
+              key.model_path, entry->fingerprint);
+  auto plan = build_plan();
+  if (!plan.empty())
+    store(*entry, plan);
+  return plan;
+}
+
+void TrtEngineCache::invalidate(const TrtEngineCacheKey &key) {
+  const auto entry = get_entry(key);
+  if (!entry.has_value())
+    return;
+  std::error_code ec;
+  if (std::filesystem::remove(entry->path, ec))
+    SPDLOG_WARN("TensorRT engine cache entry {} invalidated",
+                entry->path.string());
+}
+
+} // namespace MatrixPipeline::Utils
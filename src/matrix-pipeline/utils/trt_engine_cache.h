@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace MatrixPipeline::Utils {
+
+// Everything a serialized TensorRT plan depends on
+struct TrtEngineCacheKey {
+  // Hashed by content, s.t. replacing the model invalidates its entries
+  std::string model_path;
+  int input_width = 0;
+  int input_height = 0;
+  // e.g., "fp32", the builder flags the plan was built with and anything else
+  // it depends on, say, the INT8 calibration table
+  std::string precision;
+  // Of the optimization profile, if the model has a dynamic batch dimension
+  int max_batch_size = 1;
+  // TensorRT version and device, see get_trt_builder_fingerprint()
+  std::string builder_fingerprint;
+};
+
+// FNV-1a of the file's content, nullopt if it can't be read
+std::optional<uint64_t> hash_file(const std::filesystem::path &path);
+
+/**
+ * @brief An on-disk cache of serialized TensorRT plans, s.t. an engine is
+ * only built (which could take minutes) the first time a model is used on a
+ * given device and TensorRT version, not on every start.
+ *
+ * Entries are named after a hash of the whole key and also store the key
+ * itself and a checksum of the plan: one that doesn't match (truncated,
+ * corrupted, from a hash collision, etc.) is removed and rebuilt. Entries are
+ * written to a temporary file first and renamed into place, i.e., a reader
+ * (possibly another process) sees either a complete entry or none.
+ *
+ * It knows nothing about TensorRT or CUDA, plans are built by the injected
+ * PlanBuilder.
+ */
+class TrtEngineCache {
+public:
+  // Returns the serialized plan, empty on failure
+  using PlanBuilder = std::function<std::vector<char>()>;
+
+  // Created if it doesn't exist
+  explicit TrtEngineCache(std::filesystem::path dir);
+
+  /**
+   * @brief Returns the cached plan of key, or the one build_plan() returns,
+   * which is then cached. Empty if the model can't be read or build_plan()
+   * fails
+   */
+  std::vector<char> get_or_build(const TrtEngineCacheKey &key,
+                                 const PlanBuilder &build_plan);
+
+  /**
+   * @brief Removes the entry of key, e.g., if TensorRT refused to
+   * deserialize it
+   */
+  void invalidate(const TrtEngineCacheKey &key);
+
+private:
+  struct Entry {
+    std::filesystem::path path;
+    std::string fingerprint;
+  };
+
+  // nullopt if the model can't be read
+  [[nodiscard]] std::optional<Entry>
+  get_entry(const TrtEngineCacheKey &key) const;
+  [[nodiscard]] static std::optional<std::vector<char>>
+  load(const Entry &entry);
+  static void store(const Entry &entry, const std::vector<char> &plan);
+
+  std::filesystem::path m_dir;
+};
+
+} // namespace MatrixPipeline::Utils
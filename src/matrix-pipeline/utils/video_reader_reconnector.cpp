@@ -0,0 +1,300 @@
+#include "video_reader_reconnector.h"
+
+#include <spdlog/spdlog.h>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <map>
+
+namespace MatrixPipeline::Utils {
+
+namespace {
+
+// Upper bounds in seconds, from a stream that is back right away to one that
+// was down for the whole max_backoff (10 min by default)
+constexpr std::array<double, 10> reconnect_latency_bounds{
+    0.5, 1, 2.5, 5, 10, 30, 60, 120, 300, 600};
+
+/**
+ * @brief Checks if a TCP connection to host:port can be established within
+ * timeout, without sending anything.
+ */
+bool probe_tcp(const std::string &host, const std::string &port,
+               const std::chrono::milliseconds timeout) {
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *res = nullptr;
+  if (const int ret = getaddrinfo(host.c_str(), port.c_str(), &hints, &res);
+      ret != 0) {
+    SPDLOG_WARN("getaddrinfo({}:{}) failed: {}", host, port,
+                gai_strerror(ret));
+    return false;
+  }
+  bool reachable = false;
+  for (const addrinfo *ai = res; ai != nullptr && !reachable;
+       ai = ai->ai_next) {
+    const int fd =
+        socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK, ai->ai_protocol);
+    if (fd < 0)
+      continue;
+    if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+      reachable = true;
+    } else if (errno == EINPROGRESS) {
+      pollfd pfd{.fd = fd, .events = POLLOUT, .revents = 0};
+      if (poll(&pfd, 1, static_cast<int>(timeout.count())) == 1) {
+        int so_error = 0;
+        socklen_t len = sizeof(so_error);
+        reachable =
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &so_error, &len) == 0 &&
+            so_error == 0;
+      }
+    }
+    close(fd);
+  }
+  freeaddrinfo(res);
+  return reachable;
+}
+
+} // namespace
+
+VideoReaderReconnector::VideoReaderReconnector(std::string uri,
+                                               std::string device_name,
+                                               const Config config)
+    : m_uri(std::move(uri)), m_device_name(std::move(device_name)),
+      m_config(config),
+      m_attempt_count(MetricsRegistry::instance().counter(
+          "matrix_pipeline_device_reconnect_attempts_total",
+          "Probes and opens of the device's video reader, failed ones "
+          "included",
+          {{"device", m_device_name}})),
+      m_reconnect_count(MetricsRegistry::instance().counter(
+          "matrix_pipeline_device_reconnects_total",
+          "Successful reconnects of the device's video reader",
+          {{"device", m_device_name}})),
+      m_reconnect_latency(MetricsRegistry::instance().histogram(
+          "matrix_pipeline_device_reconnect_latency_seconds",
+          "Time from a failure of the device's video reader being reported "
+          "to a new one being ready",
+          {{"device", m_device_name}}, reconnect_latency_bounds)) {}
+
+VideoReaderReconnector::~VideoReaderReconnector() { stop(); }
+
+void VideoReaderReconnector::start() {
+  {
+    std::lock_guard lock(m_worker_mutex);
+    if (m_running)
+      return;
+    m_running = true;
+  }
+  m_worker_thread = std::thread(&VideoReaderReconnector::worker_loop, this);
+}
+
+void VideoReaderReconnector::stop() {
+  {
+    std::lock_guard lock(m_worker_mutex);
+    m_running = false;
+  }
+  m_worker_cv.notify_all();
+  if (m_worker_thread.joinable())
+    m_worker_thread.join();
+  m_reader.store(nullptr, std::memory_order_release);
+}
+
+void VideoReaderReconnector::report_failure() {
+  if (m_state.load(std::memory_order_relaxed) != State::Connected)
+    return;
+  {
+    std::lock_guard lock(m_worker_mutex);
+    m_failure_reported = true;
+  }
+  m_worker_cv.notify_all();
+}
+
+const char *VideoReaderReconnector::state_to_string(const State state) {
+  switch (state) {
+  case State::Probing:
+    return "Probing";
+  case State::Opening:
+    return "Opening";
+  case State::Connected:
+    return "Connected";
+  case State::BackingOff:
+    return "BackingOff";
+  }
+  return "Unknown";
+}
+
+void VideoReaderReconnector::worker_loop() {
+  using namespace std::chrono;
+  uint32_t consecutive_failures = 0;
+  auto disconnected_since = steady_clock::now();
+  auto set_state = [this](const State state) {
+    SPDLOG_DEBUG("[{}] {} -> {}", m_device_name,
+                 state_to_string(m_state.load()), state_to_string(state));
+    m_state.store(state, std::memory_order_relaxed);
+  };
+
+  while (true) {
+    switch (m_state.load(std::memory_order_relaxed)) {
+    case State::Probing:
+      m_attempt_count->inc();
+      if (probe()) {
+        set_state(State::Opening);
+      } else {
+        ++consecutive_failures;
+        set_state(State::BackingOff);
+      }
+      break;
+    case State::Opening:
+      m_attempt_count->inc();
+      if (auto reader = open()) {
+        m_reader.store(std::move(reader), std::memory_order_release);
+        const auto latency =
+            duration_cast<milliseconds>(steady_clock::now() -
+                                        disconnected_since);
+        // The first connect isn't a reconnect, its latency is the startup's
+        if (m_success_count.fetch_add(1, std::memory_order_relaxed) > 0) {
+          m_reconnect_count->inc();
+          m_reconnect_latency->observe(latency);
+        }
+        SPDLOG_INFO("[{}] video reader connected, failed attempts: {}, "
+                    "reconnect_latency(ms): {}",
+                    m_device_name, consecutive_failures, latency.count());
+        consecutive_failures = 0;
+        set_state(State::Connected);
+      } else {
+        ++consecutive_failures;
+        set_state(State::BackingOff);
+      }
+      break;
+    case State::Connected: {
+      std::unique_lock lock(m_worker_mutex);
+      m_worker_cv.wait(lock,
+                       [this] { return !m_running || m_failure_reported; });
+      if (!m_running)
+        return;
+      m_failure_reported = false;
+      lock.unlock();
+      m_reader.store(nullptr, std::memory_order_release);
+      disconnected_since = steady_clock::now();
+      SPDLOG_WARN("[{}] video reader failure reported, reconnecting",
+                  m_device_name);
+      set_state(State::BackingOff);
+      break;
+    }
+    case State::BackingOff: {
+      const auto delay = next_backoff(consecutive_failures);
+      SPDLOG_INFO("[{}] consecutive_failures: {}, next attempt in {} ms",
+                  m_device_name, consecutive_failures, delay.count());
+      if (!wait_for(delay))
+        return;
+      set_state(State::Probing);
+      break;
+    }
+    }
+
+    std::lock_guard lock(m_worker_mutex);
+    if (!m_running)
+      return;
+  }
+}
+
+bool VideoReaderReconnector::wait_for(
+    const std::chrono::milliseconds duration) {
+  std::unique_lock lock(m_worker_mutex);
+  return !m_worker_cv.wait_for(lock, duration, [this] { return !m_running; });
+}
+
+std::chrono::milliseconds
+VideoReaderReconnector::next_backoff(const uint32_t consecutive_failures) {
+  // Exponential backoff capped at max_backoff, with "equal jitter": the
+  // actual delay is uniformly distributed in [backoff / 2, backoff]
+  const auto exponent = std::min<uint32_t>(consecutive_failures, 20);
+  const auto backoff =
+      std::min(m_config.initial_backoff * (int64_t{1} << exponent),
+               m_config.max_backoff);
+  std::uniform_int_distribution<int64_t> dist(backoff.count() / 2,
+                                              backoff.count());
+  return std::chrono::milliseconds(dist(m_rng));
+}
+
+bool VideoReaderReconnector::probe() const {
+  const auto scheme_end = m_uri.find("://");
+  if (scheme_end == std::string::npos || m_uri.starts_with("file://")) {
+    // A local file or device, e.g., /dev/video0
+    const auto path = scheme_end == std::string::npos
+                          ? m_uri
+                          : m_uri.substr(scheme_end + 3);
+    struct stat st{};
+    if (stat(path.c_str(), &st) != 0) {
+      SPDLOG_WARN("[{}] probe failed, stat({}) failed", m_device_name, path);
+      return false;
+    }
+    return true;
+  }
+
+  static const std::map<std::string, std::string> default_ports = {
+      {"rtsp", "554"}, {"rtsps", "322"}, {"rtmp", "1935"},
+      {"http", "80"},  {"https", "443"}};
+  const auto scheme = m_uri.substr(0, scheme_end);
+  const auto port_it = default_ports.find(scheme);
+  if (port_it == default_ports.end())
+    // Don't know how to probe it cheaply, let createVideoReader() decide
+    return true;
+
+  auto authority = m_uri.substr(scheme_end + 3);
+  authority = authority.substr(0, authority.find_first_of("/?#"));
+  if (const auto at_pos = authority.rfind('@'); at_pos != std::string::npos)
+    authority = authority.substr(at_pos + 1);
+  std::string host = authority;
+  std::string port = port_it->second;
+  if (authority.starts_with('[')) {
+    // IPv6 literal, e.g., [::1]:554
+    const auto bracket_end = authority.find(']');
+    host = authority.substr(1, bracket_end - 1);
+    if (bracket_end + 1 < authority.size() && authority[bracket_end + 1] == ':')
+      port = authority.substr(bracket_end + 2);
+  } else if (const auto colon_pos = authority.rfind(':');
+             colon_pos != std::string::npos) {
+    host = authority.substr(0, colon_pos);
+    port = authority.substr(colon_pos + 1);
+  }
+
+  if (!probe_tcp(host, port, m_config.probe_timeout)) {
+    SPDLOG_WARN("[{}] probe failed, {}:{} is not reachable", m_device_name,
+                host, port);
+    return false;
+  }
+  return true;
+}
+
+std::shared_ptr<cv::cudacodec::VideoReader>
+VideoReaderReconnector::open() const {
+  SPDLOG_INFO("[{}] about to invoke cv::cudacodec::createVideoReader()",
+              m_device_name);
+  auto params = cv::cudacodec::VideoReaderInitParams();
+  // https://docs.opencv.org/4.9.0/dd/d7d/structcv_1_1cudacodec_1_1VideoReaderInitParams.html
+  params.allowFrameDrop = true;
+  try {
+    cv::Ptr<cv::cudacodec::VideoReader> reader =
+        cv::cudacodec::createVideoReader(m_uri, {}, params);
+    if (!reader)
+      throw std::runtime_error("!reader");
+    reader->set(cv::cudacodec::ColorFormat::BGR);
+    return reader;
+  } catch (const std::exception &e) {
+    SPDLOG_ERROR("[{}] cudacodec::createVideoReader() failed: {}",
+                 m_device_name, e.what());
+    return nullptr;
+  }
+}
+
+} // namespace MatrixPipeline::Utils
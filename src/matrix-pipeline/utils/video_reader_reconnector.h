@@ -0,0 +1,108 @@
+#pragma once
+
+#include "metrics.h"
+
+#include <opencv2/cudacodec.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+
+namespace MatrixPipeline::Utils {
+
+/**
+ * @brief Owns the cv::cudacodec::VideoReader of a device and (re)connects it
+ * on a single long-lived worker thread.
+ *
+ * The worker is an explicit state machine:
+ *   Probing -> Opening -> Connected -> (failure reported) -> BackingOff
+ *      ^                                                          |
+ *      +----------------------------------------------------------+
+ * Probing is a cheap liveness check (TCP connect for network streams, stat()
+ * for files/devices) so that we don't pay for a full createVideoReader()
+ * while the source is obviously down. Backoff grows exponentially with
+ * "equal jitter" (half of it fixed, half of it random) s.t. many cameras
+ * behind the same failed switch don't retry in lockstep.
+ *
+ * The capture loop never waits on a lock: it reads the current reader via
+ * an atomic shared_ptr load, the worker publishes a new one via an atomic
+ * store.
+ */
+class VideoReaderReconnector {
+public:
+  enum class State { Probing, Opening, Connected, BackingOff };
+
+  struct Config {
+    std::chrono::milliseconds initial_backoff{2000};
+    std::chrono::milliseconds max_backoff{600'000};
+    std::chrono::milliseconds probe_timeout{2000};
+  };
+
+  VideoReaderReconnector(std::string uri, std::string device_name,
+                         Config config);
+  ~VideoReaderReconnector();
+
+  void start();
+  void stop();
+
+  /**
+   * @brief Returns the current reader, nullptr while (re)connecting.
+   * Lock-free, intended to be called by the capture loop for every frame.
+   */
+  [[nodiscard]] std::shared_ptr<cv::cudacodec::VideoReader> get_reader() const {
+    return m_reader.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief Called by the capture loop when the current reader fails to deliver
+   * a valid frame. Drops the reader and wakes up the worker to reconnect.
+   */
+  void report_failure();
+
+  [[nodiscard]] State get_state() const {
+    return m_state.load(std::memory_order_relaxed);
+  }
+  [[nodiscard]] uint64_t get_success_count() const {
+    return m_success_count.load(std::memory_order_relaxed);
+  }
+
+  static const char *state_to_string(State state);
+
+private:
+  const std::string m_uri;
+  const std::string m_device_name;
+  const Config m_config;
+
+  std::atomic<std::shared_ptr<cv::cudacodec::VideoReader>> m_reader;
+  std::atomic<State> m_state{State::Probing};
+  std::atomic<uint64_t> m_success_count{0};
+  // Probes and opens, successful or not
+  std::shared_ptr<Counter> m_attempt_count;
+  // Successful connects but the first one
+  std::shared_ptr<Counter> m_reconnect_count;
+  // Time between the failure being reported and the new reader being ready
+  std::shared_ptr<Histogram> m_reconnect_latency;
+
+  std::thread m_worker_thread;
+  std::mutex m_worker_mutex;
+  std::condition_variable m_worker_cv;
+  bool m_running = false;
+  bool m_failure_reported = false;
+  std::mt19937 m_rng{std::random_device{}()};
+
+  void worker_loop();
+  // Returns false if the worker should exit
+  bool wait_for(std::chrono::milliseconds duration);
+  [[nodiscard]] std::chrono::milliseconds
+  next_backoff(uint32_t consecutive_failures);
+  [[nodiscard]] bool probe() const;
+  [[nodiscard]] std::shared_ptr<cv::cudacodec::VideoReader> open() const;
+};
+
+} // namespace MatrixPipeline::Utils
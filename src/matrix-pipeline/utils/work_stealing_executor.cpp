@@ -0,0 +1,120 @@
+#include "work_stealing_executor.h"
+
+#include <spdlog/spdlog.h>
+
+namespace MatrixPipeline::Utils {
+
+namespace {
+std::unique_ptr<WorkStealingExecutor> s_instance;
+// Set on the executor's own workers only
+thread_local const WorkStealingExecutor *t_executor = nullptr;
+thread_local size_t t_worker_idx = 0;
+} // namespace
+
+void WorkStealingExecutor::init(const size_t thread_count) {
+  s_instance = std::make_unique<WorkStealingExecutor>(
+      thread_count > 0 ? thread_count
+                       : std::max(1u, std::thread::hardware_concurrency()));
+}
+
+WorkStealingExecutor *WorkStealingExecutor::get_instance() {
+  return s_instance.get();
+}
+
+void WorkStealingExecutor::shutdown() { s_instance = nullptr; }
+
+WorkStealingExecutor::WorkStealingExecutor(const size_t thread_count) {
+  m_workers.reserve(thread_count);
+  for (size_t i = 0; i < thread_count; ++i)
+    m_workers.push_back(std::make_unique<Worker>());
+  // Only start the threads once m_workers is complete, they steal from it
+  for (size_t i = 0; i < thread_count; ++i)
+    m_workers[i]->thread =
+        std::thread(&WorkStealingExecutor::worker_loop, this, i);
+  SPDLOG_INFO("WorkStealingExecutor started with {} threads", thread_count);
+}
+
+WorkStealingExecutor::~WorkStealingExecutor() {
+  m_stopping.store(true);
+  m_task_available.notify_all();
+  for (const auto &worker : m_workers) {
+    if (worker->thread.joinable())
+      worker->thread.join();
+  }
+  SPDLOG_INFO("WorkStealingExecutor stopped, tasks(executed/stolen): {}/{}",
+              m_executed_count.load(), m_stolen_count.load());
+}
+
+bool WorkStealingExecutor::is_worker_thread() const {
+  return t_executor == this;
+}
+
+void WorkStealingExecutor::submit(Task task) {
+  const auto idx =
+      is_worker_thread()
+          ? t_worker_idx
+          : m_next_worker.fetch_add(1, std::memory_order_relaxed) %
+                m_workers.size();
+  {
+    std::lock_guard lock(m_workers[idx]->mutex);
+    m_workers[idx]->tasks.push_back(std::move(task));
+  }
+  m_pending_count.fetch_add(1);
+  m_task_available.notify_one();
+}
+
+bool WorkStealingExecutor::try_take_task(const size_t idx, Task &task) {
+  {
+    auto &own = *m_workers[idx];
+    std::lock_guard lock(own.mutex);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      m_pending_count.fetch_sub(1);
+      return true;
+    }
+  }
+  for (size_t i = 1; i < m_workers.size(); ++i) {
+    auto &victim = *m_workers[(idx + i) % m_workers.size()];
+    std::lock_guard lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      m_pending_count.fetch_sub(1);
+      m_stolen_count.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingExecutor::run_task(Task &task) {
+  try {
+    task();
+  } catch (const std::exception &e) {
+    SPDLOG_ERROR("task threw an exception: {}", e.what());
+  }
+  m_executed_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void WorkStealingExecutor::worker_loop(const size_t idx) {
+  using namespace std::chrono_literals;
+  t_executor = this;
+  t_worker_idx = idx;
+  while (true) {
+    if (Task task; try_take_task(idx, task)) {
+      run_task(task);
+      continue;
+    }
+    if (m_stopping.load() && m_pending_count.load() == 0)
+      break;
+    const auto epoch = m_task_available.prepare_wait();
+    if (m_pending_count.load() > 0 || m_stopping.load()) {
+      m_task_available.cancel_wait();
+      continue;
+    }
+    m_task_available.wait_for(epoch, 100ms);
+  }
+}
+
+} // namespace MatrixPipeline::Utils
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "futex_event.h"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace MatrixPipeline::Utils {
+
+/**
+ * @brief A process-wide pool of worker threads, sized to the core count by
+ * default, that asynchronous units can schedule their work on instead of
+ * each owning a mostly idle thread.
+ *
+ * Each worker has its own deque: it pushes and pops tasks it submits itself
+ * at the back (hot caches), and when it runs dry it steals from the front of
+ * the other workers' deques. Tasks submitted from outside the pool are spread
+ * round-robin.
+ *
+ * The executor knows nothing about ordering, callers needing tasks to be
+ * serialized (e.g., one unit's frames) must not have more than one of them
+ * pending at a time.
+ */
+class WorkStealingExecutor {
+public:
+  using Task = std::function<void()>;
+
+  /**
+   * @brief Creates the process-wide instance, thread_count == 0 means one
+   * worker per core. Must be called before any unit is start()ed.
+   */
+  static void init(size_t thread_count);
+  // nullptr unless init() has been called, i.e., units use dedicated threads
+  static WorkStealingExecutor *get_instance();
+  // Runs all pending tasks, then joins the workers
+  static void shutdown();
+
+  explicit WorkStealingExecutor(size_t thread_count);
+  ~WorkStealingExecutor();
+  WorkStealingExecutor(const WorkStealingExecutor &) = delete;
+  WorkStealingExecutor &operator=(const WorkStealingExecutor &) = delete;
+
+  // Tasks may block, but must not run other pending tasks meanwhile (a
+  // nested one could wait for the very task it is nested in). A unit waiting
+  // for a full queue drains that queue itself instead
+  void submit(Task task);
+  [[nodiscard]] bool is_worker_thread() const;
+  [[nodiscard]] size_t get_thread_count() const { return m_workers.size(); }
+
+private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+    std::thread thread;
+  };
+
+  std::vector<std::unique_ptr<Worker>> m_workers;
+  std::atomic<bool> m_stopping{false};
+  std::atomic<size_t> m_next_worker{0};
+  std::atomic<size_t> m_pending_count{0};
+  std::atomic<uint64_t> m_executed_count{0};
+  std::atomic<uint64_t> m_stolen_count{0};
+  FutexEvent m_task_available;
+
+  void worker_loop(size_t idx);
+  bool try_take_task(size_t idx, Task &task);
+  void run_task(Task &task);
+};
+
+} // namespace MatrixPipeline::Utils
@@ -0,0 +1,227 @@
+#include "yolo_decoder.h"
+
+#include <fmt/format.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define MATRIX_PIPELINE_YOLO_DECODER_X86
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+
+namespace MatrixPipeline::Utils {
+
+namespace {
+
+struct DecoderArgs {
+  const float *output;
+  int class_count;
+  int anchor_count;
+  const float *class_thresholds;
+  // The lowest of class_thresholds, what the vectorized scans compare with
+  float min_threshold;
+  YoloCandidates *candidates;
+
+  // Row row of the output, e.g., 0 for cx and 4 for the first class' scores
+  [[nodiscard]] const float *get_row(const int row) const {
+    return output + static_cast<size_t>(row) * anchor_count;
+  }
+};
+
+// Only called for scores above min_threshold, i.e., for few anchors
+void add_candidate(const DecoderArgs &args, const int anchor,
+                   const float score, const int class_id) {
+  if (score <= args.class_thresholds[class_id])
+    return;
+  args.candidates->add(args.get_row(0)[anchor], args.get_row(1)[anchor],
+                       args.get_row(2)[anchor], args.get_row(3)[anchor], score,
+                       class_id);
+}
+
+// Anchors [begin, end), in blocks the compiler can vectorize for the baseline
+// instruction set
+void decode_scalar(const DecoderArgs &args, const int begin, const int end) {
+  constexpr int block = 64;
+  std::array<float, block> max_scores;
+  std::array<int, block> best_class_ids;
+  for (int first = begin; first < end; first += block) {
+    const int count = std::min(block, end - first);
+    std::copy_n(args.get_row(4) + first, count, max_scores.begin());
+    std::fill_n(best_class_ids.begin(), count, 0);
+    for (int c = 1; c < args.class_count; ++c) {
+      const float *scores = args.get_row(4 + c) + first;
+      // Branchless, s.t. it vectorizes
+      for (int i = 0; i < count; ++i) {
+        const bool greater = scores[i] > max_scores[i];
+        max_scores[i] = greater ? scores[i] : max_scores[i];
+        best_class_ids[i] = greater ? c : best_class_ids[i];
+      }
+    }
+    for (int i = 0; i < count; ++i) {
+      if (max_scores[i] > args.min_threshold)
+        add_candidate(args, first + i, max_scores[i], best_class_ids[i]);
+    }
+  }
+}
+
+#ifdef MATRIX_PIPELINE_YOLO_DECODER_X86
+
+// A block is a few independent vectors of anchors, s.t. their compare/blend
+// chains overlap instead of each waiting for the previous class'
+
+// Returns the end of the anchors decoded, the rest is left to decode_scalar()
+__attribute__((target("avx2"))) int decode_avx2(const DecoderArgs &args) {
+  constexpr int lanes = 8;
+  constexpr int vectors = 4;
+  constexpr int block = lanes * vectors;
+  const int end = args.anchor_count / block * block;
+  const __m256 threshold = _mm256_set1_ps(args.min_threshold);
+  for (int first = 0; first < end; first += block) {
+    __m256 max_scores[vectors];
+    __m256i best_class_ids[vectors];
+    for (int k = 0; k < vectors; ++k) {
+      max_scores[k] = _mm256_loadu_ps(args.get_row(4) + first + k * lanes);
+      best_class_ids[k] = _mm256_setzero_si256();
+    }
+    for (int c = 1; c < args.class_count; ++c) {
+      const float *scores = args.get_row(4 + c) + first;
+      const __m256i class_id = _mm256_set1_epi32(c);
+      for (int k = 0; k < vectors; ++k) {
+        const __m256 score = _mm256_loadu_ps(scores + k * lanes);
+        const __m256 greater =
+            _mm256_cmp_ps(score, max_scores[k], _CMP_GT_OQ);
+        max_scores[k] = _mm256_blendv_ps(max_scores[k], score, greater);
+        best_class_ids[k] = _mm256_blendv_epi8(
+            best_class_ids[k], class_id, _mm256_castps_si256(greater));
+      }
+    }
+    for (int k = 0; k < vectors; ++k) {
+      auto mask = static_cast<unsigned>(_mm256_movemask_ps(
+          _mm256_cmp_ps(max_scores[k], threshold, _CMP_GT_OQ)));
+      if (mask == 0)
+        continue;
+      alignas(32) std::array<float, lanes> lane_scores;
+      alignas(32) std::array<int, lanes> lane_class_ids;
+      _mm256_store_ps(lane_scores.data(), max_scores[k]);
+      _mm256_store_si256(reinterpret_cast<__m256i *>(lane_class_ids.data()),
+                         best_class_ids[k]);
+      for (; mask != 0; mask &= mask - 1) {
+        const int lane = __builtin_ctz(mask);
+        add_candidate(args, first + k * lanes + lane, lane_scores[lane],
+                      lane_class_ids[lane]);
+      }
+    }
+  }
+  return end;
+}
+
+__attribute__((target("avx512f"))) int decode_avx512(const DecoderArgs &args) {
+  constexpr int lanes = 16;
+  constexpr int vectors = 4;
+  constexpr int block = lanes * vectors;
+  const int end = args.anchor_count / block * block;
+  const __m512 threshold = _mm512_set1_ps(args.min_threshold);
+  for (int first = 0; first < end; first += block) {
+    __m512 max_scores[vectors];
+    __m512i best_class_ids[vectors];
+    for (int k = 0; k < vectors; ++k) {
+      max_scores[k] = _mm512_loadu_ps(args.get_row(4) + first + k * lanes);
+      best_class_ids[k] = _mm512_setzero_si512();
+    }
+    for (int c = 1; c < args.class_count; ++c) {
+      const float *scores = args.get_row(4 + c) + first;
+      const __m512i class_id = _mm512_set1_epi32(c);
+      for (int k = 0; k < vectors; ++k) {
+        const __m512 score = _mm512_loadu_ps(scores + k * lanes);
+        const __mmask16 greater =
+            _mm512_cmp_ps_mask(score, max_scores[k], _CMP_GT_OQ);
+        max_scores[k] = _mm512_mask_blend_ps(greater, max_scores[k], score);
+        best_class_ids[k] =
+            _mm512_mask_blend_epi32(greater, best_class_ids[k], class_id);
+      }
+    }
+    for (int k = 0; k < vectors; ++k) {
+      unsigned mask =
+          _mm512_cmp_ps_mask(max_scores[k], threshold, _CMP_GT_OQ);
+      if (mask == 0)
+        continue;
+      alignas(64) std::array<float, lanes> lane_scores;
+      alignas(64) std::array<int, lanes> lane_class_ids;
+      _mm512_store_ps(lane_scores.data(), max_scores[k]);
+      _mm512_store_si512(lane_class_ids.data(), best_class_ids[k]);
+      for (; mask != 0; mask &= mask - 1) {
+        const int lane = __builtin_ctz(mask);
+        add_candidate(args, first + k * lanes + lane, lane_scores[lane],
+                      lane_class_ids[lane]);
+      }
+    }
+  }
+  return end;
+}
+
+#endif
+
+} // namespace
+
+std::string yolo_decoder_isa_to_string(const YoloDecoderIsa isa) {
+  switch (isa) {
+  case YoloDecoderIsa::scalar:
+    return "scalar";
+  case YoloDecoderIsa::avx2:
+    return "avx2";
+  case YoloDecoderIsa::avx512:
+    return "avx512";
+  }
+  return "unknown";
+}
+
+YoloDecoderIsa get_best_yolo_decoder_isa() {
+#ifdef MATRIX_PIPELINE_YOLO_DECODER_X86
+  static const auto isa = [] {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+      return YoloDecoderIsa::avx512;
+    if (__builtin_cpu_supports("avx2"))
+      return YoloDecoderIsa::avx2;
+    return YoloDecoderIsa::scalar;
+  }();
+  return isa;
+#else
+  return YoloDecoderIsa::scalar;
+#endif
+}
+
+void decode_yolo_output(const float *output, const int dimensions,
+                        const int anchor_count,
+                        const std::span<const float> class_thresholds,
+                        YoloCandidates &candidates, YoloDecoderIsa isa) {
+  candidates.clear();
+  if (dimensions <= 4 || anchor_count <= 0)
+    return;
+  if (class_thresholds.size() != static_cast<size_t>(dimensions - 4))
+    throw std::invalid_argument(
+        fmt::format("{} class thresholds for {} classes",
+                    class_thresholds.size(), dimensions - 4));
+  const DecoderArgs args{
+      .output = output,
+      .class_count = dimensions - 4,
+      .anchor_count = anchor_count,
+      .class_thresholds = class_thresholds.data(),
+      .min_threshold = std::ranges::min(class_thresholds),
+      .candidates = &candidates};
+  // Never more than the CPU can run
+  isa = std::min(isa, get_best_yolo_decoder_isa());
+  int vectorized_end = 0;
+#ifdef MATRIX_PIPELINE_YOLO_DECODER_X86
+  if (isa == YoloDecoderIsa::avx512)
+    vectorized_end = decode_avx512(args);
+  else if (isa == YoloDecoderIsa::avx2)
+    vectorized_end = decode_avx2(args);
+#endif
+  decode_scalar(args, vectorized_end, anchor_count);
+}
+
+} // namespace MatrixPipeline::Utils
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <opencv2/core/types.hpp>
+
+#include <span>
+#include <string>
+#include <vector>
+
+namespace MatrixPipeline::Utils {
+
+// Anchors whose best class score passed the confidence threshold, in anchor
+// order and in inference input space
+struct YoloCandidates {
+  std::vector<cv::Rect> boxes;
+  // Must be float as mandated by cv::dnn::NMSBoxes
+  std::vector<float> confidences;
+  std::vector<int> class_ids;
+
+  // c in cx/cy means center
+  void add(const float cx, const float cy, const float w, const float h,
+           const float confidence, const int class_id) {
+    boxes.emplace_back(static_cast<int>(cx - 0.5f * w),
+                       static_cast<int>(cy - 0.5f * h), static_cast<int>(w),
+                       static_cast<int>(h));
+    confidences.push_back(confidence);
+    class_ids.push_back(class_id);
+  }
+  void clear() {
+    boxes.clear();
+    confidences.clear();
+    class_ids.clear();
+  }
+  [[nodiscard]] size_t size() const { return boxes.size(); }
+};
+
+enum class YoloDecoderIsa { scalar, avx2, avx512 };
+
+std::string yolo_decoder_isa_to_string(YoloDecoderIsa isa);
+
+// The widest instruction set both the build and the CPU support
+YoloDecoderIsa get_best_yolo_decoder_isa();
+
+/**
+ * @brief Decodes a YOLOv8/YOLO11 detection output as the engine writes it,
+ * i.e., channel-major: dimensions rows (cx, cy, w, h, then one score per
+ * class) of anchor_count floats each, e.g., 84 x 8400.
+ *
+ * Rather than transposing it first, each class row is scanned across the
+ * anchors, keeping every anchor's best score and class in SIMD registers;
+ * boxes are only read for anchors whose best score is above its class'
+ * threshold. The result is the same whatever the isa, ties go to the lowest
+ * class id. It is also the reference YoloDeviceDecoder's results must equal.
+ *
+ * @param class_thresholds the confidence threshold of each class, i.e.,
+ * dimensions - 4 of them
+ * @param candidates cleared first, its capacity is reused
+ */
+void decode_yolo_output(const float *output, int dimensions, int anchor_count,
+                        std::span<const float> class_thresholds,
+                        YoloCandidates &candidates,
+                        YoloDecoderIsa isa = get_best_yolo_decoder_isa());
+
+} // namespace MatrixPipeline::Utils
@@ -0,0 +1,139 @@
+#include "yolo_device_decoder.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace MatrixPipeline::Utils {
+
+namespace {
+
+constexpr int threads_per_block = 256;
+constexpr unsigned full_warp = 0xffffffffu;
+
+// One thread per anchor, s.t. a warp reads each class row coalesced
+__global__ void decode_yolo_output_kernel(
+    const float *__restrict__ output, const int class_count,
+    const int anchor_count, const float *__restrict__ class_thresholds,
+    uint32_t *__restrict__ count, YoloDeviceCandidate *candidates) {
+  const int anchor = blockIdx.x * blockDim.x + threadIdx.x;
+  bool passed = false;
+  float best_score = 0.0f;
+  int best_class_id = 0;
+  if (anchor < anchor_count) {
+    const float *scores = output + 4 * static_cast<size_t>(anchor_count);
+    best_score = scores[anchor];
+    for (int c = 1; c < class_count; ++c) {
+      const float score =
+          scores[static_cast<size_t>(c) * anchor_count + anchor];
+      // Strictly greater, s.t. ties go to the lowest class id as on the CPU
+      if (score > best_score) {
+        best_score = score;
+        best_class_id = c;
+      }
+    }
+    passed = best_score > class_thresholds[best_class_id];
+  }
+
+  // Out-of-range threads took part in the ballot too, so every warp is full.
+  // One atomicAdd() per warp reserves the slots of all its passed lanes
+  const unsigned passed_lanes = __ballot_sync(full_warp, passed);
+  if (passed_lanes == 0)
+    return;
+  const unsigned lane = threadIdx.x % warpSize;
+  const unsigned leader = __ffs(passed_lanes) - 1;
+  uint32_t first_slot = 0;
+  if (lane == leader)
+    first_slot = atomicAdd(count, __popc(passed_lanes));
+  first_slot = __shfl_sync(full_warp, first_slot, leader);
+  if (!passed)
+    return;
+  const uint32_t slot =
+      first_slot + __popc(passed_lanes & ((1u << lane) - 1));
+  candidates[slot] = {output[anchor],
+                      output[anchor_count + anchor],
+                      output[2 * static_cast<size_t>(anchor_count) + anchor],
+                      output[3 * static_cast<size_t>(anchor_count) + anchor],
+                      best_score,
+                      best_class_id,
+                      anchor};
+}
+
+void throw_on_error(const cudaError_t err, const char *what) {
+  if (err != cudaSuccess)
+    throw std::runtime_error(std::string(what) +
+                             " failed: " + cudaGetErrorString(err));
+}
+
+template <typename T>
+std::unique_ptr<T, CudaHostDeleter> make_pinned_unique(const size_t count,
+                                                       const unsigned flags) {
+  T *ptr = nullptr;
+  throw_on_error(cudaHostAlloc(reinterpret_cast<void **>(&ptr),
+                               count * sizeof(T), flags),
+                 "cudaHostAlloc()");
+  return std::unique_ptr<T, CudaHostDeleter>(ptr);
+}
+
+} // namespace
+
+YoloDeviceDecoder::YoloDeviceDecoder(
+    const int dimensions, const int anchor_count,
+    const std::span<const float> class_thresholds)
+    : m_class_count(dimensions - 4), m_anchor_count(anchor_count) {
+  if (m_class_count <= 0 || m_anchor_count <= 0 ||
+      class_thresholds.size() != static_cast<size_t>(m_class_count))
+    throw std::invalid_argument(
+        std::to_string(class_thresholds.size()) + " class thresholds for " +
+        std::to_string(dimensions) + " x " + std::to_string(anchor_count) +
+        " output");
+  m_class_thresholds_gpu = make_device_unique<float>(m_class_count);
+  throw_on_error(cudaMemcpy(m_class_thresholds_gpu.get(),
+                            class_thresholds.data(),
+                            class_thresholds.size_bytes(),
+                            cudaMemcpyHostToDevice),
+                 "cudaMemcpy()");
+  m_count_gpu = make_device_unique<uint32_t>(1);
+  m_count_host = make_pinned_unique<uint32_t>(1, cudaHostAllocDefault);
+  *m_count_host = 0;
+  m_candidates_host = make_pinned_unique<YoloDeviceCandidate>(
+      m_anchor_count, cudaHostAllocMapped);
+  throw_on_error(cudaHostGetDevicePointer(
+                     reinterpret_cast<void **>(&m_candidates_alias),
+                     m_candidates_host.get(), 0),
+                 "cudaHostGetDevicePointer()");
+}
+
+cudaError_t YoloDeviceDecoder::enqueue(const float *output,
+                                       cudaStream_t stream) {
+  if (const auto err =
+          cudaMemsetAsync(m_count_gpu.get(), 0, sizeof(uint32_t), stream);
+      err != cudaSuccess)
+    return err;
+  const int blocks =
+      (m_anchor_count + threads_per_block - 1) / threads_per_block;
+  decode_yolo_output_kernel<<<blocks, threads_per_block, 0, stream>>>(
+      output, m_class_count, m_anchor_count, m_class_thresholds_gpu.get(),
+      m_count_gpu.get(), m_candidates_alias);
+  if (const auto err = cudaGetLastError(); err != cudaSuccess)
+    return err;
+  return cudaMemcpyAsync(m_count_host.get(), m_count_gpu.get(),
+                         sizeof(uint32_t), cudaMemcpyDeviceToHost, stream);
+}
+
+void YoloDeviceDecoder::collect(YoloCandidates &candidates) {
+  candidates.clear();
+  const auto count =
+      std::min(*m_count_host, static_cast<uint32_t>(m_anchor_count));
+  // Slots were taken in whatever order warps got to the counter
+  const auto first = m_candidates_host.get();
+  std::sort(first, first + count,
+            [](const YoloDeviceCandidate &lhs, const YoloDeviceCandidate &rhs) {
+              return lhs.anchor < rhs.anchor;
+            });
+  for (auto it = first; it != first + count; ++it)
+    candidates.add(it->cx, it->cy, it->w, it->h, it->confidence,
+                   it->class_id);
+}
+
+} // namespace MatrixPipeline::Utils
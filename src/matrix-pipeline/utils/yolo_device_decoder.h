@@ -0,0 +1,73 @@
+#pragma once
+
+#include "cuda_helper.h"
+#include "yolo_decoder.h"
+
+#include <cuda_runtime.h>
+
+#include <cstdint>
+#include <memory>
+#include <span>
+
+namespace MatrixPipeline::Utils {
+
+// One anchor that passed its class' threshold, as the kernel writes it
+struct YoloDeviceCandidate {
+  float cx;
+  float cy;
+  float w;
+  float h;
+  float confidence;
+  int32_t class_id;
+  int32_t anchor;
+};
+
+/**
+ * @brief Decodes a YOLO detection output (see decode_yolo_output()) where the
+ * engine wrote it, on the GPU, s.t. only the candidates cross PCIe rather
+ * than the whole tensor (e.g., 84 x 8400 floats, about 2.8 MB).
+ *
+ * One thread per anchor finds its best class and score; those that pass the
+ * class' threshold are compacted with a warp-aggregated atomic counter, which
+ * is reset on the same stream, and written straight into mapped pinned host
+ * memory. Candidates are sorted by anchor when collected, s.t. the result
+ * equals decode_yolo_output()'s, which remains the reference on GPU-less
+ * machines.
+ *
+ * An instance is bound to one output shape and is used by one thread.
+ */
+class YoloDeviceDecoder {
+public:
+  /**
+   * @param class_thresholds the confidence threshold of each class, i.e.,
+   * dimensions - 4 of them
+   * @throws std::invalid_argument on a class_thresholds size mismatch
+   * @throws std::runtime_error if device or pinned host memory can't be
+   * allocated
+   */
+  YoloDeviceDecoder(int dimensions, int anchor_count,
+                    std::span<const float> class_thresholds);
+
+  /**
+   * @brief Enqueues the decoding of output (device memory) on stream. Its
+   * results are only readable by collect() once stream is synchronized
+   */
+  cudaError_t enqueue(const float *output, cudaStream_t stream);
+
+  // Reads the candidates of the last enqueue(), in anchor order
+  void collect(YoloCandidates &candidates);
+
+private:
+  int m_class_count;
+  int m_anchor_count;
+  std::unique_ptr<float, CudaDeleter> m_class_thresholds_gpu;
+  std::unique_ptr<uint32_t, CudaDeleter> m_count_gpu;
+  // Pinned, the count is copied here after the kernel
+  std::unique_ptr<uint32_t, CudaHostDeleter> m_count_host;
+  // Mapped pinned memory, which the kernel writes through its device alias.
+  // Sized for every anchor to pass, s.t. nothing is ever dropped
+  std::unique_ptr<YoloDeviceCandidate, CudaHostDeleter> m_candidates_host;
+  YoloDeviceCandidate *m_candidates_alias = nullptr;
+};
+
+} // namespace MatrixPipeline::Utils
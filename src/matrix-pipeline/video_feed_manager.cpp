@@ -1,200 +1,347 @@
 #include "video_feed_manager.h"
+#include "frame_sources/live_frame_source.h"
+#include "frame_sources/replay_frame_source.h"
+#include "frame_sources/synthetic_frame_source.h"
 #include "global_vars.h"
+#include "utils/frame_pool.h"
 
+#include <fmt/ranges.h>
 #include <opencv2/core.hpp>
 #include <opencv2/core/cuda.hpp>
 #include <opencv2/core/types.hpp>
 #include <opencv2/cudacodec.hpp>
 #include <spdlog/spdlog.h>
 
-#include <gsl/gsl>
 #include <regex>
+#include <set>
 #include <sys/socket.h>
 
 using namespace std;
 
 namespace MatrixPipeline {
 
+VideoFeedManager::VideoFeedManager(njson device_config)
+    : m_device_config(std::move(device_config)),
+      m_reloaded_config(m_device_config),
+      m_apu("/" + m_device_config.value("name", "Unnamed Device")) {}
+
+std::vector<njson> VideoFeedManager::get_device_configs(const njson &settings) {
+  std::vector<njson> device_configs;
+  if (settings.contains("devices")) {
+    for (const auto &device : settings.at("devices")) {
+      device_configs.push_back(device);
+    }
+  } else if (settings.contains("device")) {
+    device_configs.push_back(settings.at("device"));
+  }
+  for (auto &device_config : device_configs) {
+    for (const auto key : {"pipeline", "turnedOnHours"}) {
+      if (!device_config.contains(key) && settings.contains(key))
+        device_config[key] = settings.at(key);
+    }
+  }
+  return device_configs;
+}
+
 bool VideoFeedManager::init() {
-  if (!m_apu.init(settings)) {
+  const auto source_type =
+      m_device_config.value("/source/type"_json_pointer, "live");
+  if (source_type == "live") {
+    m_frame_source = std::make_unique<FrameSource::LiveFrameSource>();
+  } else if (source_type == "replay") {
+    m_frame_source = std::make_unique<FrameSource::ReplayFrameSource>();
+  } else if (source_type == "synthetic") {
+    m_frame_source = std::make_unique<FrameSource::SyntheticFrameSource>();
+  } else {
+    SPDLOG_ERROR("Unrecognized source type: {}", source_type);
+    return false;
+  }
+  if (!m_frame_source->init(m_device_config)) {
+    SPDLOG_ERROR("Failed to init {} frame source", source_type);
+    return false;
+  }
+  if (!m_apu.init(m_device_config) || !m_apu.configure_queue(m_device_config)) {
     return false;
   }
   m_apu.start();
   return true;
 }
 
-void VideoFeedManager::feed_capture_ev() {
+bool VideoFeedManager::reload(const njson &device_config) {
+  std::set<std::string> unreloadable_keys;
+  for (const auto &op : njson::diff(m_reloaded_config, device_config)) {
+    const auto path = op.at("path").get<std::string>();
+    // "/pipeline/3/threshold" -> "pipeline"
+    if (const auto key = path.substr(1, path.find('/', 1) - 1);
+        key != "pipeline")
+      unreloadable_keys.insert(key);
+  }
+  if (!unreloadable_keys.empty())
+    SPDLOG_WARN("[{}] changes to {} are not reloaded, they take effect after "
+                "a restart",
+                get_name(), fmt::join(unreloadable_keys, ", "));
+  // Even if the pipeline fails to reload: the keys above are warned about once
+  m_reloaded_config = device_config;
+  SPDLOG_INFO("[{}] reloading pipeline", get_name());
+  return m_apu.reload(device_config);
+}
 
-  cv::cuda::GpuMat frame;
+void VideoFeedManager::feed_capture_ev() {
 
   ProcessingUnit::PipelineContext ctx;
   try {
-    const auto device = settings.at("device");
-    ctx.device_info = {.name = device.value("name", "Unnamed Device"),
-                       .uri = device.at("uri").get<std::string>(),
-                       .expected_frame_size = {
-                           device["expectedFrameSize"]["width"].get<int>(),
-                           device["expectedFrameSize"]["height"].get<int>()}};
+    const auto &device = m_device_config;
+    const auto &frame_size = device["expectedFrameSize"];
+    ctx.device_info = ProcessingUnit::DeviceInfo{
+        .name = device.value("name", "Unnamed Device"),
+        .uri = device.value("uri", ""),
+        .expected_frame_size = {frame_size["width"].get<int>(),
+                                frame_size["height"].get<int>()},
+        .lossless = m_frame_source->is_lossless()};
   } catch (const std::exception &e) {
     SPDLOG_ERROR("Failed to parse device info: {}", e.what());
     return;
   }
+  {
+    auto &registry = Utils::MetricsRegistry::instance();
+    const Utils::MetricLabels labels{{"device", ctx.device_info->name}};
+    m_captured_frame_count = registry.counter(
+        "matrix_pipeline_device_captured_frames_total",
+        "Frames decoded from the device", labels);
+    m_capture_fps = registry.gauge(
+        "matrix_pipeline_device_capture_fps",
+        "Frames decoded from the device per second, over the last second",
+        labels);
+  }
+  m_frame_ring = std::make_unique<Utils::FrameRing>(
+      m_device_config.value("frameRingCapacity", 8),
+      ctx.device_info->expected_frame_size, CV_8UC3);
+  const auto start_time = std::chrono::steady_clock::now();
+  m_last_stats_log_time = start_time;
+
+  std::thread th_secondary_capture;
+  if (m_device_config.contains("secondaryUri")) {
+    try {
+      const auto &size = m_device_config.at("secondaryExpectedFrameSize");
+      m_secondary_expected_frame_size = {size.at("width").get<int>(),
+                                         size.at("height").get<int>()};
+      m_secondary_max_skew = std::chrono::milliseconds(m_device_config.value(
+          "secondaryMaxSkewMs", m_secondary_max_skew.count()));
+      m_secondary_reconnector = std::make_unique<Utils::VideoReaderReconnector>(
+          m_device_config.at("secondaryUri").get<std::string>(),
+          ctx.device_info->name + "/secondary",
+          FrameSource::LiveFrameSource::parse_reconnect_config(
+              m_device_config));
+      m_secondary_reconnector->start();
+      th_secondary_capture =
+          std::thread(&VideoFeedManager::secondary_capture_ev, this);
+      SPDLOG_INFO("[{}] secondary stream enabled, expected_frame_size: {}x{}, "
+                  "max_skew(ms): {}",
+                  ctx.device_info->name, m_secondary_expected_frame_size.width,
+                  m_secondary_expected_frame_size.height,
+                  m_secondary_max_skew.count());
+    } catch (const std::exception &e) {
+      SPDLOG_ERROR("Failed to parse secondary stream info, secondary stream "
+                   "disabled: {}",
+                   e.what());
+      m_secondary_reconnector = nullptr;
+    }
+  }
+
+  std::thread th_capture(&VideoFeedManager::capture_ev, this, ctx);
+  dispatch_ev();
+  th_capture.join();
+  if (th_secondary_capture.joinable())
+    th_secondary_capture.join();
+
+  m_frame_source->stop();
+  if (m_secondary_reconnector)
+    m_secondary_reconnector->stop();
+  // Let all branches finish processing what's already queued
+  m_apu.stop();
+  if (m_source_exhausted) {
+    const auto elapsed = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start_time)
+                             .count();
+    SPDLOG_INFO("[{}] source exhausted, {} frames went through the pipeline "
+                "in {:.1f} sec ({:.1f} fps)",
+                ctx.device_info->name, m_dispatched_frame_count, elapsed,
+                elapsed > 0 ? m_dispatched_frame_count / elapsed : 0.0);
+  }
+  SPDLOG_INFO("thread of device [{}] quits gracefully", ctx.device_info->name);
+}
+
+void VideoFeedManager::capture_ev(ProcessingUnit::PipelineContext ctx) {
+  using namespace std::chrono;
+  using namespace std::chrono_literals;
+  // Decoded into when the ring is full: we keep draining the decoder at its
+  // own pace and drop the frame ourselves, s.t. the loss shows up in the
+  // overrun counter instead of silently inside cudacodec's allowFrameDrop
+  cv::cuda::GpuMat overrun_frame;
+  auto fps_window_start_time = steady_clock::now();
+  uint64_t fps_window_frame_count = 0;
 
   ctx.capture_from_this_device_since =
-      std::chrono::time_point_cast<std::chrono::milliseconds>(
-          std::chrono::steady_clock::now());
+      time_point_cast<milliseconds>(steady_clock::now());
   while (ev_flag == 0) {
+    if (const auto elapsed = steady_clock::now() - fps_window_start_time;
+        elapsed >= 1s) {
+      m_capture_fps->set(fps_window_frame_count /
+                         duration<double>(elapsed).count());
+      fps_window_start_time = steady_clock::now();
+      fps_window_frame_count = 0;
+    }
+    Utils::FrameRing::Slot *slot = nullptr;
+    if (ctx.device_info->lossless) {
+      // Backpressure: a lossless source waits for the pipeline instead
+      while (ev_flag == 0 && slot == nullptr)
+        slot = m_frame_ring->wait_for_free(100ms);
+      if (slot == nullptr)
+        break;
+    } else {
+      slot = m_frame_ring->try_acquire();
+    }
+    // The ring hands out slots whose buffer the pipeline is done with, the
+    // overrun frame is never dispatched in the first place
+    auto &frame = slot != nullptr ? slot->frame : overrun_frame;
     ctx.text_to_overlay = "";
-    always_fill_in_frame(frame, ctx);
-    handle_video_capture(ctx);
-    m_apu.enqueue(frame, ctx);
+    const auto decode_start_time = steady_clock::now();
+    if (!m_frame_source->next_frame(frame, ctx)) {
+      // The acquired slot is simply never published, the ring is not reused
+      // once its source is exhausted
+      m_source_exhausted.store(true, std::memory_order_release);
+      break;
+    }
+    Utils::Tracer::record("capture", "capture", decode_start_time,
+                          steady_clock::now(), ctx.frame_seq_num);
+    if (ctx.captured_from_real_device) {
+      m_decode_stats.record(steady_clock::now() - decode_start_time);
+      m_captured_frame_count->inc();
+      ++fps_window_frame_count;
+    }
+    if (slot != nullptr) {
+      slot->ctx = ctx;
+      m_frame_ring->publish(slot);
+    }
   }
-
-  vr.release();
-  SPDLOG_INFO("thread quits gracefully");
 }
 
-void VideoFeedManager::always_fill_in_frame(
-    cv::cuda::GpuMat &frame, ProcessingUnit::PipelineContext &ctx) {
+void VideoFeedManager::secondary_capture_ev() {
   using namespace std::chrono_literals;
   using namespace std::chrono;
-  auto captured_from_real_device = false;
-
+  // Only a handful of frames are needed to bridge the skew between the two
+  // streams' decoders
+  constexpr size_t max_buffered_frames = 8;
   constexpr auto warn_interval = 10s;
-  try {
-    std::lock_guard lock(mtx_vr);
+  steady_clock::time_point last_warn_time;
+  while (ev_flag == 0 && !m_source_exhausted.load(std::memory_order_acquire)) {
+    const auto vr = m_secondary_reconnector->get_reader();
     if (vr == nullptr) {
-      if (steady_clock::now() - m_last_warn_time > warn_interval &&
-          // give the video feed a few sec to open without complaining
-          ctx.frame_seq_num > 90) {
-        SPDLOG_WARN("vr == nullptr, frame_seq_num: {} (this "
-                    "message is throttled to once per {} sec)",
-                    ctx.frame_seq_num, warn_interval.count());
-        m_last_warn_time = steady_clock::now();
-      }
-    } else if (!vr->nextFrame(frame)) {
-      if (steady_clock::now() - m_last_warn_time > warn_interval) {
-        SPDLOG_ERROR("VideoReader->nextFrame(frame) returns false, "
-                     "frame_seq_num: {} (this "
-                     "message is throttled to once per {} sec)",
-                     ctx.frame_seq_num, warn_interval.count());
-        m_last_warn_time = steady_clock::now();
-      }
-    } else if (frame.empty() ||
-               frame.size() != ctx.device_info.expected_frame_size) {
-
-      if (steady_clock::now() - m_last_warn_time > warn_interval) {
-        SPDLOG_ERROR("VideoReader->nextFrame((frame) returns frame with "
-                     "unexpected size. expect ({}x{}) vs actual ({}x{}) (this "
-                     "message is throttled to once per {} sec)",
-                     ctx.device_info.expected_frame_size.width,
-                     ctx.device_info.expected_frame_size.height,
-                     frame.empty() ? -1 : frame.size().width,
-                     frame.empty() ? -1 : frame.size().height,
-                     warn_interval.count());
-        m_last_warn_time = steady_clock::now();
-      }
-    } else {
-      captured_from_real_device = true;
+      this_thread::sleep_for(100ms);
+      continue;
     }
-  } catch (const cv::Exception &e) {
-    if (steady_clock::now() - m_last_warn_time > warn_interval) {
-      SPDLOG_ERROR("VideoReader->nextFrame() failed: {} (this "
-                   "message is throttled to once per {} sec)",
-                   e.what(), warn_interval.count());
-      m_last_warn_time = steady_clock::now();
+    // A fresh buffer for every frame: a matched frame is shared by reference
+    // with all branches, so it must never be decoded into again
+    cv::cuda::GpuMat frame;
+    bool captured = false;
+    try {
+      captured = vr->nextFrame(frame) &&
+                 frame.size() == m_secondary_expected_frame_size;
+    } catch (const cv::Exception &e) {
+      SPDLOG_DEBUG("VideoReader->nextFrame() failed: {}", e.what());
     }
+    if (!captured) {
+      if (steady_clock::now() - last_warn_time > warn_interval) {
+        SPDLOG_WARN("Failed to capture a valid frame from the secondary "
+                    "stream (this message is throttled to once per {} sec)",
+                    warn_interval.count());
+        last_warn_time = steady_clock::now();
+      }
+      m_secondary_reconnector->report_failure();
+      // report_failure() only wakes the reconnector, which swaps the reader
+      // asynchronously, so don't spin on the dead one in the meantime
+      this_thread::sleep_for(100ms);
+      continue;
+    }
+    std::lock_guard lock(m_secondary_frames_mutex);
+    m_secondary_frames.push_back(
+        {time_point_cast<milliseconds>(steady_clock::now()), std::move(frame)});
+    while (m_secondary_frames.size() > max_buffered_frames)
+      m_secondary_frames.pop_front();
   }
+}
 
-  if (!ctx.captured_from_real_device) {
-    // emulate an 30-fps video device lol
-    this_thread::sleep_for(1000ms / 34);
-    frame.create(ctx.device_info.expected_frame_size.height,
-                 ctx.device_info.expected_frame_size.width, CV_8UC3);
-    frame.setTo(cv::Scalar(128, 128, 128));
+cv::cuda::GpuMat VideoFeedManager::match_secondary_frame(
+    const std::chrono::time_point<std::chrono::steady_clock,
+                                  std::chrono::milliseconds>
+        capture_timestamp) {
+  using namespace std::chrono;
+  const SecondaryFrame *best = nullptr;
+  auto best_skew = milliseconds::max();
+  std::lock_guard lock(m_secondary_frames_mutex);
+  for (const auto &secondary : m_secondary_frames) {
+    if (const auto skew = abs(secondary.capture_timestamp - capture_timestamp);
+        skew < best_skew) {
+      best_skew = skew;
+      best = &secondary;
+    }
   }
-  ctx.capture_timestamp =
-      std::chrono::time_point_cast<milliseconds>(steady_clock::now());
-  if (captured_from_real_device != ctx.captured_from_real_device) {
-    ctx.capture_from_this_device_since = ctx.capture_timestamp;
+  if (best == nullptr || best_skew > m_secondary_max_skew) {
+    m_secondary_unmatched_count.fetch_add(1, std::memory_order_relaxed);
+    return {};
   }
-  ctx.captured_from_real_device = captured_from_real_device;
-  ++ctx.frame_seq_num;
+  m_secondary_matched_count.fetch_add(1, std::memory_order_relaxed);
+  // Shallow copy, i.e., the GPU buffer is shared
+  return best->frame;
 }
 
-void VideoFeedManager::handle_video_capture(
-    const ProcessingUnit::PipelineContext &ctx) {
-
-  auto register_delayed_vc_open_retry = [this, ctx]() {
-    // .exchange(true) atomically sets the flag to true and returns the PREVIOUS
-    // value. If it was already true, someone else is already handling the
-    // retry.
-    if (delayed_vc_open_retry_registered.exchange(true)) {
-      return;
+void VideoFeedManager::dispatch_ev() {
+  using namespace std::chrono_literals;
+  while (ev_flag == 0) {
+    log_stats_throttled();
+    auto *slot = m_frame_ring->wait_for_published(100ms);
+    if (slot == nullptr) {
+      if (m_source_exhausted.load(std::memory_order_acquire) &&
+          m_frame_ring->occupancy() == 0)
+        break;
+      continue;
     }
-    using namespace std::chrono_literals;
-    const auto video_feed_down_for =
-        std::chrono::duration_cast<std::chrono::seconds>(
-            std::chrono::steady_clock::now() -
-            ctx.capture_from_this_device_since);
-    const std::chrono::seconds delay_before_attempt =
-        std::min(std::max(video_feed_down_for, 2s), 60s * 10);
-    // give the video feed a few sec to open without complaining
-    if (ctx.frame_seq_num > 90)
-      SPDLOG_WARN("captured_from_real_device: {}, device_down_for(sec): {}, "
-                  "delay_before_attempt(sec): {}",
-                  ctx.captured_from_real_device, video_feed_down_for.count(),
-                  delay_before_attempt.count());
-
-    // creating a shared_ptr from *this, s.t. the detach()'ed t will never
-    // access *this after *this is deleted.
-    auto self_ptr = shared_from_this();
-    std::thread t(
-        [self_ptr](const std::chrono::seconds delay_before_attempt_,
-                   ProcessingUnit::PipelineContext ctx) {
-          SPDLOG_INFO(
-              "timer started, delay_before_attempt(sec) ({}) and then invoke "
-              "cv::cudacodec::createVideoReader({})",
-              delay_before_attempt_.count(), ctx.device_info.uri);
-          std::this_thread::sleep_for(delay_before_attempt_);
-          {
-            std::lock_guard lock(self_ptr->mtx_vr);
-            SPDLOG_INFO(
-                "delay_before_attempt(sec) ({}) reached, about to invoke "
-                "cv::cudacodec::createVideoReader({})",
-                delay_before_attempt_.count(), ctx.device_info.uri);
-            auto params = cv::cudacodec::VideoReaderInitParams();
-            // https://docs.opencv.org/4.9.0/dd/d7d/structcv_1_1cudacodec_1_1VideoReaderInitParams.html
-            params.allowFrameDrop = true;
-            try {
-              self_ptr->vr = cv::cudacodec::createVideoReader(
-                  ctx.device_info.uri, {}, params);
-              if (!self_ptr->vr)
-                throw std::runtime_error("!self_ptr->vr");
-              self_ptr->vr->set(cv::cudacodec::ColorFormat::BGR);
-              SPDLOG_INFO("cv::cudacodec::createVideoReader({}) succeeded",
-                          ctx.device_info.uri);
-            } catch (const cv::Exception &e) {
-              SPDLOG_ERROR("cudacodec::createVideoReader({}) failed: {}",
-                           ctx.device_info.uri, e.what());
-            }
-            std::this_thread::sleep_for(
-                100ms); // i.e., at least to skip one frame
-            auto reset_flag = gsl::finally([self_ptr] {
-              // Use 'release' to ensure all work done in this thread is
-              // "committed" and visible to other threads before the flag is
-              // reset to false.
-              self_ptr->delayed_vc_open_retry_registered.store(
-                  false, std::memory_order_release);
-            });
-          }
-        },
-        delay_before_attempt, ctx);
-    t.detach();
-  };
-
-  if (!ctx.captured_from_real_device) [[unlikely]] {
-    register_delayed_vc_open_retry();
+    TRACE_SCOPE("dispatch", "dispatch", slot->ctx.frame_seq_num);
+    const auto dispatch_start_time = std::chrono::steady_clock::now();
+    if (m_secondary_reconnector)
+      slot->ctx.secondary_frame =
+          match_secondary_frame(slot->ctx.capture_timestamp);
+    m_apu.enqueue(slot->frame, slot->ctx);
+    m_dispatch_stats.record(std::chrono::steady_clock::now() -
+                            dispatch_start_time);
+    m_frame_ring->release(slot);
+    ++m_dispatched_frame_count;
   }
 }
+
+void VideoFeedManager::log_stats_throttled() {
+  using namespace std::chrono_literals;
+  constexpr auto stats_interval = 60s;
+  const auto now = std::chrono::steady_clock::now();
+  if (now - m_last_stats_log_time < stats_interval)
+    return;
+  m_last_stats_log_time = now;
+  const auto decode = m_decode_stats.take_snapshot();
+  const auto dispatch = m_dispatch_stats.take_snapshot();
+  SPDLOG_INFO("{}: decode(count/avg_us/max_us): {}/{:.0f}/{}, "
+              "dispatch(count/avg_us/max_us): {}/{:.0f}/{}, "
+              "frame_ring(occupancy/capacity/overruns): {}/{}/{}, "
+              "{}, secondary(matched/unmatched): {}/{}, {} (this message is "
+              "logged once per {} sec)",
+              m_device_config.value("name", "Unnamed Device"), decode.count,
+              decode.avg_us, decode.max_us, dispatch.count, dispatch.avg_us,
+              dispatch.max_us, m_frame_ring->occupancy(),
+              m_frame_ring->capacity(), m_frame_ring->overrun_count(),
+              m_frame_source->get_stats_summary(),
+              m_secondary_matched_count.exchange(0, std::memory_order_relaxed),
+              m_secondary_unmatched_count.exchange(0,
+                                                   std::memory_order_relaxed),
+              Utils::get_frame_pool_stats_summary(), stats_interval.count());
+}
+
 } // namespace MatrixPipeline
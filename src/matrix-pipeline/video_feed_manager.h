@@ -2,11 +2,19 @@
 
 #include "asynchronous_processing_units/asynchronous_processing_unit.h"
 #include "entities/processing_context.h"
+#include "interfaces/i_frame_source.h"
+#include "utils/frame_ring.h"
+#include "utils/metrics.h"
+#include "utils/tracer.h"
+#include "utils/video_reader_reconnector.h"
 
 #include <nlohmann/json.hpp>
 #include <opencv2/cudacodec.hpp>
 
+#include <deque>
+#include <mutex>
 #include <string>
+#include <vector>
 
 using njson = nlohmann::json;
 
@@ -20,21 +28,78 @@ struct videoWritingContext {
 class VideoFeedManager : public std::enable_shared_from_this<VideoFeedManager> {
 
 public:
-  VideoFeedManager() = default;
+  explicit VideoFeedManager(njson device_config);
   ~VideoFeedManager() = default;
   bool init();
   void feed_capture_ev();
+  /**
+   * @brief Reloads the device's pipeline from device_config while the feed
+   * keeps running, see AsynchronousProcessingUnit::reload(). Changes to the
+   * other settings (the source, the ring, etc.) are logged and only take
+   * effect after a restart.
+   */
+  bool reload(const njson &device_config);
+  [[nodiscard]] std::string get_name() const {
+    return m_device_config.value("name", "Unnamed Device");
+  }
+
+  /**
+   * @brief Extracts one self-contained config object per device, each with
+   * its own "uri", "expectedFrameSize", "pipeline" and "turnedOnHours".
+   * Both the multi-device format (a "devices" array) and the legacy
+   * single-device format (a "device" object plus top-level "pipeline") are
+   * supported; per-device keys missing from a "devices" entry fall back to the
+   * top-level ones.
+   */
+  static std::vector<njson> get_device_configs(const njson &settings);
 
 private:
-  ProcessingUnit::AsynchronousProcessingUnit m_apu{""};
-  std::string deviceName;
-
-  std::mutex mtx_vr;
-  std::atomic<bool> delayed_vc_open_retry_registered{false};
-  cv::Ptr<cv::cudacodec::VideoReader> vr{nullptr};
-  void always_fill_in_frame(cv::cuda::GpuMat &frame,
-                            ProcessingUnit::PipelineContext &ctx);
-  void handle_video_capture(const ProcessingUnit::PipelineContext &ctx);
-  std::chrono::time_point<std::chrono::steady_clock> m_last_warn_time;
+  // What the device was started with, i.e., what its source, ring, etc. run
+  // with. Read by the capture threads, hence never modified
+  njson m_device_config;
+  // The config the last reload() was given, which the next one diffs against.
+  // Only touched by reload(), which isn't called concurrently
+  njson m_reloaded_config;
+  ProcessingUnit::AsynchronousProcessingUnit m_apu;
+  // Decoding and dispatching run on separate threads connected by this ring,
+  // so that a slow pipeline no longer stalls the decoder (and vice versa)
+  std::unique_ptr<Utils::FrameRing> m_frame_ring;
+  Utils::StageLatencyStats m_decode_stats;
+  Utils::StageLatencyStats m_dispatch_stats;
+  std::chrono::time_point<std::chrono::steady_clock> m_last_stats_log_time;
+
+  std::unique_ptr<FrameSource::IFrameSource> m_frame_source;
+  // Set by the capture thread once a finite source (e.g., a replayed file) is
+  // exhausted, the dispatch thread then drains the ring and quits
+  std::atomic<bool> m_source_exhausted{false};
+  uint64_t m_dispatched_frame_count = 0;
+  // Frames decoded from the real device, i.e., excluding placeholder frames
+  std::shared_ptr<Utils::Counter> m_captured_frame_count;
+  std::shared_ptr<Utils::Gauge> m_capture_fps;
+
+  // --- Optional secondary (usually low-resolution sub-) stream ---
+  struct SecondaryFrame {
+    std::chrono::time_point<std::chrono::steady_clock,
+                            std::chrono::milliseconds>
+        capture_timestamp;
+    cv::cuda::GpuMat frame;
+  };
+  std::unique_ptr<Utils::VideoReaderReconnector> m_secondary_reconnector;
+  cv::Size m_secondary_expected_frame_size;
+  std::chrono::milliseconds m_secondary_max_skew{100};
+  std::mutex m_secondary_frames_mutex;
+  // The most recent few secondary frames, oldest first
+  std::deque<SecondaryFrame> m_secondary_frames;
+  std::atomic<uint64_t> m_secondary_matched_count{0};
+  std::atomic<uint64_t> m_secondary_unmatched_count{0};
+  void secondary_capture_ev();
+  cv::cuda::GpuMat match_secondary_frame(
+      std::chrono::time_point<std::chrono::steady_clock,
+                              std::chrono::milliseconds>
+          capture_timestamp);
+
+  void capture_ev(ProcessingUnit::PipelineContext ctx);
+  void dispatch_ev();
+  void log_stats_throttled();
 };
 } // namespace MatrixPipeline
@@ -0,0 +1,158 @@
+// Compares the asynchronous units' frame hand-off queues: the previous
+// std::queue + std::mutex + std::condition_variable one vs. the lock-free
+// MpscRing with futex wake-ups, at 1, 4 and 16 producers.
+//
+// Usage: async_queue_bench [items_per_producer] [capacity]
+
+#include "../../matrix-pipeline/utils/mpsc_ring.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+namespace {
+
+// Roughly the shape of an AsyncPayload: a refcounted buffer handle plus some
+// context that is moved along with it
+struct Payload {
+  std::shared_ptr<int> frame;
+  std::string text_to_overlay;
+  steady_clock::time_point enqueue_time;
+  uint32_t seq = 0;
+};
+
+// The hand-off as it was before MpscRing, blocking producers once full
+class MutexQueue {
+public:
+  explicit MutexQueue(const size_t capacity) : m_capacity(capacity) {}
+
+  void push(Payload &&payload) {
+    {
+      std::unique_lock lock(m_mutex);
+      m_not_full_cv.wait(lock, [this] { return m_queue.size() < m_capacity; });
+      m_queue.push(std::move(payload));
+    }
+    m_cv.notify_one();
+  }
+
+  void pop(Payload &payload) {
+    {
+      std::unique_lock lock(m_mutex);
+      m_cv.wait(lock, [this] { return !m_queue.empty(); });
+      payload = std::move(m_queue.front());
+      m_queue.pop();
+    }
+    m_not_full_cv.notify_one();
+  }
+
+private:
+  const size_t m_capacity;
+  std::queue<Payload> m_queue;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::condition_variable m_not_full_cv;
+};
+
+class RingQueue {
+public:
+  explicit RingQueue(const size_t capacity) : m_ring(capacity) {}
+
+  void push(Payload &&payload) {
+    while (!m_ring.try_push(std::move(payload)))
+      m_ring.wait_while_full(
+          [this] { return m_ring.size_approx() >= m_ring.capacity(); },
+          100ms);
+  }
+
+  void pop(Payload &payload) {
+    while (!m_ring.wait_pop(payload, 100ms)) {
+    }
+  }
+
+private:
+  MatrixPipeline::Utils::MpscRing<Payload> m_ring;
+};
+
+struct Result {
+  double throughput_per_sec;
+  double p50_us;
+  double p99_us;
+  double max_us;
+};
+
+template <typename Queue>
+Result run(const size_t producer_count, const size_t items_per_producer,
+           const size_t capacity) {
+  Queue queue(capacity);
+  const auto total = producer_count * items_per_producer;
+  std::vector<double> latencies_us;
+  latencies_us.reserve(total);
+  const auto frame = std::make_shared<int>(0);
+
+  const auto start_time = steady_clock::now();
+  std::vector<std::thread> producers;
+  producers.reserve(producer_count);
+  for (size_t p = 0; p < producer_count; ++p) {
+    producers.emplace_back([&] {
+      for (size_t i = 0; i < items_per_producer; ++i) {
+        Payload payload{frame, "", steady_clock::now(),
+                        static_cast<uint32_t>(i)};
+        queue.push(std::move(payload));
+      }
+    });
+  }
+  Payload payload;
+  for (size_t i = 0; i < total; ++i) {
+    queue.pop(payload);
+    latencies_us.push_back(
+        duration<double, std::micro>(steady_clock::now() -
+                                     payload.enqueue_time)
+            .count());
+  }
+  const auto elapsed =
+      duration<double>(steady_clock::now() - start_time).count();
+  for (auto &producer : producers)
+    producer.join();
+
+  std::ranges::sort(latencies_us);
+  const auto percentile = [&](const double p) {
+    return latencies_us[std::min(latencies_us.size() - 1,
+                                 static_cast<size_t>(p * latencies_us.size()))];
+  };
+  return {total / elapsed, percentile(0.5), percentile(0.99),
+          latencies_us.back()};
+}
+
+void print(const char *name, const size_t producer_count, const Result &r) {
+  std::printf("%-12s %9zu %14.0f %10.1f %10.1f %10.1f\n", name, producer_count,
+              r.throughput_per_sec, r.p50_us, r.p99_us, r.max_us);
+}
+
+} // namespace
+
+int main(const int argc, char *argv[]) {
+  const size_t items_per_producer =
+      argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+  const size_t capacity = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 32;
+  std::printf("items_per_producer: %zu, capacity: %zu\n", items_per_producer,
+              capacity);
+  std::printf("%-12s %9s %14s %10s %10s %10s\n", "queue", "producers",
+              "items/sec", "p50(us)", "p99(us)", "max(us)");
+  for (const size_t producer_count : {1, 4, 16}) {
+    print("mutex+cv", producer_count,
+          run<MutexQueue>(producer_count, items_per_producer, capacity));
+    print("mpsc_ring", producer_count,
+          run<RingQueue>(producer_count, items_per_producer, capacity));
+  }
+  return 0;
+}
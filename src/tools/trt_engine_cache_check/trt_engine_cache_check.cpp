@@ -0,0 +1,275 @@
+// Checks Utils::TrtEngineCache's lookup and invalidation without a GPU: plans
+// are built by a stub PlanBuilder, which counts its calls, s.t. each scenario
+// can tell a cache hit from a rebuild. Covers hits, every part of the key,
+// corrupted entries and interrupted writes. The exit code is 1 if any check
+// fails.
+//
+// Usage: trt_engine_cache_check [scratch_dir]
+
+#include "../../matrix-pipeline/utils/trt_engine_cache.h"
+
+#include <fmt/format.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace MatrixPipeline::Utils;
+namespace fs = std::filesystem;
+
+namespace {
+
+int g_failure_count = 0;
+
+void check(const bool condition, const std::string &what) {
+  std::printf("%s: %s\n", condition ? "PASS" : "FAIL", what.c_str());
+  if (!condition)
+    ++g_failure_count;
+}
+
+void write_file(const fs::path &path, const std::string &content) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file << content;
+}
+
+std::vector<fs::path> list_dir(const fs::path &dir) {
+  std::vector<fs::path> paths;
+  for (const auto &entry : fs::directory_iterator(dir))
+    paths.push_back(entry.path());
+  return paths;
+}
+
+// A stand-in for YoloDetect::build_plan(), whose plans differ per call
+class StubBuilder {
+public:
+  std::vector<char> operator()() {
+    ++m_build_count;
+    const auto plan = fmt::format("plan #{}", m_build_count);
+    return {plan.begin(), plan.end()};
+  }
+  [[nodiscard]] int get_build_count() const { return m_build_count; }
+
+private:
+  int m_build_count = 0;
+};
+
+class Scenario {
+public:
+  Scenario(const fs::path &scratch_dir, const std::string &name)
+      : m_dir(scratch_dir / name), m_model_path(m_dir / "model.onnx") {
+    fs::remove_all(m_dir);
+    fs::create_directories(m_dir / "cache");
+    write_file(m_model_path, "onnx bytes v1");
+    m_key = {.model_path = m_model_path.string(),
+             .input_width = 640,
+             .input_height = 640,
+             .precision = "fp16",
+             .max_batch_size = 1,
+             .builder_fingerprint = "trt=100300;sm=86;device=Stub"};
+  }
+
+  TrtEngineCache &cache() { return m_cache; }
+  TrtEngineCacheKey &key() { return m_key; }
+  [[nodiscard]] const fs::path &model_path() const { return m_model_path; }
+  [[nodiscard]] fs::path cache_dir() const { return m_dir / "cache"; }
+
+  // Returns whether get_or_build() built the plan rather than loading it
+  bool get_or_build(const TrtEngineCacheKey &key,
+                    std::vector<char> *plan = nullptr) {
+    const auto build_count = m_builder.get_build_count();
+    auto result = m_cache.get_or_build(key, [this] { return m_builder(); });
+    if (plan != nullptr)
+      *plan = std::move(result);
+    return m_builder.get_build_count() > build_count;
+  }
+  bool get_or_build(std::vector<char> *plan = nullptr) {
+    return get_or_build(m_key, plan);
+  }
+
+  // The scenario's only entry, built if there is none yet
+  fs::path get_entry_path() {
+    get_or_build();
+    const auto paths = list_dir(cache_dir());
+    if (paths.size() != 1)
+      throw std::runtime_error(fmt::format(
+          "expected exactly one entry in {}, found {}", cache_dir().string(),
+          paths.size()));
+    return paths.front();
+  }
+
+private:
+  fs::path m_dir;
+  fs::path m_model_path;
+  TrtEngineCacheKey m_key;
+  TrtEngineCache m_cache{m_dir / "cache"};
+  StubBuilder m_builder;
+};
+
+void check_hit_after_build(const fs::path &scratch_dir) {
+  Scenario scenario(scratch_dir, "hit");
+  std::vector<char> built;
+  std::vector<char> loaded;
+  check(scenario.get_or_build(&built), "A miss builds the plan");
+  check(!scenario.get_or_build(&loaded), "A hit doesn't rebuild it");
+  check(!built.empty() && built == loaded, "A hit returns the built plan");
+  TrtEngineCache other_instance(scenario.cache_dir());
+  int build_count = 0;
+  other_instance.get_or_build(scenario.key(), [&build_count] {
+    ++build_count;
+    return std::vector<char>{'x'};
+  });
+  check(build_count == 0, "Another instance (i.e., a restart) hits as well");
+}
+
+void check_key_changes(const fs::path &scratch_dir) {
+  Scenario scenario(scratch_dir, "key");
+  scenario.get_or_build();
+  const auto check_rebuilt = [&scenario](const std::string &what,
+                                         auto &&modify) {
+    auto key = scenario.key();
+    modify(key);
+    check(scenario.get_or_build(key), what + " rebuilds the plan");
+    check(!scenario.get_or_build(key), what + ", then hits");
+  };
+  check_rebuilt("Another input width",
+                [](TrtEngineCacheKey &key) { key.input_width = 1280; });
+  check_rebuilt("Another input height",
+                [](TrtEngineCacheKey &key) { key.input_height = 384; });
+  check_rebuilt("Other precision flags",
+                [](TrtEngineCacheKey &key) { key.precision = "int8"; });
+  check_rebuilt("Another max batch size",
+                [](TrtEngineCacheKey &key) { key.max_batch_size = 8; });
+  check_rebuilt("Another TensorRT version", [](TrtEngineCacheKey &key) {
+    key.builder_fingerprint = "trt=100400;sm=86;device=Stub";
+  });
+  check_rebuilt("Another compute capability", [](TrtEngineCacheKey &key) {
+    key.builder_fingerprint = "trt=100300;sm=89;device=Stub";
+  });
+  check(!scenario.get_or_build(), "The original key still hits");
+
+  write_file(scenario.model_path(), "onnx bytes v2");
+  check(scenario.get_or_build(), "Other ONNX bytes at the same path rebuild");
+  check(!scenario.get_or_build(), "Other ONNX bytes, then hit");
+
+  scenario.cache().invalidate(scenario.key());
+  check(scenario.get_or_build(), "invalidate() makes the next lookup rebuild");
+
+  auto missing_key = scenario.key();
+  missing_key.model_path = (scenario.cache_dir() / "missing.onnx").string();
+  std::vector<char> plan{'x'};
+  check(!scenario.get_or_build(missing_key, &plan) && plan.empty(),
+        "A missing model neither builds nor returns a plan");
+}
+
+void check_corrupted_entries(const fs::path &scratch_dir) {
+  const auto check_rebuilt = [&scratch_dir](const std::string &what,
+                                            auto &&corrupt) {
+    Scenario scenario(scratch_dir, "corrupted");
+    std::vector<char> built;
+    scenario.get_or_build(&built);
+    corrupt(scenario.get_entry_path());
+    std::vector<char> rebuilt;
+    check(scenario.get_or_build(&rebuilt), what + " is rebuilt");
+    check(!scenario.get_or_build() && rebuilt != built,
+          what + " is replaced by the rebuilt plan");
+  };
+  check_rebuilt("A truncated entry", [](const fs::path &path) {
+    fs::resize_file(path, fs::file_size(path) - 1);
+  });
+  check_rebuilt("An entry cut in its header",
+                [](const fs::path &path) { fs::resize_file(path, 10); });
+  check_rebuilt("An entry with trailing bytes", [](const fs::path &path) {
+    std::ofstream(path, std::ios::binary | std::ios::app) << "junk";
+  });
+  const auto overwrite = [](const fs::path &path, const std::streamoff offset,
+                            const char c) {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(offset, offset < 0 ? std::ios::end : std::ios::beg);
+    file.put(c);
+  };
+  check_rebuilt("An entry with a bad magic",
+                [&overwrite](const fs::path &path) {
+                  overwrite(path, 0, 'X');
+                });
+  check_rebuilt("An entry with a bad plan hash",
+                [&overwrite](const fs::path &path) {
+                  overwrite(path, -1, '\x7f');
+                });
+  // Laid out as ... plan size (8 bytes), plan hash (8 bytes), plan
+  check_rebuilt("An entry with a corrupted plan size",
+                [&overwrite](const fs::path &path) {
+                  const auto plan_size =
+                      static_cast<std::streamoff>(StubBuilder()().size());
+                  overwrite(path, -(plan_size + 8 + 2), '\x7f');
+                });
+}
+
+void check_interrupted_writes(const fs::path &scratch_dir) {
+  {
+    Scenario scenario(scratch_dir, "interrupted");
+    // What a writer killed halfway through leaves behind, next to where the
+    // entry would have been renamed to
+    const auto entry_path = scenario.get_entry_path();
+    auto tmp_path = entry_path;
+    tmp_path += ".12345.0.tmp";
+    fs::copy_file(entry_path, tmp_path);
+    fs::resize_file(tmp_path, fs::file_size(tmp_path) / 2);
+    fs::remove(entry_path);
+    check(scenario.get_or_build(),
+          "A partially written temporary file is never loaded");
+    check(!scenario.get_or_build(), "The rebuilt entry hits");
+  }
+  {
+    Scenario scenario(scratch_dir, "throwing");
+    bool threw = false;
+    try {
+      scenario.cache().get_or_build(scenario.key(), []() -> std::vector<char> {
+        throw std::runtime_error("build interrupted");
+      });
+    } catch (const std::runtime_error &) {
+      threw = true;
+    }
+    check(threw && list_dir(scenario.cache_dir()).empty(),
+          "A build that throws leaves no file behind");
+    scenario.cache().get_or_build(scenario.key(),
+                                  [] { return std::vector<char>{}; });
+    check(list_dir(scenario.cache_dir()).empty(),
+          "A build that fails leaves no file behind");
+    for (int i = 0; i < 3; ++i) {
+      auto key = scenario.key();
+      key.input_width += i;
+      scenario.get_or_build(key);
+    }
+    bool has_tmp_file = false;
+    for (const auto &path : list_dir(scenario.cache_dir()))
+      has_tmp_file |= path.extension() == ".tmp";
+    check(!has_tmp_file && list_dir(scenario.cache_dir()).size() == 3,
+          "Stored entries leave no temporary file behind");
+  }
+}
+
+} // namespace
+
+int main(const int argc, char *argv[]) {
+  const fs::path scratch_dir =
+      argc > 1 ? fs::path(argv[1])
+               : fs::temp_directory_path() /
+                     fmt::format("trt_engine_cache_check.{}", getpid());
+  try {
+    check_hit_after_build(scratch_dir);
+    check_key_changes(scratch_dir);
+    check_corrupted_entries(scratch_dir);
+    check_interrupted_writes(scratch_dir);
+  } catch (const std::exception &e) {
+    std::printf("FAIL: %s\n", e.what());
+    ++g_failure_count;
+  }
+  std::error_code ec;
+  fs::remove_all(scratch_dir, ec);
+  std::printf("%d check(s) failed\n", g_failure_count);
+  return g_failure_count == 0 ? 0 : 1;
+}
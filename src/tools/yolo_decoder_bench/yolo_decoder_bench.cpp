@@ -0,0 +1,199 @@
+// Compares YoloDetect's output decoding: the previous cv::transpose() of the
+// whole 84 x 8400 tensor plus a cv::minMaxLoc() per anchor vs.
+// Utils::decode_yolo_output() on the tensor as is, with each instruction set
+// the CPU supports, and, if there is a CUDA device, the tensor's copy to the
+// host plus the fastest of them vs. Utils::YoloDeviceDecoder. Every decoder's
+// candidates must equal the previous path's, the exit code is 1 if they
+// don't, s.t. recorded tensors (see YoloDetect's recordOutputTensorPath)
+// double as a regression test.
+//
+// Usage: yolo_decoder_bench [tensor.f32 dimensions anchor_count]
+//                           [confidence_threshold] [iterations]
+
+#include "../../matrix-pipeline/utils/yolo_decoder.h"
+#include "../../matrix-pipeline/utils/yolo_device_decoder.h"
+
+#include <opencv2/core.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std::chrono;
+using namespace MatrixPipeline::Utils;
+
+namespace {
+
+// What YoloDetect::post_process_yolo() did before decode_yolo_output()
+void decode_transposed(const std::vector<float> &output, const int dimensions,
+                       const int anchor_count,
+                       const float confidence_threshold,
+                       YoloCandidates &candidates) {
+  const cv::Mat result_wrapper(dimensions, anchor_count, CV_32F,
+                               const_cast<float *>(output.data()));
+  cv::Mat output_t;
+  cv::transpose(result_wrapper, output_t);
+  candidates.clear();
+  for (int i = 0; i < anchor_count; ++i) {
+    auto *row_ptr = output_t.ptr<float>(i);
+    cv::Mat scores(1, dimensions - 4, CV_32F, row_ptr + 4);
+    cv::Point class_id_point;
+    double max_class_score;
+    cv::minMaxLoc(scores, 0, &max_class_score, 0, &class_id_point);
+    if (max_class_score > confidence_threshold) {
+      const float cx = row_ptr[0];
+      const float cy = row_ptr[1];
+      const float w = row_ptr[2];
+      const float h = row_ptr[3];
+      candidates.boxes.emplace_back(cx - 0.5f * w, cy - 0.5f * h, w, h);
+      candidates.confidences.push_back(static_cast<float>(max_class_score));
+      candidates.class_ids.push_back(class_id_point.x);
+    }
+  }
+}
+
+// Roughly what a frame with a few objects looks like: low scores everywhere
+// but for one class of every 97th anchor
+std::vector<float> make_synthetic_output(const int dimensions,
+                                         const int anchor_count) {
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> position(0, 640);
+  std::uniform_real_distribution<float> score(0, 0.1f);
+  std::vector<float> output(static_cast<size_t>(dimensions) * anchor_count);
+  for (int d = 0; d < dimensions; ++d) {
+    for (int a = 0; a < anchor_count; ++a)
+      output[static_cast<size_t>(d) * anchor_count + a] =
+          d < 4 ? position(rng) : score(rng);
+  }
+  for (int a = 0; a < anchor_count; a += 97)
+    output[static_cast<size_t>(4 + a % (dimensions - 4)) * anchor_count + a] =
+        0.9f;
+  return output;
+}
+
+bool read_recorded_output(const std::string &path, std::vector<float> &output) {
+  std::ifstream file(path, std::ios::binary);
+  file.read(reinterpret_cast<char *>(output.data()),
+            static_cast<std::streamsize>(output.size() * sizeof(float)));
+  return file.gcount() ==
+         static_cast<std::streamsize>(output.size() * sizeof(float));
+}
+
+bool are_equal(const YoloCandidates &lhs, const YoloCandidates &rhs) {
+  return lhs.boxes == rhs.boxes && lhs.confidences == rhs.confidences &&
+         lhs.class_ids == rhs.class_ids;
+}
+
+template <typename Decode>
+double time_us(const int iterations, Decode &&decode) {
+  const auto start = steady_clock::now();
+  for (int i = 0; i < iterations; ++i)
+    decode();
+  return duration<double, std::micro>(steady_clock::now() - start).count() /
+         iterations;
+}
+
+} // namespace
+
+int main(const int argc, char *argv[]) {
+  const bool recorded = argc > 3;
+  const int dimensions = recorded ? std::atoi(argv[2]) : 84;
+  const int anchor_count = recorded ? std::atoi(argv[3]) : 8400;
+  const float confidence_threshold =
+      argc > 4 ? std::strtof(argv[4], nullptr) : 0.5f;
+  const int iterations = argc > 5 ? std::atoi(argv[5]) : 300;
+  if (dimensions <= 4 || anchor_count <= 0 || iterations <= 0) {
+    std::fprintf(stderr, "invalid dimensions, anchor_count or iterations\n");
+    return 2;
+  }
+
+  std::vector<float> output;
+  if (recorded) {
+    output.resize(static_cast<size_t>(dimensions) * anchor_count);
+    if (!read_recorded_output(argv[1], output)) {
+      std::fprintf(stderr, "%s doesn't hold %d x %d floats\n", argv[1],
+                   dimensions, anchor_count);
+      return 2;
+    }
+  } else {
+    output = make_synthetic_output(dimensions, anchor_count);
+  }
+
+  const std::vector<float> class_thresholds(dimensions - 4,
+                                            confidence_threshold);
+  YoloCandidates expected;
+  decode_transposed(output, dimensions, anchor_count, confidence_threshold,
+                    expected);
+  std::printf("tensor: %s, %d x %d, confidence_threshold: %.2f, "
+              "candidates: %zu\n",
+              recorded ? argv[1] : "synthetic", dimensions, anchor_count,
+              confidence_threshold, expected.size());
+  std::printf("%-22s %10s %8s\n", "decoder", "us/tensor", "equal");
+  std::printf("%-22s %10.1f %8s\n", "transpose+minMaxLoc",
+              time_us(iterations,
+                      [&] {
+                        decode_transposed(output, dimensions, anchor_count,
+                                          confidence_threshold, expected);
+                      }),
+              "-");
+
+  bool all_equal = true;
+  YoloCandidates candidates;
+  for (const auto isa :
+       {YoloDecoderIsa::scalar, YoloDecoderIsa::avx2, YoloDecoderIsa::avx512}) {
+    if (isa > get_best_yolo_decoder_isa())
+      continue;
+    decode_yolo_output(output.data(), dimensions, anchor_count,
+                       class_thresholds, candidates, isa);
+    const bool equal = are_equal(candidates, expected);
+    all_equal = all_equal && equal;
+    const auto elapsed = time_us(iterations, [&] {
+      decode_yolo_output(output.data(), dimensions, anchor_count,
+                         class_thresholds, candidates, isa);
+    });
+    std::printf("%-22s %10.1f %8s\n", yolo_decoder_isa_to_string(isa).c_str(),
+                elapsed, equal ? "yes" : "NO");
+  }
+
+  int device_count = 0;
+  if (cudaGetDeviceCount(&device_count) != cudaSuccess || device_count == 0) {
+    std::printf("no CUDA device, YoloDeviceDecoder skipped\n");
+    return all_equal ? 0 : 1;
+  }
+  const auto output_gpu = make_device_unique<float>(output.size());
+  cudaMemcpy(output_gpu.get(), output.data(), output.size() * sizeof(float),
+             cudaMemcpyHostToDevice);
+  cudaStream_t stream;
+  cudaStreamCreate(&stream);
+  std::vector<float> output_cpu(output.size());
+  std::printf("%-22s %10.1f %8s\n", "copy+cpu",
+              time_us(iterations,
+                      [&] {
+                        cudaMemcpyAsync(output_cpu.data(), output_gpu.get(),
+                                        output.size() * sizeof(float),
+                                        cudaMemcpyDeviceToHost, stream);
+                        cudaStreamSynchronize(stream);
+                        decode_yolo_output(output_cpu.data(), dimensions,
+                                           anchor_count, class_thresholds,
+                                           candidates);
+                      }),
+              "-");
+  YoloDeviceDecoder device_decoder(dimensions, anchor_count,
+                                   class_thresholds);
+  const auto decode_on_device = [&] {
+    device_decoder.enqueue(output_gpu.get(), stream);
+    cudaStreamSynchronize(stream);
+    device_decoder.collect(candidates);
+  };
+  decode_on_device();
+  const bool equal = are_equal(candidates, expected);
+  all_equal = all_equal && equal;
+  std::printf("%-22s %10.1f %8s\n", "device",
+              time_us(iterations, decode_on_device), equal ? "yes" : "NO");
+  cudaStreamDestroy(stream);
+  return all_equal ? 0 : 1;
+}